@@ -0,0 +1,136 @@
+/*
+ * BenchUtil
+ * 各个微基准共用的辅助函数:丢弃内核页缓存、计时、解析check|bench参数，以及建立和打开带一个索引的表
+ * 只在bench目录下的程序中使用，没有用到的函数不需要链接对应的源文件
+ */
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+#include "../recordsystem/RecordSystem.h"
+#include "../indexsystem/IndexSystem.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * @函数名dropCache
+ * 功能:把文件写入磁盘后丢弃它在内核页缓存中的页面
+ */
+inline void dropCache(const char *name) {
+    int f = open(name, O_RDONLY);
+    if (f == -1) return;
+    fdatasync(f);
+    posix_fadvise(f, 0, 0, POSIX_FADV_DONTNEED);
+    close(f);
+}
+
+/*
+ * @函数名msSince
+ * 返回:从start到现在经过的毫秒数
+ */
+inline double msSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+/*
+ * @函数名measure
+ * 返回:执行run(i)共rounds次的每次平均纳秒数
+ */
+template<typename F>
+inline double measure(int rounds, F run) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) run(i);
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+}
+
+/*
+ * @函数名parseMode
+ * @参数check:函数返回时，存储是否进行正确性检查
+ * @参数bench:函数返回时，存储是否进行测量
+ * 功能:解析[check|bench]参数，不带参数时两者都进行
+ * 返回:参数不合法时打印用法并返回false
+ */
+inline bool parseMode(int argc, char **argv, bool &check, bool &bench) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    if (mode != "" && mode != "check" && mode != "bench") {
+        std::cerr << "usage: " << argv[0] << " [check|bench]" << std::endl;
+        return false;
+    }
+    check = mode != "bench";
+    bench = mode != "check";
+    return true;
+}
+
+/*
+ * BenchTable
+ * 用新的缓存管理器打开基准建立的表文件和它的一个索引文件，析构时关闭并写回
+ * 每轮测量使用一个新的BenchTable，缓存从空开始
+ */
+class BenchTable {
+private:
+    FileManager _fileManager;
+    std::unique_ptr<BufPageManager> _bufPageManager;
+    std::unique_ptr<RecordManager> _recordManager;
+    std::unique_ptr<IndexManager> _indexManager;
+    int _tableID = -1, _indexID = -1;
+    bool _ok;
+
+public:
+    BenchTable(IOBackend backend = SYNC_IO, const BufPageOption &option = BufPageOption()) {
+        //读写后端要在缓存管理器使用文件之前选择
+        _ok = _fileManager.setBackend(backend);
+        _bufPageManager.reset(new BufPageManager(&_fileManager, option));
+        _recordManager.reset(new RecordManager(_bufPageManager.get(), &_fileManager));
+        _indexManager.reset(new IndexManager(_bufPageManager.get(), &_fileManager));
+    }
+
+    ~BenchTable() {
+        if (_tableID != -1) _recordManager->closeFile(_tableID);
+        if (_indexID != -1) _indexManager->closeIndex(_indexID);
+        _fileManager.closeIdleFiles();
+    }
+
+    //选择的读写后端不可用时返回false
+    bool ok() const { return _ok; }
+
+    /*
+     * @函数名create
+     * 功能:建立定长记录的表文件和一个INT键的索引文件，并打开它们
+     * 返回:建立失败时返回false
+     */
+    bool create(const char *tableName, const std::vector<std::string> &keyNames, int recordSize, int pageSize) {
+        int keyLen = sizeof(int);
+        AttrType keyType = INTEGER;
+        if (!_recordManager->createFile(tableName, recordSize, pageSize, FIXED_RECORD, {}, {})) return false;
+        if (!_indexManager->createIndex(tableName, keyNames, 1, &keyLen, &keyType, pageSize)) return false;
+        open(tableName, keyNames);
+        return true;
+    }
+
+    //打开已经建立的表文件和索引文件
+    void open(const char *tableName, const std::vector<std::string> &keyNames) {
+        _recordManager->openFile(tableName, _tableID);
+        _indexManager->openIndex(tableName, keyNames, _indexID);
+    }
+
+    BufPageManager *bufPageManager() { return _bufPageManager.get(); }
+    std::unique_ptr<TableHandle> table() { return _recordManager->openTable(_tableID); }
+    IndexHandle index() { return IndexHandle(_bufPageManager.get(), _indexID); }
+    int indexID() const { return _indexID; }
+};
+
+/*
+ * @函数名removeTable
+ * 功能:删除基准建立的表文件和索引文件
+ */
+inline void removeTable(const char *tableName, const std::vector<std::string> &keyNames) {
+    std::string indexName = std::string(tableName);
+    for (const auto &keyName : keyNames) indexName += "." + keyName;
+    remove(tableName);
+    remove(indexName.c_str());
+}
+
+#endif //BENCH_UTIL_H
@@ -0,0 +1,191 @@
+/*
+ * BitKernelBench
+ * 检查BitKernel的各个实现并测量它们在稀疏和稠密页面位图上的速度
+ * 检查:在随机位图上把AVX2、popcnt和标量实现的结果与逐位循环比较，任何不一致都打印出来并返回1
+ * 测量:稀疏页面(约1%的槽有记录)和稠密页面(约99%的槽有记录)上逐条扫描记录，稠密页面上查找空槽，以及统计记录条数
+ * 用法:bitKernelBench [check|bench]，不带参数时先检查再测量
+ */
+#include "BenchUtil.h"
+#include "../filesystem/utils/BitKernel.h"
+#include <cstring>
+#include <iomanip>
+#include <random>
+
+using namespace std;
+
+struct Path {
+    const char *_name;
+    bool _avx2;
+    bool _popcnt;
+};
+
+//依次关闭AVX2和popcnt，CPU不支持的指令即使打开也会退回标量实现
+static const Path paths[] = {
+    {"avx2+popcnt", true, true},
+    {"popcnt", false, true},
+    {"scalar", false, false},
+};
+
+//逐位循环的参考实现
+static bool bit(const uint *words, int i) {
+    return (words[i >> 5] >> (i & 31)) & 1;
+}
+
+static int slowNextZero(const uint *words, int from, int n) {
+    for (int i = from; i < n; i++) {
+        if (!bit(words, i)) return i;
+    }
+    return -1;
+}
+
+static int slowNextSet(const uint *words, int from, int n) {
+    for (int i = from; i < n; i++) {
+        if (bit(words, i)) return i;
+    }
+    return n;
+}
+
+static int slowPopcount(const uint *words, int n) {
+    int count = 0;
+    for (int i = 0; i < n; i++) count += bit(words, i);
+    return count;
+}
+
+/*
+ * @函数名fill
+ * @参数n:位图的位数
+ * @参数kind:0为随机密度，1为全0中散落的1，2为全1中散落的0，3为长段的全0和全1交替
+ * 功能:生成位图，第n位之后的位填入随机数据，检查实现是否忽略它们
+ */
+static void fill(vector<uint> &words, int n, int kind, mt19937 &rng) {
+    words.assign((n + 31) / 32 + 8, 0);
+    for (auto &word : words) word = rng();
+    if (kind == 0) {
+        double density = uniform_real_distribution<double>(0, 1)(rng);
+        for (int i = 0; i < n; i++) {
+            bool one = uniform_real_distribution<double>(0, 1)(rng) < density;
+            words[i >> 5] = (words[i >> 5] & ~(1u << (i & 31))) | ((uint) one << (i & 31));
+        }
+        return;
+    }
+    int run = 0;
+    bool one = true;
+    for (int i = 0; i < n; i++) {
+        if (kind == 1) one = rng() % 600 == 0;
+        else if (kind == 2) one = rng() % 600 != 0;
+        else if (run-- == 0) {
+            one = !one;
+            run = (int) (rng() % 700);
+        }
+        words[i >> 5] = (words[i >> 5] & ~(1u << (i & 31))) | ((uint) one << (i & 31));
+    }
+}
+
+static void report(const char *path, const char *kernel, int n, int from, long long got, long long want) {
+    cout << "mismatch " << path << " " << kernel << " n=" << n << " from=" << from << " got=" << got << " want=" << want << endl;
+}
+
+/*
+ * @函数名check
+ * @参数rounds:每个实现检查的位图个数
+ * 返回:所有实现的结果都与逐位循环一致时返回true
+ */
+static bool check(int rounds) {
+    int mismatches = 0;
+    for (const auto &path : paths) {
+        int before = mismatches;
+        BitKernel::limitPaths(path._avx2, path._popcnt);
+        mt19937 rng(20240601);
+        vector<uint> words;
+        long long checks = 0;
+        for (int round = 0; round < rounds && mismatches - before < 20; round++) {
+            //短位图覆盖各种不足64位和256位的尾部，长位图覆盖AVX2的整段跳过
+            int n = round % 4 == 0 ? 1 + (int) (rng() % 64) : 1 + (int) (rng() % 4096);
+            fill(words, n, round % 4, rng);
+            if (BitKernel::popcount(words.data(), n) != slowPopcount(words.data(), n)) {
+                report(path._name, "popcount", n, 0, BitKernel::popcount(words.data(), n), slowPopcount(words.data(), n));
+                mismatches++;
+            }
+            if (BitKernel::findFirstZero(words.data(), n) != slowNextZero(words.data(), 0, n)) {
+                report(path._name, "findFirstZero", n, 0, BitKernel::findFirstZero(words.data(), n), slowNextZero(words.data(), 0, n));
+                mismatches++;
+            }
+            checks += 2;
+            //每个位图检查若干个起始位，包括0、n和超过n的位置
+            for (int k = 0; k < 16; k++) {
+                int from = k == 0 ? 0 : k == 1 ? n : k == 2 ? n + 5 : (int) (rng() % n);
+                if (BitKernel::findNextZero(words.data(), from, n) != slowNextZero(words.data(), from, n)) {
+                    report(path._name, "findNextZero", n, from, BitKernel::findNextZero(words.data(), from, n), slowNextZero(words.data(), from, n));
+                    mismatches++;
+                }
+                if (BitKernel::findNextSet(words.data(), from, n) != slowNextSet(words.data(), from, n)) {
+                    report(path._name, "findNextSet", n, from, BitKernel::findNextSet(words.data(), from, n), slowNextSet(words.data(), from, n));
+                    mismatches++;
+                }
+                checks += 2;
+            }
+        }
+        cout << "check " << path._name << ": " << checks << " checks" << (mismatches == before ? " ok" : " FAILED") << endl;
+    }
+    BitKernel::limitPaths(true, true);
+    return mismatches == 0;
+}
+
+static volatile long long sink;
+
+/*
+ * @函数名bench
+ * 功能:对每种页面的槽数，分别测量逐位循环和各个实现在稀疏、稠密页面上的耗时
+ */
+static void bench() {
+    //8KB页面上16字节和128字节的记录，以及64KB页面上16字节的记录
+    const int slotCounts[] = {480, 62, 3968};
+    mt19937 rng(7);
+    for (int n : slotCounts) {
+        vector<uint> sparse((n + 31) / 32 + 8, 0), dense((n + 31) / 32 + 8, ~0u);
+        for (int i = 0; i < n; i++) {
+            if (rng() % 100 == 0) sparse[i >> 5] |= 1u << (i & 31);
+            if (rng() % 100 == 0) dense[i >> 5] &= ~(1u << (i & 31));
+        }
+        int rounds = 4000000 / n + 1000;
+        cout << "slots " << n << " (ns per page)" << endl;
+        cout << "    path          sparse scan    dense scan    dense find zero    count" << endl;
+        auto line = [&](const char *name, double sparseScan, double denseScan, double findZero, double count) {
+            cout << "    " << name << string(12 - strlen(name), ' ') << setw(13) << sparseScan << setw(14) << denseScan << setw(19) << findZero << setw(9) << count << endl;
+        };
+        //逐条访问位图中为1的位，相当于扫描页面中的每条记录
+        auto slowScan = [&](const vector<uint> &words) {
+            long long s = 0;
+            for (int i = slowNextSet(words.data(), 0, n); i < n; i = slowNextSet(words.data(), i + 1, n)) s += i;
+            sink = s;
+        };
+        auto scan = [&](const vector<uint> &words) {
+            long long s = 0;
+            for (int i = BitKernel::findNextSet(words.data(), 0, n); i < n; i = BitKernel::findNextSet(words.data(), i + 1, n)) s += i;
+            sink = s;
+        };
+        cout << fixed << setprecision(1);
+        line("bit-by-bit",
+             measure(rounds, [&](int) { slowScan(sparse); }),
+             measure(rounds, [&](int) { slowScan(dense); }),
+             measure(rounds, [&](int) { sink = slowNextZero(dense.data(), 0, n); }),
+             measure(rounds, [&](int) { sink = slowPopcount(dense.data(), n); }));
+        for (const auto &path : paths) {
+            BitKernel::limitPaths(path._avx2, path._popcnt);
+            line(path._name,
+                 measure(rounds, [&](int) { scan(sparse); }),
+                 measure(rounds, [&](int) { scan(dense); }),
+                 measure(rounds, [&](int) { sink = BitKernel::findFirstZero(dense.data(), n); }),
+                 measure(rounds, [&](int) { sink = BitKernel::popcount(dense.data(), n); }));
+        }
+        BitKernel::limitPaths(true, true);
+    }
+}
+
+int main(int argc, char **argv) {
+    bool checking, benching;
+    if (!parseMode(argc, argv, checking, benching)) return 2;
+    if (checking && !check(20000)) return 1;
+    if (benching) bench();
+    return 0;
+}
@@ -0,0 +1,120 @@
+/*
+ * DirectIOBench
+ * 比较经过内核页缓存的读写和O_DIRECT下顺序扫描的耗时与内存占用
+ * 先写出一个表文件并把它从内核页缓存中丢弃，再在两种模式下分别用新的缓存管理器多次顺序扫描整个文件
+ * 每次扫描后用mincore统计文件留在内核页缓存中的页面，与缓存管理器中的页面一起作为这份数据占用的内存
+ * 缓存能容纳整个文件时，第一次扫描从磁盘读取，之后的扫描全部命中缓存管理器
+ * 缓存小于文件时，之后的扫描在缓存管理器中缺页，经过内核页缓存时从页缓存读取，O_DIRECT时从磁盘读取
+ * 用法:directIOBench [pages] [scans] [poolPages]，默认25000个8KB页面(200MB)、扫描3次，
+ *      缓存页面个数默认为页面数的5/4，页面按hash分到各个分区，留出余量使每个分区都能容纳分到它的页面
+ *      在当前目录建立临时文件
+ */
+#include "BenchUtil.h"
+#include <iomanip>
+
+using namespace std;
+
+static const char *fileName = "directIOBench.data";
+
+/*
+ * @函数名build
+ * 功能:写出pages个页面，第p页的每个四字节整数都为p
+ */
+static bool build(int pages) {
+    FileManager fileManager;
+    if (!fileManager.createFile(fileName)) return false;
+    int fileID;
+    if (!fileManager.openFile(fileName, fileID)) return false;
+    const int batch = 256;
+    vector<unsigned int> data((size_t) batch * PAGE_INT_NUM);
+    vector<BufType> bufs(batch);
+    for (int first = 1; first <= pages; first += batch) {
+        int n = min(batch, pages + 1 - first);
+        for (int i = 0; i < n; i++) {
+            bufs[i] = data.data() + (size_t) i * PAGE_INT_NUM;
+            fill(bufs[i], bufs[i] + PAGE_INT_NUM, (unsigned int) (first + i));
+        }
+        if (fileManager.writePages(fileID, first, bufs.data(), n) != 0) return false;
+    }
+    fileManager.closeFile(fileID);
+    fileManager.closeIdleFiles();
+    return true;
+}
+
+/*
+ * @函数名cachedBytes
+ * 返回:文件留在内核页缓存中的字节数
+ */
+static long long cachedBytes() {
+    int f = open(fileName, O_RDONLY);
+    if (f == -1) return 0;
+    struct stat st;
+    fstat(f, &st);
+    long long cached = 0;
+    void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, f, 0);
+    if (m != MAP_FAILED) {
+        long osPage = sysconf(_SC_PAGESIZE);
+        vector<unsigned char> resident((st.st_size + osPage - 1) / osPage);
+        if (mincore(m, st.st_size, resident.data()) == 0) {
+            for (unsigned char r : resident) cached += (r & 1) * osPage;
+        }
+        munmap(m, st.st_size);
+    }
+    close(f);
+    return cached;
+}
+
+/*
+ * @函数名run
+ * @参数direct:是否用O_DIRECT打开文件
+ * @参数poolPages:缓存页面个数
+ * 功能:用新的缓存管理器顺序扫描scans次，输出每次扫描的耗时和内存占用
+ */
+static void run(bool direct, int pages, int scans, int poolPages) {
+    dropCache(fileName);
+    FileManager fileManager;
+    fileManager.setDirectIO(direct);
+    BufPageOption option;
+    option.capacity = poolPages;
+    BufPageManager bufPageManager(&fileManager, option);
+    int fileID;
+    fileManager.openFile(fileName, fileID);
+    cout << (direct ? "direct" : "buffered") << endl;
+    for (int s = 0; s < scans; s++) {
+        long long wrong = 0;
+        auto start = chrono::steady_clock::now();
+        for (int p = 1; p <= pages; p++) {
+            int index;
+            BufType b = bufPageManager.getPage(fileID, p, index, true);
+            wrong += b[0] != (unsigned int) p || b[PAGE_INT_NUM - 1] != (unsigned int) p;
+        }
+        double ms = msSince(start);
+        if (wrong != 0) cerr << "wrong pages: " << wrong << endl;
+        double pool = (double) min(pages, poolPages) * PAGE_SIZE / (1 << 20);
+        double cached = (double) cachedBytes() / (1 << 20);
+        cout << "    scan " << s + 1 << setw(10) << ms << " ms    page cache" << setw(8) << cached << " MB    pool" << setw(8) << pool << " MB" << endl;
+    }
+    fileManager.closeFile(fileID);
+    fileManager.closeIdleFiles();
+}
+
+int main(int argc, char **argv) {
+    int pages = argc > 1 ? atoi(argv[1]) : 25000;
+    int scans = argc > 2 ? atoi(argv[2]) : 3;
+    int poolPages = argc > 3 ? atoi(argv[3]) : pages + pages / 4 + 1;
+    if (pages <= 0 || scans <= 0 || poolPages <= 0) {
+        cerr << "usage: " << argv[0] << " [pages] [scans] [poolPages]" << endl;
+        return 2;
+    }
+    MyBitMap::initConst();
+    if (!build(pages)) {
+        cerr << "build file failed" << endl;
+        return 1;
+    }
+    cout << pages << " pages of " << PAGE_SIZE << " bytes, " << scans << " sequential scans, " << poolPages << " pool pages" << endl;
+    cout << fixed << setprecision(1);
+    run(false, pages, scans, poolPages);
+    run(true, pages, scans, poolPages);
+    remove(fileName);
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ * IndexFetchBench
+ * 测量冷缓存下按索引随机查找并取出记录的耗时，比较逐条同步读、成批同步读和成批io_uring读
+ * 建立一张定长记录的表和记录中键的索引，键随机分布，每个键对应的记录散落在整个表文件中
+ * 每轮测量使用新的缓存管理器，并用posix_fadvise丢弃内核页缓存中的表文件，每次查找都从磁盘读取记录所在的页面
+ * 取出记录的过程与QueryManager::filterRecords使用索引时相同
+ * 用法:indexFetchBench [rows] [lookups]，默认1000000条记录、每轮20次查找，在当前目录建立临时文件
+ */
+#include "BenchUtil.h"
+#include <cstring>
+#include <iomanip>
+#include <random>
+
+using namespace std;
+
+static const char *tableName = "indexFetchBench.table";
+static const vector<string> keyNames(1, "key");
+static const int recordSize = 128;
+static const int rowsPerKey = 500;
+
+/*
+ * @函数名build
+ * 功能:建立rows条记录的表和键的索引，记录按随机的键插入，写回后关闭
+ */
+static bool build(int rows) {
+    BenchTable files;
+    if (!files.create(tableName, keyNames, recordSize, PAGE_SIZE)) return false;
+    auto table = files.table();
+    IndexHandle index = files.index();
+    mt19937 rng(11);
+    int keys = max(1, rows / rowsPerKey);
+    vector<char> row(recordSize, 0);
+    for (int i = 0; i < rows; i++) {
+        int key = (int) (rng() % keys);
+        memcpy(row.data(), &key, sizeof(int));
+        memcpy(row.data() + sizeof(int), &i, sizeof(int));
+        RID rid;
+        table->insertRecord((BufType) row.data(), rid);
+        index.insertEntry((BufType) &key, rid, false, false);
+    }
+    return true;
+}
+
+/*
+ * @函数名run
+ * @参数backend:读写后端
+ * @参数batch:是否先把一批记录所在的页面一起读入缓存
+ * @参数rows:表中的记录条数
+ * @参数lookups:查找次数
+ * @参数fetched:函数返回时，存储取出的记录条数
+ * 返回:所有查找的总毫秒数，io_uring不可用时返回-1
+ */
+static double run(IOBackend backend, bool batch, int rows, int lookups, long long &fetched) {
+    BenchTable files(backend);
+    if (!files.ok()) return -1;
+    files.open(tableName, keyNames);
+    fetched = 0;
+    auto table = files.table();
+    IndexHandle index = files.index();
+    //先读入索引，只测量取出记录的读盘
+    RID rid;
+    int first = INT32_MIN;
+    index.openScan((BufType) &first, true);
+    while (index.getNextEntry(rid)) {
+    }
+    dropCache(tableName);
+    mt19937 rng(29);
+    int keys = max(1, rows / rowsPerKey);
+    vector<char> data(recordSize);
+    long long check = 0;
+    auto start = chrono::steady_clock::now();
+    for (int l = 0; l < lookups; l++) {
+        int key = (int) (rng() % keys), next = key + 1;
+        vector<RID> rids;
+        RID end(-1, -1);
+        index.openScan((BufType) &next, true);
+        index.getNextEntry(end);
+        index.openScan((BufType) &key, true);
+        while (index.getNextEntry(rid) && !(rid == end)) rids.push_back(rid);
+        for (size_t i = 0; i < rids.size();) {
+            size_t last = batch ? table->prefetchRecords(rids, i) : rids.size();
+            for (; i < last; i++) {
+                table->getRecord(rids[i], (BufType) data.data());
+                check += *(int *) data.data() == key;
+            }
+        }
+        fetched += (long long) rids.size();
+    }
+    double ms = msSince(start);
+    if (check != fetched) cerr << "wrong records: " << check << " of " << fetched << endl;
+    return ms;
+}
+
+int main(int argc, char **argv) {
+    int rows = argc > 1 ? atoi(argv[1]) : 1000000;
+    int lookups = argc > 2 ? atoi(argv[2]) : 20;
+    if (rows <= 0 || lookups <= 0) {
+        cerr << "usage: " << argv[0] << " [rows] [lookups]" << endl;
+        return 2;
+    }
+    MyBitMap::initConst();
+    if (!build(rows)) {
+        cerr << "build table failed" << endl;
+        return 1;
+    }
+    struct Mode {
+        const char *_name;
+        IOBackend _backend;
+        bool _batch;
+    };
+    const Mode modes[] = {
+        {"sync, row by row", SYNC_IO, false},
+        {"sync, batched", SYNC_IO, true},
+        {"uring, batched", URING_IO, true},
+    };
+    cout << rows << " rows, " << lookups << " lookups of about " << rowsPerKey << " rows each, cold pool" << endl;
+    cout << fixed << setprecision(1);
+    for (const auto &mode : modes) {
+        long long fetched;
+        double ms = run(mode._backend, mode._batch, rows, lookups, fetched);
+        if (ms < 0) {
+            cout << "    " << mode._name << ": io_uring is not available" << endl;
+            continue;
+        }
+        cout << "    " << mode._name << string(20 - strlen(mode._name), ' ') << setw(10) << ms << " ms" << setw(10) << ms * 1000 / lookups << " us per lookup" << endl;
+    }
+    removeTable(tableName, keyNames);
+    return 0;
+}
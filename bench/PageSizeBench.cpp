@@ -0,0 +1,119 @@
+/*
+ * PageSizeBench
+ * 比较不同页面大小下索引的扇出和高度，以及全表扫描和按索引点查的耗时
+ * 对每种页面大小，建立一张定长记录的表和记录中键的索引，表文件和索引文件使用同一页面大小
+ * 冷扫描前用posix_fadvise丢弃内核页缓存中的表文件，并使用新的缓存管理器；热扫描紧接着再扫描一次
+ * 点查在缓存中已有索引页面时按随机的键查找并取出记录
+ * 用法:pageSizeBench [rows] [lookups]，默认400000条记录、100000次点查，在当前目录建立临时文件
+ */
+#include "BenchUtil.h"
+#include <iomanip>
+#include <random>
+
+using namespace std;
+
+static const char *tableName = "pageSizeBench.table";
+static const vector<string> keyNames(1, "key");
+static const int recordSize = 48;
+
+/*
+ * @函数名build
+ * 功能:建立rows条记录的表和键的索引，键为0到rows-1的随机排列
+ */
+static bool build(int rows, int pageSize) {
+    BenchTable files;
+    if (!files.create(tableName, keyNames, recordSize, pageSize)) return false;
+    auto table = files.table();
+    IndexHandle index = files.index();
+    vector<int> keys(rows);
+    for (int i = 0; i < rows; i++) keys[i] = i;
+    shuffle(keys.begin(), keys.end(), mt19937(13));
+    vector<char> row(recordSize, 0);
+    for (int key : keys) {
+        memcpy(row.data(), &key, sizeof(int));
+        RID rid;
+        table->insertRecord((BufType) row.data(), rid);
+        index.insertEntry((BufType) &key, rid, true, false);
+    }
+    return true;
+}
+
+/*
+ * @函数名scan
+ * 返回:逐页扫描整个表的毫秒数，rows返回扫描到的记录条数
+ */
+static double scan(TableHandle &table, long long &rows) {
+    auto start = chrono::steady_clock::now();
+    rows = 0;
+    vector<RecordRef> records;
+    if (table.openPageScan()) {
+        while (table.getNextRecords(records)) rows += (long long) records.size();
+        table.closePageScan();
+    }
+    return msSince(start);
+}
+
+/*
+ * @函数名measurePageSize
+ * 功能:输出一种页面大小下索引的扇出、高度和页面数，冷热扫描的耗时和点查的平均耗时
+ */
+static void measurePageSize(int rows, int lookups, int pageSize) {
+    dropCache(tableName);
+    BenchTable files;
+    files.open(tableName, keyNames);
+    auto table = files.table();
+    IndexHandle index = files.index();
+    BufPageManager &bufPageManager = *files.bufPageManager();
+    int indexID = files.indexID();
+    //从根节点沿第一个子节点走到叶节点，节点页面以是否为叶节点开头，子节点数组从_childStart开始
+    int bufIndex;
+    IndexHeader header;
+    memcpy(&header, bufPageManager.getPage(indexID, 0, bufIndex), sizeof(IndexHeader));
+    int height = 1;
+    for (int id = header._root;; height++) {
+        BufType b = bufPageManager.getPage(indexID, id, bufIndex);
+        if (b[0] != 0) break;
+        memcpy(&id, (char *) b + header._childStart, sizeof(int));
+    }
+    long long coldRows, warmRows;
+    double cold = scan(*table, coldRows);
+    double warm = scan(*table, warmRows);
+    if (coldRows != rows || warmRows != rows) cerr << "scanned " << coldRows << " and " << warmRows << " of " << rows << " rows" << endl;
+    mt19937 rng(31);
+    vector<char> data(recordSize);
+    long long wrong = 0;
+    auto start = chrono::steady_clock::now();
+    for (int l = 0; l < lookups; l++) {
+        int key = (int) (rng() % rows);
+        RID rid;
+        index.openScan((BufType) &key, true);
+        if (index.getNextEntry(rid)) table->getRecord(rid, (BufType) data.data());
+        wrong += *(int *) data.data() != key;
+    }
+    double lookup = msSince(start) * 1000 / lookups;
+    if (wrong != 0) cerr << "wrong lookups: " << wrong << endl;
+    cout << setw(8) << pageSize / 1024 << " KB" << setw(9) << header._maxChildNum << setw(8) << height << setw(13) << header._pageNumber
+         << setw(15) << cold << setw(15) << warm << setw(16) << lookup << endl;
+}
+
+int main(int argc, char **argv) {
+    int rows = argc > 1 ? atoi(argv[1]) : 400000;
+    int lookups = argc > 2 ? atoi(argv[2]) : 100000;
+    if (rows <= 0 || lookups <= 0) {
+        cerr << "usage: " << argv[0] << " [rows] [lookups]" << endl;
+        return 2;
+    }
+    MyBitMap::initConst();
+    cout << rows << " rows of " << recordSize << " bytes, " << lookups << " point lookups" << endl;
+    cout << "   page size  fan-out  height  index pages  cold scan ms  warm scan ms  lookup us" << endl;
+    cout << fixed << setprecision(1);
+    for (int pageSize = MIN_PAGE_SIZE; pageSize <= MAX_PAGE_SIZE; pageSize *= 2) {
+        if (!build(rows, pageSize)) {
+            cerr << "build table failed" << endl;
+            return 1;
+        }
+        measurePageSize(rows, lookups, pageSize);
+        removeTable(tableName, keyNames);
+    }
+    return 0;
+}
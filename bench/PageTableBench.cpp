@@ -0,0 +1,187 @@
+/*
+ * PageTableBench
+ * 比较缓存页表PageTable和原来的MyHashMap
+ * 检查:随机替换和删除之后，两个表对每个键的查找结果一致，不一致时打印出来并返回1
+ * 测量:缓存装满时的随机查找(部分键不在表中)、按文件顺序的查找，以及替换一个页面的耗时
+ * 用法:pageTableBench [check|bench]，不带参数时先检查再测量
+ */
+#include "BenchUtil.h"
+#include "../filesystem/utils/PageTable.h"
+#include "../filesystem/utils/MyLinkList.h"
+#include <cstring>
+#include <iomanip>
+#include <random>
+
+using namespace std;
+
+/*
+ * 原来的MyHashMap，hash函数为(k1+k2)%MOD，用MyLinkList链接冲突的键
+ * 相同文件号与页号之和的键都落在同一条链上
+ */
+class ChainedMap {
+private:
+    int CAP_, MOD_;
+    MyLinkList *list;
+    struct DataNode {
+        int key1;
+        int key2;
+    } *a;
+
+    int hash(int k1, int k2) {
+        return (k1 + k2) % MOD_;
+    }
+
+public:
+    int findIndex(int k1, int k2) {
+        int p = list->getFirst(hash(k1, k2));
+        while (!list->isHead(p)) {
+            if (a[p].key1 == k1 && a[p].key2 == k2) {
+                return p;
+            }
+            p = list->next(p);
+        }
+        return -1;
+    }
+
+    void replace(int index, int k1, int k2) {
+        list->insertFirst(hash(k1, k2), index);
+        a[index].key1 = k1;
+        a[index].key2 = k2;
+    }
+
+    void remove(int index) {
+        list->del(index);
+        a[index].key1 = -1;
+        a[index].key2 = -1;
+    }
+
+    ChainedMap(int c, int m) {
+        CAP_ = c;
+        MOD_ = m;
+        a = new DataNode[c];
+        for (int i = 0; i < CAP_; ++i) {
+            a[i].key1 = -1;
+            a[i].key2 = -1;
+        }
+        list = new MyLinkList(CAP_, MOD_);
+    }
+
+    ~ChainedMap() {
+        delete[] a;
+        delete list;
+    }
+};
+
+//原来的缓存页面个数和MOD
+static const int frames = 60000;
+static const int mod = 60000;
+//检查时8个文件的页面随机装入和换出
+static const int files = 8;
+static const int filePages = frames / files;
+
+/*
+ * @函数名check
+ * 返回:随机替换和删除之后两个表的查找结果一致时返回true
+ */
+static bool check() {
+    ChainedMap chained(frames, mod);
+    PageTable table(frames);
+    vector<pair<int, int>> owner(frames, {-1, -1});
+    mt19937 rng(5);
+    int mismatches = 0;
+    for (int round = 0; round < 400000 && mismatches < 20; round++) {
+        int index = (int) (rng() % frames);
+        if (owner[index].first != -1) {
+            chained.remove(index);
+            table.remove(index);
+            owner[index] = {-1, -1};
+        }
+        //大部分时候装入新页面，偶尔只删除，空出的下标之后再次使用
+        if (rng() % 8 != 0) {
+            int fileID = (int) (rng() % files), pageID = (int) (rng() % (filePages * 2));
+            if (table.findIndex(fileID, pageID) == -1) {
+                chained.replace(index, fileID, pageID);
+                table.replace(index, fileID, pageID);
+                owner[index] = {fileID, pageID};
+            }
+        }
+        int fileID = (int) (rng() % files), pageID = (int) (rng() % (filePages * 2));
+        int a = chained.findIndex(fileID, pageID), b = table.findIndex(fileID, pageID);
+        if (a != b) {
+            cout << "mismatch (" << fileID << "," << pageID << ") MyHashMap " << a << " PageTable " << b << endl;
+            mismatches++;
+        }
+    }
+    for (int index = 0; index < frames && mismatches < 20; index++) {
+        if (owner[index].first != -1 && table.findIndex(owner[index].first, owner[index].second) != index) {
+            cout << "lost (" << owner[index].first << "," << owner[index].second << ") at " << index << endl;
+            mismatches++;
+        }
+    }
+    cout << "check: " << (mismatches == 0 ? "ok" : "FAILED") << endl;
+    return mismatches == 0;
+}
+
+static volatile long long sink;
+
+/*
+ * @函数名bench
+ * @参数files:缓存中的文件个数
+ * 功能:两个表都装满，每个文件的前frames/files个页面在缓存中，分别测量随机查找、顺序查找和替换
+ *           MyHashMap中文件号与页号之和相同的键在同一条链上，链长约为文件个数
+ */
+static void bench(int files) {
+    const int rounds = 4000000;
+    const int filePages = frames / files;
+    ChainedMap chained(frames, mod);
+    PageTable table(frames);
+    for (int f = 0; f < files; f++) {
+        for (int p = 0; p < filePages; p++) {
+            chained.replace(f * filePages + p, f, p);
+            table.replace(f * filePages + p, f, p);
+        }
+    }
+    //随机查找的键，页号超出缓存中的范围时不命中，约1/6的查找不命中
+    mt19937 rng(17);
+    vector<pair<int, int>> keys(1 << 20);
+    for (auto &key : keys) key = {(int) (rng() % files), (int) (rng() % (filePages * 6 / 5))};
+    const int keyMask = (int) keys.size() - 1;
+    cout << "frames " << frames << ", " << files << " files x " << filePages << " pages (ns per operation)" << endl;
+    cout << "    map           random lookup    sequential lookup    replace" << endl;
+    auto line = [](const char *name, double random, double sequential, double replace) {
+        cout << "    " << name << string(12 - strlen(name), ' ') << setw(15) << random << setw(21) << sequential << setw(11) << replace << endl;
+    };
+    cout << fixed << setprecision(1);
+    //函数参数的求值顺序不确定，先依次测量查找，最后测量会修改表的替换
+    double random = measure(rounds, [&](int i) { sink = chained.findIndex(keys[i & keyMask].first, keys[i & keyMask].second); });
+    double sequential = measure(rounds, [&](int i) { sink = chained.findIndex(i / filePages % files, i % filePages); });
+    //替换:换出一个页面，装入同一文件中还不在表中的页面
+    int next = filePages;
+    double replace = measure(rounds / 8, [&](int i) {
+        int index = i % frames;
+        chained.remove(index);
+        chained.replace(index, index / filePages, next++);
+    });
+    line("MyHashMap", random, sequential, replace);
+    random = measure(rounds, [&](int i) { sink = table.findIndex(keys[i & keyMask].first, keys[i & keyMask].second); });
+    sequential = measure(rounds, [&](int i) { sink = table.findIndex(i / filePages % files, i % filePages); });
+    next = filePages;
+    replace = measure(rounds / 8, [&](int i) {
+        int index = i % frames;
+        table.remove(index);
+        table.replace(index, index / filePages, next++);
+    });
+    line("PageTable", random, sequential, replace);
+}
+
+int main(int argc, char **argv) {
+    bool checking, benching;
+    if (!parseMode(argc, argv, checking, benching)) return 2;
+    if (checking && !check()) return 1;
+    if (benching) {
+        //少数大文件，以及接近MAX_FILE_NUM个小文件
+        bench(8);
+        bench(120);
+    }
+    return 0;
+}
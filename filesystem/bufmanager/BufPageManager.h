@@ -1,49 +1,789 @@
 #ifndef BUF_PAGE_MANAGER
 #define BUF_PAGE_MANAGER
 
-#include "../utils/MyHashMap.h"
+#include "../utils/PageTable.h"
 #include "../utils/MyBitMap.h"
 #include "FindReplace.h"
+#include "LRUReplace.h"
+#include "ClockReplace.h"
+#include "TwoQueueReplace.h"
 #include "../utils/pagedef.h"
 #include "../fileio/FileManager.h"
 #include "../utils/MyLinkList.h"
+#include <sys/mman.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * 缓存管理器的启动参数
+ */
+struct BufPageOption {
+    ReplacePolicy policy = TWO_QUEUE_REPLACE;//替换算法
+    int capacity = CAP;//缓存页面个数
+    long long memoryLimit = 0;//缓存占用内存的上限，单位：字节，0表示不限制
+    bool hugePage = false;//是否使用大页
+    bool backgroundFlush = false;//是否启用后台写回线程
+    int dirtyHighWater = 10;//脏页占缓存页面的百分比超过该值时，后台线程不论替换顺序尽快写回脏页
+    int readAhead = 64;//顺序预读窗口的最大页面数，0表示不预读
+    bool mmapScan = false;//顺序扫描是否直接读取文件的只读映射
+    int partitions = 0;//默认页面大小的缓存分区个数，0表示根据缓存页面个数自动选择
+    long long classMemory = 0;//其它每种页面大小的缓存占用的内存，单位：字节，0表示默认页面大小的缓存的1/8
+};
+
+/*
+ * 缓存的访问计数
+ */
+struct BufCounter {
+    long long hits = 0;//访问时页面已经在缓存中的次数
+    long long misses = 0;//访问时需要从文件读入的次数
+    long long readAhead = 0;//预读装入缓存的页面个数
+    long long prefetched = 0;//打开数据库时预热装入缓存的页面个数
+    long long mapped = 0;//顺序扫描直接从只读映射中读取的页面个数
+    long long evictions = 0;//被替换算法换出的页面个数
+    long long writes = 0;//写回文件的页面个数
+
+    void add(const BufCounter &c) {
+        hits += c.hits;
+        misses += c.misses;
+        readAhead += c.readAhead;
+        prefetched += c.prefetched;
+        mapped += c.mapped;
+        evictions += c.evictions;
+        writes += c.writes;
+    }
+
+    bool empty() const {
+        return hits == 0 && misses == 0 && readAhead == 0 && prefetched == 0 && mapped == 0 && evictions == 0 && writes == 0;
+    }
+};
+
+/*
+ * 一个文件在缓存中的统计信息
+ */
+struct BufFileStats : BufCounter {
+    std::string name;//打开文件时使用的文件名
+    int fileID = -1;//文件id，文件已经关闭时为-1
+    int resident = 0;//驻留在缓存中的页面个数
+    int dirty = 0;//其中的脏页个数
+};
+
+/*
+ * 缓存的统计信息快照，计数部分为所有文件之和
+ */
+struct BufStats : BufCounter {
+    int capacity = 0;//缓存页面个数
+    int partitions = 0;//分区个数
+    std::vector<std::pair<int, int>> classes;//每个大小类的页面字节数和缓存页面个数
+    int resident = 0;//使用中的缓存页面个数
+    int dirty = 0;//脏页个数
+    int pinned = 0;//被固定的页面个数
+    long long dirtyEvictions = 0;//换出时在前台同步写回的脏页个数，包含在writes中
+    std::vector<BufFileStats> files;//打开的文件在前，已经关闭的文件在后
+};
 
 /*
  * BufPageManager
  * 实现了一个缓存的管理器
+ * 缓存页面按(fileID,pageID)的hash分到若干个分区，每个分区有自己的latch、页表、替换算法和链表，
+ * 不同分区的页面可以被多个线程同时获取
+ * 缓存页面数组下标是全局的，由下标可以直接算出所在分区
+ * 不同文件的页面大小可以不同，页面大小相同的缓存页面组成一个大小类，每个大小类有自己的内存区域和分区
+ * 修改缓存页面时需要先pin，或者在修改完成之后再调用markDirty，
+ * 这样后台线程写回时即使读到修改了一半的页面，页面也会被重新标记为脏页
  */
 struct BufPageManager {
 public:
-    int last;
+    /*
+     * 所有大小类的缓存页面个数之和
+     */
+    int capacity;
+    /*
+     * 所有大小类的分区个数之和
+     */
+    int partitionNum;
     FileManager *fileManager;
-    MyHashMap *hash;
-    FindReplace *replace;
     bool *dirty;
+    /*
+     * 每个缓存页面被固定的次数，大于0时不会被替换算法换出
+     */
+    int *pinCount;
     /*
      * 缓存页面数组
      */
     BufType *addr;
 
-    BufType allocMem() {
-        return new unsigned int[(PAGE_SIZE >> 2)];
+private:
+    /*
+     * 缓存分区，分区内的页面用从0开始的局部下标管理，全局下标为base+局部下标
+     * 分区内的所有信息以及分区内页面的dirty、pinCount、flushing、loading由latch保护
+     */
+    struct Partition {
+        std::mutex latch;
+        std::condition_variable ioDone;//分区内有页面读入或写回完成
+        int base;
+        int size;
+        int last;
+        int used;//存放了文件页面的缓存页面个数
+        PageTable *hash;
+        FindReplace *replace;
+        /*
+         * 每个文件驻留在分区中的页面链表，链表号为fileID
+         */
+        MyLinkList *fileList;
+        /*
+         * 每个文件在分区中的脏页链表，链表号为fileID
+         */
+        MyLinkList *dirtyList;
+        int dirtyCount;
+        int dirtyHighWater;//分区的脏页个数上限
+        /*
+         * 每个文件正在写回的页面个数，以及分区内正在写回的页面总数
+         */
+        int *flushingCount;
+        int flushingTotal;
+        /*
+         * 替换时找到干净页面和脏页的次数，脏页需要在前台同步写回
+         */
+        long long cleanEvictions, dirtyEvictions;
+        /*
+         * 每个文件在分区中的访问计数，下标为fileID，与分区的其它信息一样由latch保护
+         */
+        BufCounter *counters;
+    };
+
+    /*
+     * 页面大小相同的缓存页面，全局下标为[base, base+frames)，分区为[firstPart, firstPart+partNum)
+     * 所有缓存页面在一块连续的内存区域中
+     */
+    struct SizeClass {
+        int pageSize;
+        int base, frames;
+        int firstPart, partNum, partSize;
+        int readAheadMax;
+        void *arena;
+        size_t arenaSize;
+    };
+
+    /*
+     * 缓存页面和它对应的文件页
+     */
+    struct PageRef {
+        int fileID, pageID, index;
+    };
+
+    /*
+     * 后台线程每轮检查的替换候选页面个数和每个分区最多写回的页面个数
+     */
+    static constexpr int FLUSH_SCAN = 256;
+    static constexpr int FLUSH_BATCH = 64;
+    static constexpr int MIN_READ_AHEAD = 4;
+    /*
+     * 预热时每批装入的页面个数，每批按(fileID,pageID)排序后合并相邻页面
+     */
+    static constexpr int PREFETCH_BATCH = 256;
+    /*
+     * 自动选择分区个数时每个分区的页面数，以及分区个数的上限
+     */
+    static constexpr int PARTITION_PAGES = 4096;
+    static constexpr int MAX_PARTITIONS = 64;
+    /*
+     * 非默认页面大小的大小类至少包含的缓存页面个数
+     */
+    static constexpr int MIN_CLASS_FRAMES = 64;
+
+    /*
+     * 分区中所有页面都被固定时，getPage等待读入、写回完成或其它线程解除固定的最长毫秒数
+     */
+    static constexpr int PIN_WAIT_MS = 1000;
+
+    Partition *parts;
+    SizeClass classes[PAGE_CLASS_NUM];
+    /*
+     * 正在被写回的页面，以及正在从文件读入的页面，这些页面同时被固定
+     */
+    bool *flushing;
+    bool *loading;
+    /*
+     * 预读、预热或fetchPages装入之后还没有被访问过的页面，第一次访问只算一次访问，不会进入AM
+     */
+    bool *unreferenced;
+
+    std::mutex flushLatch;
+    std::condition_variable flushCond;//唤醒后台写回线程
+    std::thread flusher;
+    bool stopFlusher;
+    std::atomic<bool> wakeFlusher;
+
+    /*
+     * 每个文件的顺序访问状态：期望访问的下一页、连续顺序访问的页数和当前预读窗口
+     * 只用于预读的判断，多个线程同时更新时不加锁
+     */
+    std::atomic<int> *seqNext;
+    std::atomic<int> *seqCount;
+    std::atomic<int> *seqWindow;
+    bool mmapScan;
+
+    /*
+     * 已经关闭的文件的访问计数，按文件名累计
+     */
+    std::mutex statsLatch;
+    std::map<std::string, BufCounter> closedCounters;
+
+    /*
+     * 后台预热线程和等待装入的页面，页面按最近访问的先后排列
+     * 预热线程装入一批页面期间持有prefetchLatch，关闭文件时持有prefetchLatch删除该文件的页面
+     */
+    std::mutex prefetchLatch;
+    std::vector<PageRef> prefetchQueue;
+    size_t prefetchNext;
+    bool stopPrefetch;
+    std::thread prefetcher;
+
+    Partition &partOf(int index) {
+        int c = 0;
+        while (index >= classes[c].base + classes[c].frames) {
+            c++;
+        }
+        return parts[classes[c].firstPart + (index - classes[c].base) / classes[c].partSize];
     }
 
-    BufType fetchPage(int typeID, int pageID, int &index) {
-        BufType b;
-        index = replace->find();
-        b = addr[index];
-        if (b == nullptr) {
-            b = allocMem();
-            addr[index] = b;
+    SizeClass &classOf(int fileID) {
+        return classes[fileManager->getPageSizeIdx(fileID) - MIN_PAGE_SIZE_IDX];
+    }
+
+    Partition &partOf(int fileID, int pageID) {
+        //页表用hash的低位选择槽，分区用高位选择
+        SizeClass &sc = classOf(fileID);
+        return parts[sc.firstPart + (PageTable::hashKey(fileID, pageID) >> 40) % sc.partNum];
+    }
+
+    /*
+     * @函数名allocArena
+     * @参数sc:大小类
+     * @参数hugePage:是否使用大页
+     * 功能:用mmap一次性申请大小类的所有缓存页面，首地址按页对齐，物理内存在第一次访问时才分配
+     *           使用大页时先尝试MAP_HUGETLB，失败则退回普通页并用madvise建议内核使用透明大页
+     */
+    void allocArena(SizeClass &sc, bool hugePage) {
+        const size_t hugePageSize = 2 << 20;
+        size_t &arenaSize = sc.arenaSize;
+        void *&arena = sc.arena;
+        arenaSize = (size_t) sc.frames * sc.pageSize;
+        arena = MAP_FAILED;
+        if (hugePage) {
+            arenaSize = (arenaSize + hugePageSize - 1) / hugePageSize * hugePageSize;
+#ifdef MAP_HUGETLB
+            arena = mmap(nullptr, arenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+        }
+        if (arena == MAP_FAILED) {
+            arena = mmap(nullptr, arenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (arena == MAP_FAILED) {
+                cerr << "Allocate buffer pool failed!" << endl;
+                exit(-1);
+            }
+#ifdef MADV_HUGEPAGE
+            if (hugePage) {
+                madvise(arena, arenaSize, MADV_HUGEPAGE);
+            }
+#endif
+        }
+        for (int i = 0; i < sc.frames; ++i) {
+            addr[sc.base + i] = (BufType) ((char *) arena + (size_t) i * sc.pageSize);
+        }
+    }
+
+    void notifyFlusher() {
+        wakeFlusher = true;
+        flushCond.notify_one();
+    }
+
+    /*
+     * 以下带Partition参数的函数调用时必须持有part.latch
+     */
+    void setClean(Partition &part, int index) {
+        if (dirty[index]) {
+            dirty[index] = false;
+            part.dirtyList->del(index - part.base);
+            part.dirtyCount--;
+        }
+    }
+
+    /*
+     * 等待分区中fileID指定文件的页面写回完成，fileID为-1时等待所有文件
+     */
+    void waitFile(std::unique_lock<std::mutex> &lock, Partition &part, int fileID) {
+        part.ioDone.wait(lock, [&] { return fileID == -1 ? part.flushingTotal == 0 : part.flushingCount[fileID] == 0; });
+    }
+
+    void _access(Partition &part, int index) {
+        if (index == part.last) {
+            return;
+        }
+        part.replace->access(index - part.base);
+        part.last = index;
+    }
+
+    /*
+     * 等待分区中fileID指定文件页号不小于minPage的页面都解除固定，fileID为-1时等待分区中的所有页面
+     * 写回和读入的页面同时被固定，所以也等待它们完成；归还页面之前调用，其它句柄或线程固定的页面不会被重新使用
+     */
+    void waitUnpinned(std::unique_lock<std::mutex> &lock, Partition &part, int fileID, int minPage = 0) {
+        part.ioDone.wait(lock, [&] {
+            if (fileID == -1) {
+                for (int index = part.base; index < part.base + part.size; ++index) {
+                    if (pinCount[index] > 0) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            for (int local = part.fileList->getFirst(fileID); !part.fileList->isHead(local); local = part.fileList->next(local)) {
+                int f, p;
+                part.hash->getKeys(local, f, p);
+                if (p >= minPage && pinCount[part.base + local] > 0) {
+                    return false;
+                }
+            }
+            return true;
+        });
+    }
+
+    /*
+     * 归还index代表的缓存页面，调用时页面不能被固定
+     */
+    void _release(Partition &part, int index) {
+        int local = index - part.base;
+        if (!part.fileList->isAlone(local)) {
+            part.used--;
+        }
+        setClean(part, index);
+        unreferenced[index] = false;
+        part.fileList->del(local);
+        part.replace->free(local);
+        part.hash->remove(local);
+    }
+
+    void _invalidateFile(Partition &part, int fileID) {
+        int local = part.fileList->getFirst(fileID);
+        while (!part.fileList->isHead(local)) {
+            int next = part.fileList->next(local);
+            _release(part, part.base + local);
+            local = next;
+        }
+    }
+
+    PageRef makeRef(Partition &part, int index) {
+        PageRef ref;
+        part.hash->getKeys(index - part.base, ref.fileID, ref.pageID);
+        ref.index = index;
+        return ref;
+    }
+
+    /*
+     * @函数名fetchPage
+     * 功能:用分区的替换算法为(fileID,pageID)找到一个缓存页面并登记到页表中，index返回全局下标
+     *           换出的脏页在这里同步写回
+     * 返回:缓存页面的首地址，分区中所有页面都被固定时返回nullptr，index为-1
+     */
+    BufType fetchPage(Partition &part, int fileID, int pageID, int &index) {
+        //跳过被固定的页面
+        int local = part.replace->findUnpinned(pinCount + part.base, part.size);
+        if (local == -1) {
+            index = -1;
+            return nullptr;
+        }
+        index = part.base + local;
+        BufType b = addr[index];
+        if (dirty[index]) {
+            int k1, k2;
+            part.hash->getKeys(local, k1, k2);
+            fileManager->writePage(k1, k2, b, 0);
+            setClean(part, index);
+            part.dirtyEvictions++;
+            part.counters[k1].evictions++;
+            part.counters[k1].writes++;
+            //前台遇到了脏页，说明后台线程写回得不够快
+            notifyFlusher();
+        } else if (part.fileList->isAlone(local) == false) {
+            int k1, k2;
+            part.hash->getKeys(local, k1, k2);
+            part.cleanEvictions++;
+            part.counters[k1].evictions++;
         } else {
-            if (dirty[index]) {
-                int k1, k2;
-                hash->getKeys(index, k1, k2);
-                fileManager->writePage(k1, k2, b, 0);
-                dirty[index] = false;
+            part.used++;
+        }
+        part.hash->replace(local, fileID, pageID);
+        part.fileList->insert(fileID, local);
+        unreferenced[index] = false;
+        return b;
+    }
+
+    /*
+     * 取走一个脏页准备写回：清除脏页标记并固定页面，写回完成前页面不会被换出
+     * 写回期间页面被再次修改时会重新标记为脏页
+     */
+    void takeForFlush(Partition &part, int index, std::vector<PageRef> &batch) {
+        PageRef ref = makeRef(part, index);
+        setClean(part, index);
+        pinCount[index]++;
+        flushing[index] = true;
+        part.flushingCount[ref.fileID]++;
+        part.flushingTotal++;
+        part.counters[ref.fileID].writes++;
+        batch.push_back(ref);
+    }
+
+    /*
+     * takeForFlush取走的页面写回之后，解除固定并唤醒等待的线程
+     */
+    void finishFlush(const std::vector<PageRef> &batch) {
+        for (const PageRef &ref : batch) {
+            Partition &part = partOf(ref.index);
+            std::lock_guard<std::mutex> lock(part.latch);
+            pinCount[ref.index]--;
+            flushing[ref.index] = false;
+            part.flushingCount[ref.fileID]--;
+            part.flushingTotal--;
+            part.ioDone.notify_all();
+        }
+    }
+
+    /*
+     * @函数名writeRuns
+     * @参数pages:要写回的页面，函数内按(fileID,pageID)排序
+     * 功能:把同一文件中页号相邻的页面合并为一段，所有段一起交给writeRuns
+     *           页面必须已经被固定，调用时不需要持有latch
+     */
+    void writeRuns(std::vector<PageRef> &pages) {
+        std::sort(pages.begin(), pages.end(), [](const PageRef &a, const PageRef &b) {
+            return a.fileID != b.fileID ? a.fileID < b.fileID : a.pageID < b.pageID;
+        });
+        std::vector<BufType> bufs(pages.size());
+        std::vector<PageRun> runs;
+        for (size_t i = 0; i < pages.size(); ++i) {
+            bufs[i] = addr[pages[i].index];
+            if (i > 0 && pages[i].fileID == pages[i - 1].fileID && pages[i].pageID == pages[i - 1].pageID + 1) {
+                runs.back().n++;
+            } else {
+                runs.push_back({pages[i].fileID, pages[i].pageID, &bufs[i], 1});
+            }
+        }
+        fileManager->writeRuns(runs.data(), (int) runs.size());
+    }
+
+    /*
+     * @函数名flushPages
+     * @参数fileID:文件id，-1表示所有文件
+     * 功能:写回指定文件的所有脏页，页面仍然留在缓存中
+     *           先等待后台线程正在写回的页面，再从每个分区取走脏页，合并后一起写出
+     */
+    void flushPages(int fileID) {
+        std::vector<PageRef> batch;
+        int from = fileID == -1 ? 0 : fileID;
+        int to = fileID == -1 ? MAX_FILE_NUM : fileID + 1;
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            std::unique_lock<std::mutex> lock(part.latch);
+            waitFile(lock, part, fileID);
+            for (int f = from; f < to; ++f) {
+                int local = part.dirtyList->getFirst(f);
+                while (!part.dirtyList->isHead(local)) {
+                    int next = part.dirtyList->next(local);
+                    takeForFlush(part, part.base + local, batch);
+                    local = next;
+                }
+            }
+        }
+        writeRuns(batch);
+        finishFlush(batch);
+    }
+
+    /*
+     * 重置fileID的顺序访问状态，关闭文件后fileID会分配给其它文件
+     */
+    void resetSequential(int fileID) {
+        seqNext[fileID] = 0;
+        seqCount[fileID] = 0;
+        seqWindow[fileID] = 0;
+    }
+
+    /*
+     * @函数名detectSequential
+     * 返回:连续访问了至少3个相邻页面时返回true
+     * 功能:更新fileID的顺序访问状态，重复访问同一页面不改变状态
+     */
+    bool detectSequential(int fileID, int pageID) {
+        int next = seqNext[fileID];
+        if (pageID == next - 1) {
+            return seqCount[fileID] >= 2;
+        }
+        if (pageID == next) {
+            seqCount[fileID]++;
+        } else {
+            seqCount[fileID] = 0;
+            seqWindow[fileID] = 0;
+        }
+        seqNext[fileID] = pageID + 1;
+        return seqCount[fileID] >= 2;
+    }
+
+    /*
+     * @函数名loadPages
+     * @参数pages:要装入缓存的页面，同一文件中页号相邻的页面合并为一个读请求
+     * @参数freeOnly:为true时只使用分区中空闲的缓存页面，分区已满时跳过，不换出其它页面
+     * @参数prefetch:为true时计入预热页面数，否则计入预读页面数
+     * 功能:把pages中不在缓存中的页面装入缓存
+     *           页面先在各自的分区中登记并标记为正在读入，再把每段连续页面作为一个读请求一起交给readRuns
+     *           其它线程访问正在读入的页面时会等待读入完成
+     */
+    void loadPages(const std::vector<PageRef> &pages, bool freeOnly, bool prefetch) {
+        std::vector<BufType> bufs;
+        std::vector<int> frames;
+        std::vector<PageRun> runs;
+        bufs.reserve(pages.size());
+        for (const PageRef &ref : pages) {
+            Partition &part = partOf(ref.fileID, ref.pageID);
+            std::lock_guard<std::mutex> lock(part.latch);
+            if (part.hash->findIndex(ref.fileID, ref.pageID) != -1 || (freeOnly && part.used == part.size)) {
+                continue;
+            }
+            int index;
+            BufType b = fetchPage(part, ref.fileID, ref.pageID, index);
+            //预读和预热只是尽力而为，分区中的页面都被固定时跳过
+            if (b == nullptr) {
+                continue;
+            }
+            bufs.push_back(b);
+            pinCount[index]++;
+            loading[index] = true;
+            unreferenced[index] = true;
+            if (prefetch) {
+                part.counters[ref.fileID].prefetched++;
+            } else {
+                part.counters[ref.fileID].readAhead++;
+            }
+            frames.push_back(index);
+            if (!runs.empty() && runs.back().fileID == ref.fileID && runs.back().pageID + runs.back().n == ref.pageID) {
+                runs.back().n++;
+            } else {
+                runs.push_back({ref.fileID, ref.pageID, &bufs.back(), 1});
+            }
+        }
+        fileManager->readRuns(runs.data(), (int) runs.size());
+        for (int index : frames) {
+            Partition &part = partOf(index);
+            std::lock_guard<std::mutex> lock(part.latch);
+            pinCount[index]--;
+            loading[index] = false;
+            part.ioDone.notify_all();
+        }
+    }
+
+    /*
+     * @函数名readAheadFrom
+     * @参数fileID:文件id
+     * @参数pageID:刚刚读入的页号
+     * 功能:把pageID之后不在缓存中的页面装入缓存
+     *           上一个预读窗口被顺序用完时才会再次缺页，所以每次预读窗口加倍，直到上限
+     */
+    void readAheadFrom(int fileID, int pageID) {
+        int readAheadMax = classOf(fileID).readAheadMax;
+        if (readAheadMax <= 0) {
+            return;
+        }
+        int window = seqWindow[fileID] == 0 ? MIN_READ_AHEAD : seqWindow[fileID] * 2;
+        window = std::min(window, readAheadMax);
+        seqWindow[fileID] = window;
+        int end = std::min(pageID + window, fileManager->getPageCount(fileID) - 1);
+        if (end <= pageID) {
+            return;
+        }
+        std::vector<PageRef> pages;
+        for (int p = pageID + 1; p <= end; ++p) {
+            pages.push_back({fileID, p, -1});
+        }
+        loadPages(pages, false, false);
+    }
+
+    /*
+     * @函数名prefetchLoop
+     * 功能:后台预热线程，按最近访问的先后每次取出一批页面，排序后装入空闲的缓存页面
+     *           缓存已满或者所有页面装入完成时退出
+     */
+    void prefetchLoop() {
+        while (true) {
+            std::lock_guard<std::mutex> lock(prefetchLatch);
+            if (stopPrefetch || prefetchNext >= prefetchQueue.size()) {
+                return;
+            }
+            size_t end = std::min(prefetchQueue.size(), prefetchNext + PREFETCH_BATCH);
+            std::vector<PageRef> batch(prefetchQueue.begin() + prefetchNext, prefetchQueue.begin() + end);
+            prefetchNext = end;
+            std::sort(batch.begin(), batch.end(), [](const PageRef &a, const PageRef &b) {
+                return a.fileID != b.fileID ? a.fileID < b.fileID : a.pageID < b.pageID;
+            });
+            loadPages(batch, true, true);
+            bool full = true;
+            for (int i = 0; i < partitionNum && full; ++i) {
+                std::lock_guard<std::mutex> partLock(parts[i].latch);
+                full = parts[i].used == parts[i].size;
+            }
+            if (full) {
+                return;
+            }
+        }
+    }
+
+    /*
+     * @函数名cancelPrefetch
+     * @参数fileID:文件id，-1表示所有文件
+     * 功能:从预热队列中删除fileID指定文件的页面，等待正在装入的一批页面完成
+     *           fileID为-1时同时等待预热线程退出
+     */
+    void cancelPrefetch(int fileID) {
+        {
+            std::lock_guard<std::mutex> lock(prefetchLatch);
+            if (fileID == -1) {
+                stopPrefetch = true;
+            } else {
+                prefetchQueue.erase(std::remove_if(prefetchQueue.begin() + prefetchNext, prefetchQueue.end(),
+                                                   [&](const PageRef &ref) { return ref.fileID == fileID; }),
+                                    prefetchQueue.end());
+            }
+        }
+        if (fileID == -1 && prefetcher.joinable()) {
+            prefetcher.join();
+        }
+    }
+
+    /*
+     * @函数名flushRound
+     * 功能:后台写回线程的一轮工作
+     *           在每个分区中先写回替换顺序最靠前的脏页，使前台替换时尽量找到干净页面
+     *           分区的脏页超过上限时再从该分区各文件的脏页链表中补充
+     *           写回按(fileID,pageID)排序，相邻页面合并为一次写
+     *           被固定的页面不会被换出，键在写回期间保持不变，写回时不需要持有latch
+     */
+    void flushRound() {
+        std::vector<PageRef> batch;
+        std::vector<int> candidates(FLUSH_SCAN);
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            std::lock_guard<std::mutex> lock(part.latch);
+            size_t limit = batch.size() + FLUSH_BATCH;
+            int n = part.replace->victims(candidates.data(), FLUSH_SCAN);
+            for (int k = 0; k < n && batch.size() < limit; ++k) {
+                int index = part.base + candidates[k];
+                if (dirty[index] && pinCount[index] == 0) {
+                    takeForFlush(part, index, batch);
+                }
+            }
+            for (int f = 0; f < MAX_FILE_NUM && part.dirtyCount > part.dirtyHighWater && batch.size() < limit; ++f) {
+                int local = part.dirtyList->getFirst(f);
+                while (!part.dirtyList->isHead(local) && batch.size() < limit) {
+                    int next = part.dirtyList->next(local);
+                    if (pinCount[part.base + local] == 0) {
+                        takeForFlush(part, part.base + local, batch);
+                    }
+                    local = next;
+                }
+            }
+        }
+        writeRuns(batch);
+        finishFlush(batch);
+    }
+
+    void flushLoop() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(flushLatch);
+                flushCond.wait_for(lock, std::chrono::milliseconds(50), [&] { return stopFlusher || wakeFlusher; });
+                if (stopFlusher) {
+                    return;
+                }
+                wakeFlusher = false;
+            }
+            flushRound();
+        }
+    }
+
+    /*
+     * @函数名lookup
+     * 功能:getPage和pinPage的实现，pin为true时在持有latch时固定页面
+     *           缺页而分区中所有页面都被固定时，等待读入、写回完成或其它线程解除固定，
+     *           等待期间其它线程可能已经装入了同一页面，所以醒来后重新查找页表
+     *           超过PIN_WAIT_MS毫秒仍然没有可以换出的页面时返回nullptr，index为-1
+     */
+    BufType lookup(int fileID, int pageID, int &index, bool useOnce, bool pin) {
+        bool sequential = detectSequential(fileID, pageID);
+        Partition &part = partOf(fileID, pageID);
+        std::unique_lock<std::mutex> lock(part.latch);
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(PIN_WAIT_MS);
+        bool timedOut = false;
+        BufType b;
+        while (true) {
+            int local = part.hash->findIndex(fileID, pageID);
+            if (local == -1) {
+                b = fetchPage(part, fileID, pageID, index);
+                if (b != nullptr) {
+                    break;
+                }
+                if (timedOut) {
+                    cerr << "All buffer pages are pinned!" << endl;
+                    return nullptr;
+                }
+                timedOut = part.ioDone.wait_until(lock, deadline) == std::cv_status::timeout;
+                continue;
+            }
+            index = part.base + local;
+            if (loading[index]) {
+                part.ioDone.wait(lock, [&] { return !loading[index]; });
+                continue;
+            }
+            //装入后第一次访问与getPage之后紧接着的access都不是再次访问，只有再次访问才让页面进入AM
+            if (unreferenced[index]) {
+                part.replace->accessOnce(local);
+                unreferenced[index] = false;
+                part.last = index;
+            } else if (index != part.last) {
+                if (useOnce) part.replace->accessOnce(local);
+                else part.replace->access(local);
+                part.last = index;
+            }
+            if (pin) {
+                pinCount[index]++;
+            }
+            part.counters[fileID].hits++;
+            return addr[index];
+        }
+        part.counters[fileID].misses++;
+        //调用者紧接着的access不算再次访问
+        part.last = index;
+        pinCount[index]++;
+        loading[index] = true;
+        lock.unlock();
+        fileManager->readPage(fileID, pageID, b, 0);
+        lock.lock();
+        loading[index] = false;
+        part.ioDone.notify_all();
+        lock.unlock();
+        //预读期间刚读入的页面保持固定，不会被预读的页面换出
+        if (useOnce || sequential) {
+            readAheadFrom(fileID, pageID);
+        }
+        if (!pin) {
+            lock.lock();
+            if (--pinCount[index] == 0) {
+                part.ioDone.notify_all();
             }
         }
-        hash->replace(index, typeID, pageID);
         return b;
     }
 
@@ -54,7 +794,7 @@ public:
      * @参数pageID:文件页号，表示在fileID指定的文件中，第几个文件页
      * @参数index:函数返回时，用来记录缓存页面数组中的下标
      * @参数ifRead:是否要将文件页中的内容读到缓存中
-     * 返回:缓存页面的首地址
+     * 返回:缓存页面的首地址，分区中所有页面都被固定时返回nullptr
      * 功能:为文件中的某一个页面获取一个缓存中的页面
      *           缓存中的页面在缓存页面数组中的下标记录在index中
      *           并根据ifRead是否为true决定是否将文件中的内容写到获取的缓存页面中
@@ -62,8 +802,16 @@ public:
      *           如果确信指定的文件页面不在缓存中，那么就不用在hash表中进行查找，直接调用替换算法，节省时间
      */
     BufType allocPage(int fileID, int pageID, int &index, bool ifRead = false) {
-        BufType b = fetchPage(fileID, pageID, index);
+        Partition &part = partOf(fileID, pageID);
+        std::lock_guard<std::mutex> lock(part.latch);
+        BufType b = fetchPage(part, fileID, pageID, index);
+        if (b == nullptr) {
+            cerr << "All buffer pages are pinned!" << endl;
+            return nullptr;
+        }
+        part.last = index;
         if (ifRead) {
+            part.counters[fileID].misses++;
             fileManager->readPage(fileID, pageID, b, 0);
         }
         return b;
@@ -74,24 +822,60 @@ public:
      * @参数fileID:文件id
      * @参数pageID:文件页号
      * @参数index:函数返回时，用来记录缓存页面数组中的下标
-     * 返回:缓存页面的首地址
+     * @参数useOnce:是否为只使用一次的访问(如顺序扫描)，这样的访问不会提高页面在替换算法中的优先级
+     * 返回:缓存页面的首地址，缺页而分区中所有页面都被固定时返回nullptr，index为-1
      * 功能:为文件中的某一个页面在缓存中找到对应的缓存页面
      *           文件页面由(fileID,pageID)指定
      *           缓存中的页面在缓存页面数组中的下标记录在index中
-     *           首先，在hash表中查找(fileID,pageID)对应的缓存页面，
-     *           如果能找到，那么表示文件页面在缓存中
-     *           如果没有找到，那么就利用替换算法获取一个页面
-     */
-    BufType getPage(int fileID, int pageID, int &index) {
-        index = hash->findIndex(fileID, pageID);
-        if (index != -1) {
-            access(index);
-            return addr[index];
-        } else {
-            BufType b = fetchPage(fileID, pageID, index);
-            fileManager->readPage(fileID, pageID, b, 0);
-            return b;
+     *           首先，在分区的hash表中查找(fileID,pageID)对应的缓存页面，
+     *           如果能找到，那么表示文件页面在缓存中，页面正在读入时等待读入完成
+     *           如果没有找到，那么就利用分区的替换算法获取一个页面，读文件时不持有latch
+     *           顺序访问(useOnce或连续访问相邻页面)缺页时，同时预读之后的页面
+     */
+    BufType getPage(int fileID, int pageID, int &index, bool useOnce = false) {
+        return lookup(fileID, pageID, index, useOnce, false);
+    }
+
+    /*
+     * @函数名pinPage
+     * @参数fileID:文件id
+     * @参数pageID:文件页号
+     * @参数index:函数返回时，用来记录缓存页面数组中的下标
+     * 返回:缓存页面的首地址，与getPage相同，可能返回nullptr
+     * 功能:与getPage相同，但在返回之前固定页面，相当于getPage之后调用pin
+     *           多个线程同时使用缓存时，getPage和pin之间页面可能被其它线程换出，需要用pinPage
+     */
+    BufType pinPage(int fileID, int pageID, int &index) {
+        return lookup(fileID, pageID, index, false, true);
+    }
+
+    /*
+     * @函数名getScanPage
+     * @参数fileID:文件id
+     * @参数pageID:文件页号
+     * @参数index:函数返回时，用来记录缓存页面数组中的下标，页面来自只读映射时为-1
+     * @参数pin:是否固定返回的缓存页面
+     * 返回:页面的首地址，只能读取，与getPage相同，可能返回nullptr
+     * 功能:顺序扫描读取页面
+     *           启用只读映射时，不在缓存中的页面直接返回文件映射中的地址，不复制、不查找替换
+     *           在缓存中的页面可能有尚未写回的修改，仍然返回缓存页面
+     *           不固定时返回的地址在下一次调用缓存管理器之前有效；固定时在index不为-1的情况下用unpin解除固定，
+     *           解除固定或关闭文件之前地址一直有效
+     */
+    BufType getScanPage(int fileID, int pageID, int &index, bool pin = false) {
+        if (mmapScan) {
+            Partition &part = partOf(fileID, pageID);
+            std::lock_guard<std::mutex> lock(part.latch);
+            index = part.hash->findIndex(fileID, pageID);
+            if (index == -1) {
+                BufType b = fileManager->mapPage(fileID, pageID);
+                if (b != nullptr) {
+                    part.counters[fileID].mapped++;
+                    return b;
+                }
+            }
         }
+        return lookup(fileID, pageID, index, true, pin);
     }
 
     /*
@@ -100,11 +884,24 @@ public:
      * 功能:标记index代表的缓存页面被访问过，为替换算法提供信息
      */
     void access(int index) {
-        if (index == last) {
+        Partition &part = partOf(index);
+        std::lock_guard<std::mutex> lock(part.latch);
+        _access(part, index);
+    }
+
+    /*
+     * @函数名accessOnce
+     * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
+     * 功能:标记index代表的缓存页面被访问过，但该访问只使用一次，替换算法不会因此保留该页面
+     */
+    void accessOnce(int index) {
+        Partition &part = partOf(index);
+        std::lock_guard<std::mutex> lock(part.latch);
+        if (index == part.last) {
             return;
         }
-        replace->access(index);
-        last = index;
+        part.replace->accessOnce(index - part.base);
+        part.last = index;
     }
 
     /*
@@ -114,35 +911,77 @@ public:
      *           保证数据的正确性
      */
     void markDirty(int index) {
+        Partition &part = partOf(index);
+        std::lock_guard<std::mutex> lock(part.latch);
+        if (!dirty[index]) {
+            int f, p;
+            part.hash->getKeys(index - part.base, f, p);
+            part.dirtyList->insert(f, index - part.base);
+            part.dirtyCount++;
+            if (part.dirtyCount > part.dirtyHighWater) {
+                notifyFlusher();
+            }
+        }
         dirty[index] = true;
-        access(index);
+        _access(part, index);
+    }
+
+    /*
+     * @函数名pin
+     * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
+     * 功能:固定index代表的缓存页面，在调用unpin之前该页面不会被替换算法换出
+     */
+    void pin(int index) {
+        Partition &part = partOf(index);
+        std::lock_guard<std::mutex> lock(part.latch);
+        pinCount[index]++;
+        _access(part, index);
+    }
+
+    /*
+     * @函数名unpin
+     * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
+     * 功能:解除一次对index代表的缓存页面的固定，页面仍然留在缓存中，
+     *           脏页推迟到被替换算法换出或close时再写回
+     */
+    void unpin(int index) {
+        Partition &part = partOf(index);
+        std::lock_guard<std::mutex> lock(part.latch);
+        if (pinCount[index] > 0 && --pinCount[index] == 0) {
+            part.ioDone.notify_all();
+        }
     }
 
     /*
      * @函数名release
      * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
      * 功能:将index代表的缓存页面归还给缓存管理器，在归还前，缓存页面中的数据不标记写回
+     *           页面被固定(包括正在读入或写回)时等待解除固定
      */
     void release(int index) {
-        dirty[index] = false;
-        replace->free(index);
-        hash->remove(index);
+        Partition &part = partOf(index);
+        std::unique_lock<std::mutex> lock(part.latch);
+        part.ioDone.wait(lock, [&] { return pinCount[index] == 0; });
+        _release(part, index);
     }
 
     /*
      * @函数名writeBack
      * @参数index:缓存页面数组中的下标，用来表示一个缓存页面
      * 功能:将index代表的缓存页面归还给缓存管理器，在归还前，缓存页面中的数据需要根据脏页标记决定是否写到对应的文件页面中
+     *           页面被固定(包括正在读入或写回)时等待解除固定
      */
     void writeBack(int index) {
+        Partition &part = partOf(index);
+        std::unique_lock<std::mutex> lock(part.latch);
+        part.ioDone.wait(lock, [&] { return pinCount[index] == 0; });
         if (dirty[index]) {
             int f, p;
-            hash->getKeys(index, f, p);
+            part.hash->getKeys(index - part.base, f, p);
             fileManager->writePage(f, p, addr[index], 0);
-            dirty[index] = false;
+            part.counters[f].writes++;
         }
-        replace->free(index);
-        hash->remove(index);
+        _release(part, index);
     }
 
     /*
@@ -150,11 +989,284 @@ public:
      * 功能:将所有缓存页面归还给缓存管理器，归还前需要根据脏页标记决定是否写到对应的文件页面中
      */
     void close() {
-        for (int i = 0; i < CAP; ++i) {
-            writeBack(i);
+        cancelPrefetch(-1);
+        flushPages(-1);
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            std::unique_lock<std::mutex> lock(part.latch);
+            waitUnpinned(lock, part, -1);
+            for (int index = part.base; index < part.base + part.size; ++index) {
+                _release(part, index);
+            }
+        }
+    }
+
+    /*
+     * @函数名flushFile
+     * @参数fileID:文件id
+     * 功能:将fileID指定文件的所有脏页写回，页面仍然留在缓存中
+     */
+    void flushFile(int fileID) {
+        flushPages(fileID);
+    }
+
+    /*
+     * @函数名evictFile
+     * @参数fileID:文件id
+     * 功能:将fileID指定文件的所有缓存页面归还给缓存管理器，归还前写回脏页
+     *           关闭文件时调用，之后fileID可以分配给其它文件
+     */
+    void evictFile(int fileID) {
+        flushPages(fileID);
+        invalidateFile(fileID);
+    }
+
+    /*
+     * @函数名invalidateFile
+     * @参数fileID:文件id
+     * 功能:将fileID指定文件的所有缓存页面归还给缓存管理器，脏页不写回
+     *           删除文件时调用，文件的页面被固定时等待解除固定
+     *           文件的访问计数按文件名转入已关闭文件的统计，之后fileID可以分配给其它文件
+     */
+    void invalidateFile(int fileID) {
+        cancelPrefetch(fileID);
+        BufCounter closed;
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            std::unique_lock<std::mutex> lock(part.latch);
+            waitUnpinned(lock, part, fileID);
+            _invalidateFile(part, fileID);
+            closed.add(part.counters[fileID]);
+            part.counters[fileID] = BufCounter();
+        }
+        resetSequential(fileID);
+        const std::string &name = fileManager->getFileName(fileID);
+        if (!closed.empty() && !name.empty()) {
+            std::lock_guard<std::mutex> lock(statsLatch);
+            closedCounters[name].add(closed);
         }
     }
 
+    /*
+     * @函数名truncateFile
+     * @参数fileID:文件id
+     * @参数pageCount:保留的页面个数
+     * 功能:丢弃fileID指定文件中页号不小于pageCount的缓存页面，脏页不写回，再把磁盘上的文件截断为pageCount个页面
+     *           被截掉的页面被固定时等待解除固定
+     * 返回:成功操作返回0，截断失败返回-1
+     */
+    int truncateFile(int fileID, int pageCount) {
+        cancelPrefetch(fileID);
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            std::unique_lock<std::mutex> lock(part.latch);
+            waitUnpinned(lock, part, fileID, pageCount);
+            int local = part.fileList->getFirst(fileID);
+            while (!part.fileList->isHead(local)) {
+                int next = part.fileList->next(local);
+                int f, p;
+                part.hash->getKeys(local, f, p);
+                if (p >= pageCount) {
+                    _release(part, part.base + local);
+                }
+                local = next;
+            }
+        }
+        resetSequential(fileID);
+        return fileManager->truncateFile(fileID, pageCount);
+    }
+
+    /*
+     * @函数名getStats
+     * 返回:缓存统计信息的快照
+     * 功能:依次锁住每个分区，汇总各文件的访问计数、驻留页面数和脏页数
+     *           各分区不是在同一时刻读取的，多个线程同时访问缓存时总数可能相差几次访问
+     */
+    BufStats getStats() {
+        BufStats stats;
+        stats.capacity = capacity;
+        stats.partitions = partitionNum;
+        for (const SizeClass &sc : classes) {
+            stats.classes.emplace_back(sc.pageSize, sc.frames);
+        }
+        std::vector<BufFileStats> files(MAX_FILE_NUM);
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            std::lock_guard<std::mutex> lock(part.latch);
+            stats.dirtyEvictions += part.dirtyEvictions;
+            for (int f = 0; f < MAX_FILE_NUM; ++f) {
+                files[f].add(part.counters[f]);
+                for (int local = part.fileList->getFirst(f); !part.fileList->isHead(local); local = part.fileList->next(local)) {
+                    files[f].resident++;
+                }
+                for (int local = part.dirtyList->getFirst(f); !part.dirtyList->isHead(local); local = part.dirtyList->next(local)) {
+                    files[f].dirty++;
+                }
+            }
+            for (int index = part.base; index < part.base + part.size; ++index) {
+                if (pinCount[index] > 0) {
+                    stats.pinned++;
+                }
+            }
+        }
+        for (int f = 0; f < MAX_FILE_NUM; ++f) {
+            files[f].name = fileManager->getFileName(f);
+            files[f].fileID = f;
+            if (!files[f].name.empty() || files[f].resident > 0 || !files[f].empty()) {
+                stats.files.push_back(files[f]);
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(statsLatch);
+            for (const auto &closed : closedCounters) {
+                BufFileStats file;
+                file.add(closed.second);
+                file.name = closed.first;
+                stats.files.push_back(file);
+            }
+        }
+        for (const BufFileStats &file : stats.files) {
+            stats.add(file);
+            stats.resident += file.resident;
+            stats.dirty += file.dirty;
+        }
+        return stats;
+    }
+
+    /*
+     * @函数名resetStats
+     * 功能:清零所有访问计数，包括已经关闭的文件的计数，驻留页面数和脏页数不受影响
+     */
+    void resetStats() {
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            std::lock_guard<std::mutex> lock(part.latch);
+            part.cleanEvictions = part.dirtyEvictions = 0;
+            for (int f = 0; f < MAX_FILE_NUM; ++f) {
+                part.counters[f] = BufCounter();
+            }
+        }
+        std::lock_guard<std::mutex> lock(statsLatch);
+        closedCounters.clear();
+    }
+
+    /*
+     * @函数名getResidentPages
+     * 返回:缓存中所有文件页面的(fileID,pageID)，最近访问的在前
+     * 功能:每个分区按替换算法给出的换出顺序倒序排列，替换算法没有给出顺序的页面(如时钟算法中刚被访问的页面)排在最前
+     *           各分区的页面交替排列，分区由hash选择，交替排列近似为整个缓存的访问顺序
+     */
+    std::vector<std::pair<int, int>> getResidentPages() {
+        std::vector<std::vector<std::pair<int, int>>> lists(partitionNum);
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            std::lock_guard<std::mutex> lock(part.latch);
+            std::vector<int> order(part.size);
+            std::vector<bool> ordered(part.size, false);
+            int n = part.replace->victims(order.data(), part.size);
+            for (int k = 0; k < n; ++k) {
+                ordered[order[k]] = true;
+            }
+            std::vector<std::pair<int, int>> &list = lists[i];
+            auto add = [&](int local) {
+                if (!part.fileList->isAlone(local)) {
+                    int f, p;
+                    part.hash->getKeys(local, f, p);
+                    list.emplace_back(f, p);
+                }
+            };
+            for (int local = 0; local < part.size; ++local) {
+                if (!ordered[local]) {
+                    add(local);
+                }
+            }
+            for (int k = n - 1; k >= 0; --k) {
+                add(order[k]);
+            }
+        }
+        std::vector<std::pair<int, int>> pages;
+        for (size_t k = 0;; ++k) {
+            bool more = false;
+            for (auto &list : lists) {
+                if (k < list.size()) {
+                    pages.push_back(list[k]);
+                    more = true;
+                }
+            }
+            if (!more) {
+                break;
+            }
+        }
+        return pages;
+    }
+
+    /*
+     * @函数名prefetch
+     * @参数pages:要装入缓存的(fileID,pageID)，最近访问的在前
+     * 功能:启动后台预热线程，把pages中的页面按批装入空闲的缓存页面，查询可以同时进行
+     *           超出文件长度的页面被忽略，缓存已满时停止，不会换出已经在缓存中的页面
+     */
+    void prefetch(const std::vector<std::pair<int, int>> &pages) {
+        cancelPrefetch(-1);
+        prefetchQueue.clear();
+        prefetchNext = 0;
+        stopPrefetch = false;
+        std::vector<int> pageCount(MAX_FILE_NUM, -1);
+        for (const auto &page : pages) {
+            int fileID = page.first;
+            if (fileID < 0 || fileID >= MAX_FILE_NUM) {
+                continue;
+            }
+            if (pageCount[fileID] == -1) {
+                pageCount[fileID] = fileManager->getPageCount(fileID);
+            }
+            if (page.second >= 0 && page.second < pageCount[fileID]) {
+                prefetchQueue.push_back({fileID, page.second, -1});
+            }
+        }
+        if (!prefetchQueue.empty()) {
+            prefetcher = std::thread(&BufPageManager::prefetchLoop, this);
+        }
+    }
+
+    /*
+     * @函数名maxScanThreads
+     * @参数fileID:文件id
+     * 返回:能同时顺序扫描该文件的线程数上限，至少为1
+     * 功能:每个扫描线程缺页预读期间最多固定一个预读窗口加两个页面，
+     *           所有线程固定的页面不超过缓存页面的1/8，替换算法总能找到没有被固定的页面
+     */
+    int maxScanThreads(int fileID) {
+        const SizeClass &sc = classOf(fileID);
+        return std::max(1, sc.frames / 8 / (sc.readAheadMax + 2));
+    }
+
+    /*
+     * @函数名fetchLimit
+     * @参数fileID:文件id
+     * 返回:fetchPages一次装入的页面个数上限，至少为1
+     * 功能:一批页面不超过缓存页面的1/8，使用之前不会被同一批的其它页面换出
+     */
+    int fetchLimit(int fileID) {
+        return std::max(1, classOf(fileID).frames / 8);
+    }
+
+    /*
+     * @函数名fetchPages
+     * @参数fileID:文件id
+     * @参数pageIDs:即将访问的页号，从小到大排列且没有重复，个数不超过fetchLimit
+     * 功能:按索引取出记录之前调用，把不在缓存中的页面一起装入缓存，计入预读页面数
+     *           相邻的页面合并为一个读请求，所有请求一起交给readRuns，使用io_uring时同时进行
+     */
+    void fetchPages(int fileID, const std::vector<int> &pageIDs) {
+        std::vector<PageRef> pages;
+        pages.reserve(pageIDs.size());
+        for (int pageID : pageIDs) {
+            pages.push_back({fileID, pageID, -1});
+        }
+        loadPages(pages, false, false);
+    }
+
     /*
      * @函数名getKey
      * @参数index:缓存页面数组中的下标，用来指定一个缓存页面
@@ -162,33 +1274,193 @@ public:
      * @参数pageID:函数返回时，用于存储指定缓存页面对应的文件页号
      */
     void getKey(int index, int &fileID, int &pageID) {
-        hash->getKeys(index, fileID, pageID);
+        Partition &part = partOf(index);
+        std::lock_guard<std::mutex> lock(part.latch);
+        part.hash->getKeys(index - part.base, fileID, pageID);
+    }
+
+    /*
+     * @函数名classFrames
+     * @参数pageSize:大小类的页面字节数
+     * @参数classMemory:每种非默认页面大小的缓存占用的内存
+     * 返回:该大小类的缓存页面个数，至少MIN_CLASS_FRAMES个
+     */
+    static int classFrames(int pageSize, long long classMemory) {
+        return (int) std::max<long long>(MIN_CLASS_FRAMES, classMemory / pageSize);
+    }
+
+    /*
+     * @函数名createReplace
+     * @参数policy:替换算法的种类
+     * @参数c:缓存页面的容量上限
+     * 返回:对应的替换算法
+     */
+    static FindReplace *createReplace(ReplacePolicy policy, int c) {
+        switch (policy) {
+            case LRU_REPLACE:
+                return new LRUReplace(c);
+            case CLOCK_REPLACE:
+                return new ClockReplace(c);
+            default:
+                return new TwoQueueReplace(c);
+        }
     }
 
     /*
      * 构造函数
      * @参数fm:文件管理器，缓存管理器需要利用文件管理器与磁盘进行交互
+     * @参数option:启动参数，包括替换算法、缓存页面个数、内存上限、是否使用大页、后台写回、预读窗口、只读映射、分区个数和各大小类的内存
+     *           option.capacity和option.partitions只用于默认页面大小，其它页面大小的缓存各占option.classMemory字节
+     *           设置了内存上限时，先从上限中扣除其它页面大小的缓存(每种至少MIN_CLASS_FRAMES个页面，连同管理信息)，
+     *           默认页面大小的缓存页面个数会减少到页面及其管理信息不超过余下的内存，余下的内存不够时报错退出
+     *           每个分区至少64个页面，分区个数会相应减少
      */
-    BufPageManager(FileManager *fm) {
-        int c = CAP;
-        int m = MOD;
-        last = -1;
+    BufPageManager(FileManager *fm, const BufPageOption &option = BufPageOption()) {
+        int c = option.capacity;
+        long long classMemory = option.classMemory;
+        if (option.memoryLimit > 0) {
+            if (classMemory <= 0) {
+                classMemory = option.memoryLimit / 16;
+            }
+            //每个页面除了页面本身，还需要约128字节的管理信息
+            //其它页面大小的缓存按实际的页面个数扣除，页面个数被提高到MIN_CLASS_FRAMES时也不会超过上限
+            long long reserved = 0;
+            for (int k = 0; k < PAGE_CLASS_NUM; ++k) {
+                int pageSize = 1 << (MIN_PAGE_SIZE_IDX + k);
+                if (pageSize != PAGE_SIZE) {
+                    reserved += classFrames(pageSize, classMemory) * (pageSize + 128LL);
+                }
+            }
+            long long limit = (option.memoryLimit - reserved) / (PAGE_SIZE + 128);
+            if (limit < c) {
+                c = (int) limit;
+            }
+        }
+        if (c <= 0) {
+            cerr << "Buffer pool is too small!" << endl;
+            exit(-1);
+        }
+        if (classMemory <= 0) {
+            classMemory = (long long) c * PAGE_SIZE / 8;
+        }
+        capacity = 0;
+        partitionNum = 0;
+        for (int k = 0; k < PAGE_CLASS_NUM; ++k) {
+            SizeClass &sc = classes[k];
+            sc.pageSize = 1 << (MIN_PAGE_SIZE_IDX + k);
+            bool isDefault = sc.pageSize == PAGE_SIZE;
+            sc.frames = isDefault ? c : classFrames(sc.pageSize, classMemory);
+            int n = isDefault && option.partitions > 0 ? option.partitions : sc.frames / PARTITION_PAGES;
+            n = std::max(1, std::min(n, std::min(MAX_PARTITIONS, sc.frames / 64)));
+            sc.partSize = (sc.frames + n - 1) / n;
+            sc.partNum = (sc.frames + sc.partSize - 1) / sc.partSize;
+            sc.base = capacity;
+            sc.firstPart = partitionNum;
+            //预读窗口不超过大小类的1/8，预读不会换出正在使用的页面
+            sc.readAheadMax = std::min(option.readAhead, sc.frames / 8);
+            capacity += sc.frames;
+            partitionNum += sc.partNum;
+        }
+        c = capacity;
         fileManager = fm;
-        dirty = new bool[CAP];
-        addr = new BufType[CAP];
-        hash = new MyHashMap(c, m);
-        replace = new FindReplace(c);
-        for (int i = 0; i < CAP; ++i) {
+        dirty = new bool[c];
+        pinCount = new int[c];
+        flushing = new bool[c];
+        loading = new bool[c];
+        unreferenced = new bool[c];
+        addr = new BufType[c];
+        for (int i = 0; i < c; ++i) {
             dirty[i] = false;
-            addr[i] = nullptr;
+            pinCount[i] = 0;
+            flushing[i] = false;
+            loading[i] = false;
+            unreferenced[i] = false;
         }
+        parts = new Partition[partitionNum];
+        for (int i = 0; i < partitionNum; ++i) {
+            Partition &part = parts[i];
+            int k = 0;
+            while (i >= classes[k].firstPart + classes[k].partNum) {
+                k++;
+            }
+            const SizeClass &sc = classes[k];
+            part.base = sc.base + (i - sc.firstPart) * sc.partSize;
+            part.size = std::min(sc.partSize, sc.base + sc.frames - part.base);
+            part.last = -1;
+            part.used = 0;
+            part.hash = new PageTable(part.size);
+            part.replace = createReplace(option.policy, part.size);
+            part.fileList = new MyLinkList(part.size, MAX_FILE_NUM);
+            part.dirtyList = new MyLinkList(part.size, MAX_FILE_NUM);
+            part.dirtyCount = 0;
+            part.dirtyHighWater = (int) ((long long) sc.partSize * option.dirtyHighWater / 100);
+            part.flushingCount = new int[MAX_FILE_NUM];
+            for (int f = 0; f < MAX_FILE_NUM; ++f) {
+                part.flushingCount[f] = 0;
+            }
+            part.flushingTotal = 0;
+            part.cleanEvictions = part.dirtyEvictions = 0;
+            part.counters = new BufCounter[MAX_FILE_NUM];
+        }
+        seqNext = new std::atomic<int>[MAX_FILE_NUM];
+        seqCount = new std::atomic<int>[MAX_FILE_NUM];
+        seqWindow = new std::atomic<int>[MAX_FILE_NUM];
+        for (int i = 0; i < MAX_FILE_NUM; ++i) {
+            resetSequential(i);
+        }
+        mmapScan = option.mmapScan;
+        prefetchNext = 0;
+        stopPrefetch = false;
+        for (SizeClass &sc : classes) {
+            allocArena(sc, option.hugePage);
+        }
+        stopFlusher = false;
+        wakeFlusher = false;
+        if (option.backgroundFlush) {
+            flusher = std::thread(&BufPageManager::flushLoop, this);
+        }
+        //文件真正关闭之前写回并归还它的缓存页面，文件将被删除时直接丢弃
+        fileManager->setCloseHandler([this](int fileID, bool discard) {
+            if (discard) {
+                invalidateFile(fileID);
+            } else {
+                evictFile(fileID);
+            }
+        });
     }
 
     ~BufPageManager() {
+        fileManager->setCloseHandler(nullptr);
+        cancelPrefetch(-1);
+        if (flusher.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(flushLatch);
+                stopFlusher = true;
+            }
+            flushCond.notify_one();
+            flusher.join();
+        }
+        for (SizeClass &sc : classes) {
+            munmap(sc.arena, sc.arenaSize);
+        }
+        for (int i = 0; i < partitionNum; ++i) {
+            delete parts[i].hash;
+            delete parts[i].replace;
+            delete parts[i].fileList;
+            delete parts[i].dirtyList;
+            delete[] parts[i].flushingCount;
+            delete[] parts[i].counters;
+        }
+        delete[] parts;
         delete[] dirty;
+        delete[] pinCount;
+        delete[] flushing;
+        delete[] loading;
+        delete[] unreferenced;
         delete[] addr;
-        delete hash;
-        delete replace;
+        delete[] seqNext;
+        delete[] seqCount;
+        delete[] seqWindow;
     }
 };
 
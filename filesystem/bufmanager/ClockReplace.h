@@ -0,0 +1,62 @@
+#ifndef BUF_CLOCK
+#define BUF_CLOCK
+
+#include "FindReplace.h"
+
+/*
+ * ClockReplace
+ * CLOCK替换算法，每个页面一个访问位，指针循环扫描，跳过并清除访问位为1的页面
+ */
+class ClockReplace : public FindReplace {
+private:
+    bool *ref;//访问位
+    int hand;//时钟指针
+    int CAP_;
+public:
+    void free(int index) override {
+        ref[index] = false;
+    }
+
+    void access(int index) override {
+        ref[index] = true;
+    }
+
+    int find() override {
+        while (ref[hand]) {
+            ref[hand] = false;
+            hand = (hand + 1) % CAP_;
+        }
+        int index = hand;
+        hand = (hand + 1) % CAP_;
+        return index;
+    }
+
+    int victims(int *out, int n) override {
+        int k = 0;
+        for (int i = 0, index = hand; i < CAP_ && k < n; ++i, index = (index + 1) % CAP_) {
+            if (!ref[index]) {
+                out[k++] = index;
+            }
+        }
+        return k;
+    }
+
+    /*
+     * 构造函数
+     * @参数c:表示缓存页面的容量上限
+     */
+    ClockReplace(int c) {
+        CAP_ = c;
+        hand = 0;
+        ref = new bool[c];
+        for (int i = 0; i < CAP_; ++i) {
+            ref[i] = false;
+        }
+    }
+
+    ~ClockReplace() override {
+        delete[] ref;
+    }
+};
+
+#endif
@@ -1,60 +1,79 @@
 #ifndef BUF_SEARCH
 #define BUF_SEARCH
 
-#include "../utils/MyLinkList.h"
-#include "../utils/MyHashMap.h"
-#include "../utils/pagedef.h"
-//template <int CAP_>
+/*
+ * 替换算法的种类，在启动时选择
+ */
+enum ReplacePolicy {
+    LRU_REPLACE,
+    CLOCK_REPLACE,
+    TWO_QUEUE_REPLACE
+};
+
 /*
  * FindReplace
- * 提供替换算法接口，这里实现的是栈式LRU算法
+ * 提供替换算法接口，具体的替换算法见LRUReplace、ClockReplace和TwoQueueReplace
  */
 class FindReplace {
-private:
-    MyLinkList *list;
-    int CAP_;
 public:
     /*
      * @函数名free
      * @参数index:缓存页面数组中页面的下标
      * 功能:将缓存页面数组中第index个页面的缓存空间回收
-     *           下一次通过find函数寻找替换页面时，直接返回index
+     *           下一次通过find函数寻找替换页面时，优先返回index
      */
-    void free(int index) {
-        list->insertFirst(0, index);
-    }
+    virtual void free(int index) = 0;
 
     /*
      * @函数名access
      * @参数index:缓存页面数组中页面的下标
      * 功能:将缓存页面数组中第index个页面标记为访问
      */
-    void access(int index) {
-        list->insert(0, index);
-    }
+    virtual void access(int index) = 0;
+
+    /*
+     * @函数名accessOnce
+     * @参数index:缓存页面数组中页面的下标
+     * 功能:将缓存页面数组中第index个页面标记为只使用一次的访问，例如顺序扫描
+     *           这样的访问不会让页面变得更难被替换
+     */
+    virtual void accessOnce(int index) {}
 
     /*
      * @函数名find
      * 功能:根据替换算法返回缓存页面数组中要被替换页面的下标
+     *           返回的页面视为刚刚装入了新的文件页面
      */
-    int find() {
-        int index = list->getFirst(0);
-        list->del(index);
-        list->insert(0, index);
-        return index;
-    }
+    virtual int find() = 0;
 
     /*
-     * 构造函数
-     * @参数c:表示缓存页面的容量上限
+     * @函数名findUnpinned
+     * @参数pinCount:每个页面被固定的次数，下标与替换算法中的页面下标相同
+     * @参数size:缓存页面的个数
+     * 返回:要被替换的没有被固定的页面下标，所有页面都被固定时返回-1
+     * 功能:反复调用find跳过被固定的页面，find连续返回size个被固定的页面时认为所有页面都被固定
+     *           find不会轮流返回所有页面的替换算法需要重写这个函数
      */
-    FindReplace(int c) {
-        CAP_ = c;
-        list = new MyLinkList(c, 1);
-        for (int i = 0; i < CAP_; ++i) {
-            list->insert(0, i);
+    virtual int findUnpinned(const int *pinCount, int size) {
+        for (int i = 0; i < size; ++i) {
+            int index = find();
+            if (pinCount[index] == 0) {
+                return index;
+            }
         }
+        return -1;
     }
+
+    /*
+     * @函数名victims
+     * @参数out:函数返回时，按替换顺序存储接下来最可能被替换的页面下标
+     * @参数n:最多返回的页面个数
+     * 返回:存储在out中的页面个数
+     * 功能:只查看替换顺序，不改变替换算法的状态，供后台写回线程提前写回即将被替换的脏页
+     */
+    virtual int victims(int *out, int n) = 0;
+
+    virtual ~FindReplace() {}
 };
 
 #endif
@@ -0,0 +1,56 @@
+#ifndef BUF_LRU
+#define BUF_LRU
+
+#include "../utils/MyLinkList.h"
+#include "FindReplace.h"
+
+/*
+ * LRUReplace
+ * 栈式LRU替换算法
+ */
+class LRUReplace : public FindReplace {
+private:
+    MyLinkList *list;
+    int CAP_;
+public:
+    void free(int index) override {
+        list->insertFirst(0, index);
+    }
+
+    void access(int index) override {
+        list->insert(0, index);
+    }
+
+    int find() override {
+        int index = list->getFirst(0);
+        list->del(index);
+        list->insert(0, index);
+        return index;
+    }
+
+    int victims(int *out, int n) override {
+        int k = 0;
+        for (int index = list->getFirst(0); k < n && !list->isHead(index); index = list->next(index)) {
+            out[k++] = index;
+        }
+        return k;
+    }
+
+    /*
+     * 构造函数
+     * @参数c:表示缓存页面的容量上限
+     */
+    LRUReplace(int c) {
+        CAP_ = c;
+        list = new MyLinkList(c, 1);
+        for (int i = 0; i < CAP_; ++i) {
+            list->insert(0, i);
+        }
+    }
+
+    ~LRUReplace() override {
+        delete list;
+    }
+};
+
+#endif
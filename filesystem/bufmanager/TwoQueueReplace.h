@@ -0,0 +1,119 @@
+#ifndef BUF_TWO_QUEUE
+#define BUF_TWO_QUEUE
+
+#include "../utils/MyLinkList.h"
+#include "FindReplace.h"
+
+/*
+ * TwoQueueReplace
+ * 简化的2Q替换算法，能抵抗顺序扫描对缓存的冲刷
+ * 新装入的页面先进入先进先出的A1队列，在A1中被再次访问才进入LRU的Am队列
+ * A1超过容量的1/4时优先从A1中替换，所以只访问一次的扫描页面不会挤掉Am中的热点页面
+ */
+class TwoQueueReplace : public FindReplace {
+private:
+    static const int FREE = 0;//空闲页面
+    static const int A1 = 1;//只访问过一次的页面
+    static const int AM = 2;//被多次访问的页面
+    MyLinkList *list;
+    int *queue;//每个页面所在的队列
+    int a1Size;//A1队列中的页面数
+    int a1Cap;//A1队列的容量
+    int CAP_;
+
+    void moveTo(int q, int index) {
+        if (queue[index] == A1) a1Size--;
+        if (q == A1) a1Size++;
+        queue[index] = q;
+        list->insert(q, index);
+    }
+
+public:
+    void free(int index) override {
+        if (queue[index] == A1) a1Size--;
+        queue[index] = FREE;
+        list->insertFirst(FREE, index);
+    }
+
+    void access(int index) override {
+        if (queue[index] != FREE) {
+            moveTo(AM, index);
+        }
+    }
+
+    int find() override {
+        int index = list->getFirst(FREE);
+        if (list->isHead(index)) {
+            int am = list->getFirst(AM);
+            if (a1Size > a1Cap || list->isHead(am)) {
+                index = list->getFirst(A1);
+            } else {
+                index = am;
+            }
+        }
+        moveTo(A1, index);
+        return index;
+    }
+
+    /*
+     * find只从一个队列中替换，A1中的页面都被固定时会一直返回A1中的页面
+     * 这里按替换顺序依次查看两个队列，跳过被固定的页面，不改变它们的位置
+     */
+    int findUnpinned(const int *pinCount, int size) override {
+        int index = list->getFirst(FREE);
+        if (list->isHead(index)) {
+            int am = list->getFirst(AM);
+            int first = (a1Size > a1Cap || list->isHead(am)) ? A1 : AM;
+            int order[2] = {first, first == A1 ? AM : A1};
+            index = -1;
+            for (int q : order) {
+                for (int i = list->getFirst(q); index == -1 && !list->isHead(i); i = list->next(i)) {
+                    if (pinCount[i] == 0) {
+                        index = i;
+                    }
+                }
+            }
+            if (index == -1) {
+                return -1;
+            }
+        }
+        moveTo(A1, index);
+        return index;
+    }
+
+    int victims(int *out, int n) override {
+        int k = 0;
+        int am = list->getFirst(AM);
+        int first = (a1Size > a1Cap || list->isHead(am)) ? A1 : AM;
+        int order[2] = {first, first == A1 ? AM : A1};
+        for (int q : order) {
+            for (int index = list->getFirst(q); k < n && !list->isHead(index); index = list->next(index)) {
+                out[k++] = index;
+            }
+        }
+        return k;
+    }
+
+    /*
+     * 构造函数
+     * @参数c:表示缓存页面的容量上限
+     */
+    TwoQueueReplace(int c) {
+        CAP_ = c;
+        a1Size = 0;
+        a1Cap = c / 4;
+        list = new MyLinkList(c, 3);
+        queue = new int[c];
+        for (int i = 0; i < CAP_; ++i) {
+            queue[i] = FREE;
+            list->insert(FREE, i);
+        }
+    }
+
+    ~TwoQueueReplace() override {
+        delete list;
+        delete[] queue;
+    }
+};
+
+#endif
@@ -8,35 +8,287 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <string.h>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include <sys/mman.h>
+#include "UringQueue.h"
+#include "../utils/MyLinkList.h"
 
 using namespace std;
 
+/*
+ * 文件读写的后端，在启动时选择
+ */
+enum IOBackend {
+    SYNC_IO,//preadv/pwritev同步读写
+    URING_IO//io_uring批量异步读写，不可用时退回SYNC_IO
+};
+
+/*
+ * 文件中的一段连续页面，bufs[i]对应第pageID+i页
+ */
+struct PageRun {
+    int fileID;
+    int pageID;
+    BufType *bufs;
+    int n;
+};
+
 class FileManager {
 private:
     //FileTable* ftable;
     int fd[MAX_FILE_NUM];
+    /*
+     * 每个文件页面字节数以2为底的指数，打开文件时从第0页的PAGE_SIZE_OFFSET处读取
+     */
+    int pageSizeIdx[MAX_FILE_NUM];
+    /*
+     * 打开文件时使用的文件名，用于统计信息中区分文件，关闭后为空
+     */
+    string fileName[MAX_FILE_NUM];
+    /*
+     * 打开文件的缓存：文件名到fileID的映射，以及每个文件被打开的次数
+     * 打开次数减到0的文件不立即关闭，按最近关闭的先后放在idleList中，再次打开时直接返回原来的fileID
+     * 打开的文件数达到上限或者空闲的文件超过MAX_IDLE_FILE时，才真正关闭最早空闲的文件
+     */
+    unordered_map<string, int> nameToID;
+    int refCount[MAX_FILE_NUM];
+    MyLinkList *idleList;
+    int openNum, idleNum;
+    static constexpr int MAX_IDLE_FILE = MAX_FILE_NUM / 2;
+    std::mutex fileLatch;
+    /*
+     * 真正关闭文件之前调用，参数为fileID和文件是否将被删除，缓存管理器用它写回或者丢弃文件的缓存页面
+     */
+    std::function<void(int, bool)> closeHandler;
     MyBitMap *fm;
     MyBitMap *tm;
+    /*
+     * 前台、后台写回和预热线程不持有uringLatch读取，io_uring出错时在uringLatch中改为SYNC_IO
+     */
+    std::atomic<IOBackend> backend;
+    /*
+     * 是否用O_DIRECT打开文件，绕过内核页缓存，页面只缓存在BufPageManager中
+     * 读写的内存地址、文件偏移量和长度都必须按块对齐，缓存页面由mmap分配，页面大小至少为4KB
+     */
+    bool directIO;
+    /*
+     * 只读映射：每个文件预留一段连续的虚拟地址，文件变长时在预留区域内向后扩展映射，
+     * 已经返回的页面地址在关闭文件之前一直有效
+     */
+    char *mapBase[MAX_FILE_NUM];
+    size_t mapLen[MAX_FILE_NUM];
+    static constexpr size_t MAP_RESERVE = (size_t) 1 << 36;
+    std::mutex mapLatch;
+    UringQueue uring;
+    /*
+     * 前台和后台写回线程共用一个io_uring
+     */
+    std::mutex uringLatch;
+    static constexpr int URING_ENTRIES = 64;
 
-    int _createFile(const char *name) {
-        FILE *f = fopen(name, "a+");
-        if (f == nullptr) {
-            cout << "fail" << endl;
+    int _createFile(const char *name, int pageSize) {
+        int f = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (f == -1) {
+            cerr << "Create file " << name << " failed!" << endl;
             return -1;
         }
-        fclose(f);
+        //第0页只记录页面大小，打开文件时据此确定页面大小，之后由表或索引写入信息头
+        std::vector<char> page(pageSize, 0);
+        memcpy(page.data() + PAGE_SIZE_OFFSET, &pageSize, sizeof(int));
+        ssize_t r = pwrite(f, page.data(), pageSize, 0);
+        close(f);
+        return r == pageSize ? 0 : -1;
+    }
+
+    /*
+     * @函数名transfer
+     * 功能:readPages和writePages的实现，iovec个数超过IOV_MAX时分多次调用，
+     *           并处理被信号中断和只完成了一部分的读写
+     */
+    int transfer(int fileID, int pageID, BufType *bufs, int n, bool isWrite) {
+        const int maxIov = IOV_MAX < 1024 ? IOV_MAX : 1024;
+        struct iovec iov[maxIov];
+        const size_t pageSize = (size_t) 1 << pageSizeIdx[fileID];
+        off_t offset = (off_t) pageID << pageSizeIdx[fileID];
+        size_t total = (size_t) n * pageSize;
+        size_t done = 0;
+        while (done < total) {
+            //从done所在的页面开始构造iovec
+            int first = (int) (done / pageSize);
+            int cnt = 0;
+            for (int i = first; i < n && cnt < maxIov; ++i, ++cnt) {
+                iov[cnt].iov_base = (void *) bufs[i];
+                iov[cnt].iov_len = pageSize;
+            }
+            size_t skip = done % pageSize;
+            iov[0].iov_base = (char *) iov[0].iov_base + skip;
+            iov[0].iov_len -= skip;
+            ssize_t r = isWrite ? pwritev(fd[fileID], iov, cnt, offset + done) : preadv(fd[fileID], iov, cnt, offset + done);
+            if (r < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                cerr << (isWrite ? "Write" : "Read") << " file " << fileID << " page " << pageID + first << " failed!" << endl;
+                return -1;
+            }
+            if (r == 0) {
+                if (isWrite) {
+                    return -1;
+                }
+                //读到文件末尾，剩下的页面视为全0
+                for (int i = first; i < n; ++i) {
+                    size_t from = i == first ? skip : 0;
+                    memset((char *) bufs[i] + from, 0, pageSize - from);
+                }
+                return 0;
+            }
+            done += r;
+        }
         return 0;
     }
 
+    /*
+     * @函数名transferRuns
+     * 功能:readRuns和writeRuns的实现
+     *           每段按IOV_MAX拆分为若干请求，每批最多URING_ENTRIES个请求同时交给io_uring
+     *           没有完整完成的请求(出错、读到文件末尾或只完成了一部分)改用同步读写重做
+     */
+    int transferRuns(PageRun *runs, int k, bool isWrite) {
+        if (backend == SYNC_IO || k <= 1) {
+            int ret = 0;
+            for (int i = 0; i < k; ++i) {
+                if (transfer(runs[i].fileID, runs[i].pageID, runs[i].bufs, runs[i].n, isWrite) != 0) {
+                    ret = -1;
+                }
+            }
+            return ret;
+        }
+        const int maxIov = IOV_MAX < 1024 ? IOV_MAX : 1024;
+        struct Chunk {
+            int run, first, n;
+        };
+        std::vector<Chunk> chunks;
+        int pages = 0;
+        for (int i = 0; i < k; ++i) {
+            for (int first = 0; first < runs[i].n; first += maxIov) {
+                chunks.push_back({i, first, std::min(maxIov, runs[i].n - first)});
+            }
+            pages += runs[i].n;
+        }
+        std::vector<struct iovec> iov(pages);
+        std::vector<int> iovStart(chunks.size());
+        for (size_t c = 0, pos = 0; c < chunks.size(); ++c) {
+            iovStart[c] = (int) pos;
+            for (int j = 0; j < chunks[c].n; ++j, ++pos) {
+                iov[pos].iov_base = (void *) runs[chunks[c].run].bufs[chunks[c].first + j];
+                iov[pos].iov_len = getPageSize(runs[chunks[c].run].fileID);
+            }
+        }
+        std::vector<bool> retry(chunks.size(), true);
+        std::lock_guard<std::mutex> lock(uringLatch);
+        //等待uringLatch期间其它线程可能已经关闭io_uring，这时所有请求都同步完成
+        for (size_t begin = 0; begin < chunks.size() && backend == URING_IO; begin += URING_ENTRIES) {
+            size_t end = std::min(chunks.size(), begin + URING_ENTRIES);
+            for (size_t c = begin; c < end; ++c) {
+                const PageRun &run = runs[chunks[c].run];
+                uring.push(fd[run.fileID], &iov[iovStart[c]], chunks[c].n,
+                           (off_t) (run.pageID + chunks[c].first) << pageSizeIdx[run.fileID], isWrite, c);
+            }
+            if (uring.submitAndWait((unsigned) (end - begin)) != 0) {
+                //可能已经提交了一部分请求，它们仍在读写缓存页面，全部完成之后才能同步重做
+                //之后不再使用io_uring，关闭时丢弃队列中残留的未提交请求
+                if (uring.drain() != 0) {
+                    cerr << "io_uring requests could not be reaped!" << endl;
+                }
+                uring.shutdown();
+                cerr << "io_uring failed, fall back to synchronous I/O!" << endl;
+                backend = SYNC_IO;
+                break;
+            }
+            unsigned long long c;
+            int res;
+            while (uring.pop(c, res)) {
+                retry[c] = res != chunks[c].n * getPageSize(runs[chunks[c].run].fileID);
+            }
+        }
+        int ret = 0;
+        for (size_t c = 0; c < chunks.size(); ++c) {
+            if (retry[c]) {
+                const PageRun &run = runs[chunks[c].run];
+                if (transfer(run.fileID, run.pageID + chunks[c].first, run.bufs + chunks[c].first, chunks[c].n, isWrite) != 0) {
+                    ret = -1;
+                }
+            }
+        }
+        return ret;
+    }
+
     int _openFile(const char *name, int fileID) {
-        int f = open(name, O_RDWR);
+        int f = -1;
+#ifdef O_DIRECT
+        if (directIO) {
+            f = open(name, O_RDWR | O_DIRECT);
+            //文件系统不支持O_DIRECT时(如tmpfs)退回经过内核页缓存的读写
+            if (f == -1 && errno == EINVAL) {
+                cerr << "O_DIRECT is not supported for " << name << ", use buffered I/O." << endl;
+            }
+        }
+#endif
+        if (f == -1) {
+            f = open(name, O_RDWR);
+        }
         if (f == -1) {
             return -1;
         }
         fd[fileID] = f;
+        //旧文件的第0页在PAGE_SIZE_OFFSET处为0，使用默认的页面大小
+        pageSizeIdx[fileID] = PAGE_SIZE_IDX;
+        alignas(MIN_PAGE_SIZE) char head[MIN_PAGE_SIZE];
+        if (pread(f, head, MIN_PAGE_SIZE, 0) == MIN_PAGE_SIZE) {
+            int pageSize;
+            memcpy(&pageSize, head + PAGE_SIZE_OFFSET, sizeof(int));
+            for (int idx = MIN_PAGE_SIZE_IDX; idx <= MAX_PAGE_SIZE_IDX; ++idx) {
+                if (pageSize == 1 << idx) {
+                    pageSizeIdx[fileID] = idx;
+                }
+            }
+        }
         return 0;
     }
 
+    /*
+     * @函数名_closeFile
+     * @参数fileID:空闲的文件
+     * @参数discard:文件是否将被删除，删除时不写回缓存页面
+     * 功能:真正关闭文件，同时解除文件的只读映射，调用时必须持有fileLatch
+     */
+    void _closeFile(int fileID, bool discard) {
+        if (closeHandler) {
+            closeHandler(fileID, discard);
+        }
+        std::unique_lock<std::mutex> lock(mapLatch);
+        if (mapBase[fileID] != nullptr) {
+            munmap(mapBase[fileID], MAP_RESERVE);
+            mapBase[fileID] = nullptr;
+            mapLen[fileID] = 0;
+        }
+        lock.unlock();
+        idleList->del(fileID);
+        idleNum--;
+        openNum--;
+        nameToID.erase(fileName[fileID]);
+        fileName[fileID].clear();
+        fm->setBit(fileID, 1);
+        close(fd[fileID]);
+    }
+
 public:
     /*
      * FilManager构造函数
@@ -44,6 +296,46 @@ public:
     FileManager() {
         fm = new MyBitMap(MAX_FILE_NUM, 1);
         tm = new MyBitMap(MAX_TYPE_NUM, 1);
+        backend = SYNC_IO;
+        directIO = false;
+        for (int i = 0; i < MAX_FILE_NUM; ++i) {
+            mapBase[i] = nullptr;
+            mapLen[i] = 0;
+            refCount[i] = 0;
+            pageSizeIdx[i] = PAGE_SIZE_IDX;
+        }
+        idleList = new MyLinkList(MAX_FILE_NUM, 1);
+        openNum = idleNum = 0;
+    }
+
+    /*
+     * @函数名setDirectIO
+     * @参数direct:之后打开的文件是否使用O_DIRECT
+     * 功能:应在启动时调用，只有缓存管理器的页面可以用于读写
+     */
+    void setDirectIO(bool direct) {
+        directIO = direct;
+    }
+
+    /*
+     * @函数名setBackend
+     * @参数b:读写后端
+     * 功能:选择读写后端，应在启动时调用
+     * 返回:选择的后端可用返回true，io_uring不可用时退回同步读写并返回false
+     */
+    bool setBackend(IOBackend b) {
+        backend = SYNC_IO;
+        if (b == URING_IO) {
+            if (!uring.init(URING_ENTRIES)) {
+                return false;
+            }
+            backend = URING_IO;
+        }
+        return true;
+    }
+
+    IOBackend getBackend() const {
+        return backend.load();
     }
 
     /*
@@ -53,19 +345,11 @@ public:
      * @参数buf:存储信息的缓存(4字节无符号整数数组)
      * @参数off:偏移量
      * 功能:将buf+off开始的2048个四字节整数(8kb信息)写入fileID和pageID指定的文件页中
-     * 返回:成功操作返回0
+     * 返回:成功操作返回0，写入失败返回-1
      */
     int writePage(int fileID, int pageID, BufType buf, int off) {
-        int f = fd[fileID];
-        off_t offset = pageID;
-        offset = (offset << PAGE_SIZE_IDX);
-        off_t error = lseek(f, offset, SEEK_SET);
-        if (error != offset) {
-            return -1;
-        }
         BufType b = buf + off;
-        error = write(f, (void *) b, PAGE_SIZE);
-        return 0;
+        return writePages(fileID, pageID, &b, 1);
     }
 
     /*
@@ -75,44 +359,234 @@ public:
      * @参数buf:存储信息的缓存(4字节无符号整数数组)
      * @参数off:偏移量
      * 功能:将fileID和pageID指定的文件页中2048个四字节整数(8kb)读入到buf+off开始的内存中
-     * 返回:成功操作返回0
+     *           超出文件末尾的部分填0
+     * 返回:成功操作返回0，读取失败返回-1
      */
     int readPage(int fileID, int pageID, BufType buf, int off) {
-        //int f = fd[fID[type]];
-        int f = fd[fileID];
-        off_t offset = pageID;
-        offset = (offset << PAGE_SIZE_IDX);
-        off_t error = lseek(f, offset, SEEK_SET);
-        if (error != offset) {
+        BufType b = buf + off;
+        return readPages(fileID, pageID, &b, 1);
+    }
+
+    /*
+     * @函数名writePages
+     * @参数fileID:文件id
+     * @参数pageID:起始页号
+     * @参数bufs:n个缓存页面的首地址
+     * @参数n:页面个数
+     * 功能:将bufs中的n个页面依次写入从pageID开始的连续文件页中，用pwritev一次系统调用写出
+     *           使用指定位置的读写，不修改文件偏移量，可以被多个线程同时调用
+     * 返回:成功操作返回0，写入失败返回-1
+     */
+    int writePages(int fileID, int pageID, BufType *bufs, int n) {
+        return transfer(fileID, pageID, bufs, n, true);
+    }
+
+    /*
+     * @函数名readPages
+     * @参数fileID:文件id
+     * @参数pageID:起始页号
+     * @参数bufs:n个缓存页面的首地址
+     * @参数n:页面个数
+     * 功能:将从pageID开始的n个连续文件页读入bufs中，用preadv一次系统调用读入
+     *           超出文件末尾的部分填0
+     * 返回:成功操作返回0，读取失败返回-1
+     */
+    int readPages(int fileID, int pageID, BufType *bufs, int n) {
+        return transfer(fileID, pageID, bufs, n, false);
+    }
+
+    /*
+     * @函数名writeRuns
+     * @参数runs:k段连续页面
+     * @参数k:段数
+     * 功能:写出多段连续页面，使用io_uring时所有段同时进行
+     * 返回:成功操作返回0，写入失败返回-1
+     */
+    int writeRuns(PageRun *runs, int k) {
+        return transferRuns(runs, k, true);
+    }
+
+    /*
+     * @函数名readRuns
+     * @参数runs:k段连续页面
+     * @参数k:段数
+     * 功能:读入多段连续页面，使用io_uring时所有段同时进行，超出文件末尾的部分填0
+     * 返回:成功操作返回0，读取失败返回-1
+     */
+    int readRuns(PageRun *runs, int k) {
+        return transferRuns(runs, k, false);
+    }
+
+    /*
+     * @函数名getPageCount
+     * @参数fileID:文件id
+     * 返回:磁盘上文件的完整页面个数
+     */
+    int getPageCount(int fileID) {
+        struct stat st;
+        if (fstat(fd[fileID], &st) != 0) {
+            return 0;
+        }
+        return (int) (st.st_size >> pageSizeIdx[fileID]);
+    }
+
+    /*
+     * @函数名truncateFile
+     * @参数fileID:文件id
+     * @参数pageCount:保留的页面个数
+     * 功能:把磁盘上的文件截断为pageCount个页面，只读映射中超出新长度的部分换回预留的空地址
+     *           调用者应先丢弃缓存中被截掉的页面
+     * 返回:成功操作返回0，截断失败返回-1
+     */
+    int truncateFile(int fileID, int pageCount) {
+        std::lock_guard<std::mutex> lock(mapLatch);
+        size_t len = (size_t) pageCount << pageSizeIdx[fileID];
+        if (mapLen[fileID] > len) {
+            mmap(mapBase[fileID] + len, mapLen[fileID] - len, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_FIXED, -1, 0);
+            mapLen[fileID] = len;
+        }
+        if (ftruncate(fd[fileID], (off_t) len) != 0) {
+            cerr << "Truncate file " << fileID << " failed!" << endl;
             return -1;
         }
-        BufType b = buf + off;
-        error = read(f, (void *) b, PAGE_SIZE);
         return 0;
     }
 
+    /*
+     * @函数名getPageSize
+     * @参数fileID:文件id
+     * 返回:文件的页面字节数
+     */
+    int getPageSize(int fileID) {
+        return 1 << pageSizeIdx[fileID];
+    }
+
+    /*
+     * @函数名getPageSizeIdx
+     * @参数fileID:文件id
+     * 返回:文件的页面字节数以2为底的指数
+     */
+    int getPageSizeIdx(int fileID) {
+        return pageSizeIdx[fileID];
+    }
+
+    /*
+     * @函数名mapPage
+     * @参数fileID:文件id
+     * @参数pageID:文件页号
+     * 返回:文件页在只读映射中的地址，页面超出磁盘上的文件长度或映射失败时返回nullptr
+     * 功能:第一次调用时为文件预留地址空间，之后按需把文件映射到预留区域中
+     *           映射与pwrite共用内核页缓存，写回的页面在映射中立即可见，但缓存中未写回的修改不可见
+     */
+    BufType mapPage(int fileID, int pageID) {
+        std::lock_guard<std::mutex> lock(mapLatch);
+        size_t end = ((size_t) pageID + 1) << pageSizeIdx[fileID];
+        if (end > mapLen[fileID]) {
+            size_t len = (size_t) getPageCount(fileID) << pageSizeIdx[fileID];
+            if (end > len || len > MAP_RESERVE) {
+                return nullptr;
+            }
+            if (mapBase[fileID] == nullptr) {
+                void *base = mmap(nullptr, MAP_RESERVE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+                if (base == MAP_FAILED) {
+                    return nullptr;
+                }
+                mapBase[fileID] = (char *) base;
+            }
+            void *m = mmap(mapBase[fileID] + mapLen[fileID], len - mapLen[fileID], PROT_READ,
+                           MAP_SHARED | MAP_FIXED, fd[fileID], (off_t) mapLen[fileID]);
+            if (m == MAP_FAILED) {
+                return nullptr;
+            }
+            madvise(m, len - mapLen[fileID], MADV_SEQUENTIAL);
+            mapLen[fileID] = len;
+        }
+        return (BufType) (mapBase[fileID] + ((size_t) pageID << pageSizeIdx[fileID]));
+    }
+
     /*
      * @函数名closeFile
      * @参数fileID:用于区别已经打开的文件
-     * 功能:关闭文件
+     * 功能:关闭一次文件，文件的打开次数减到0时放入空闲文件的缓存，文件仍然打开，缓存页面仍然保留
+     *           空闲的文件超过MAX_IDLE_FILE时，真正关闭最早空闲的文件
      * 返回:操作成功，返回0
      */
     int closeFile(int fileID) {
-        fm->setBit(fileID, 1);
-        int f = fd[fileID];
-        close(f);
+        std::lock_guard<std::mutex> lock(fileLatch);
+        if (refCount[fileID] <= 0) {
+            return -1;
+        }
+        if (--refCount[fileID] == 0) {
+            idleList->insert(0, fileID);
+            idleNum++;
+            while (idleNum > MAX_IDLE_FILE) {
+                _closeFile(idleList->getFirst(0), false);
+            }
+        }
         return 0;
     }
 
+    /*
+     * @函数名closeIdleFiles
+     * 功能:真正关闭所有空闲的文件，关闭前写回它们的缓存页面
+     *           关闭数据库时调用，之后其它数据库中的同名文件不会用到这些文件
+     */
+    void closeIdleFiles() {
+        std::lock_guard<std::mutex> lock(fileLatch);
+        while (idleNum > 0) {
+            _closeFile(idleList->getFirst(0), false);
+        }
+    }
+
+    /*
+     * @函数名removeFile
+     * @参数name:文件名
+     * 功能:删除name指定的文件，文件在空闲文件的缓存中时先关闭并丢弃它的缓存页面
+     * 返回:操作成功，返回true；文件仍然被打开时返回false
+     */
+    bool removeFile(const char *name) {
+        std::lock_guard<std::mutex> lock(fileLatch);
+        auto it = nameToID.find(name);
+        if (it != nameToID.end()) {
+            if (refCount[it->second] > 0) {
+                cerr << "File " << name << " is still open!" << endl;
+                return false;
+            }
+            _closeFile(it->second, true);
+        }
+        return remove(name) == 0;
+    }
+
+    /*
+     * @函数名setCloseHandler
+     * @参数handler:真正关闭文件之前调用，参数为fileID和文件是否将被删除
+     * 功能:缓存管理器在构造时设置，用于在文件关闭之前写回或者丢弃文件的缓存页面
+     */
+    void setCloseHandler(const std::function<void(int, bool)> &handler) {
+        closeHandler = handler;
+    }
+
     /*
      * @函数名createFile
      * @参数name:文件名
-     * 功能:新建name指定的文件名
+     * @参数pageSize:文件的页面字节数，4KB到64KB之间的2的幂
+     * 功能:新建name指定的文件名，第0页中记录页面大小
      * 返回:操作成功，返回true
      */
-    bool createFile(const char *name) {
-        _createFile(name);
-        return true;
+    bool createFile(const char *name, int pageSize = PAGE_SIZE) {
+        if (!validPageSize(pageSize)) {
+            cerr << "Invalid page size " << pageSize << "!" << endl;
+            return false;
+        }
+        return _createFile(name, pageSize) == 0;
+    }
+
+    /*
+     * @函数名validPageSize
+     * 返回:pageSize是否为4KB到64KB之间的2的幂
+     */
+    static bool validPageSize(int pageSize) {
+        return pageSize >= MIN_PAGE_SIZE && pageSize <= MAX_PAGE_SIZE && (pageSize & (pageSize - 1)) == 0;
     }
 
     /*
@@ -123,12 +597,44 @@ public:
      * 返回:如果成功打开，在fileID中存储为该文件分配的id，返回true，否则返回false
      */
     bool openFile(const char *name, int &fileID) {
+        std::lock_guard<std::mutex> lock(fileLatch);
+        auto it = nameToID.find(name);
+        if (it != nameToID.end()) {
+            fileID = it->second;
+            if (refCount[fileID]++ == 0) {
+                idleList->del(fileID);
+                idleNum--;
+            }
+            return true;
+        }
+        if (openNum == MAX_FILE_NUM) {
+            if (idleNum == 0) {
+                cerr << "Too many open files!" << endl;
+                return false;
+            }
+            _closeFile(idleList->getFirst(0), false);
+        }
         fileID = fm->findLeftOne();
+        if (_openFile(name, fileID) == -1) {
+            return false;
+        }
         fm->setBit(fileID, 0);
-        _openFile(name, fileID);
+        fileName[fileID] = name;
+        nameToID[name] = fileID;
+        refCount[fileID] = 1;
+        openNum++;
         return true;
     }
 
+    /*
+     * @函数名getFileName
+     * @参数fileID:文件id
+     * 返回:打开fileID指定文件时使用的文件名，文件没有打开时返回空串
+     */
+    const string &getFileName(int fileID) {
+        return fileName[fileID];
+    }
+
     int newType() {
         int t = tm->findLeftOne();
         tm->setBit(t, 0);
@@ -142,6 +648,7 @@ public:
     void shutdown() {
         delete tm;
         delete fm;
+        delete idleList;
     }
 
     ~FileManager() {
@@ -0,0 +1,205 @@
+#ifndef URING_QUEUE
+#define URING_QUEUE
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+/*
+ * UringQueue
+ * 直接用系统调用实现的io_uring提交队列和完成队列，只支持readv和writev
+ * 一次提交一批读写请求，内核并发执行，调用者再逐个取出完成结果
+ * 内核不支持io_uring或者被禁止时init返回false，由调用者退回同步读写
+ */
+class UringQueue {
+private:
+    int ringFd;
+    unsigned entries;
+    unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+    unsigned *cqHead, *cqTail, *cqMask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sqRing, *cqRing;
+    size_t sqRingSize, cqRingSize, sqesSize;
+    /*
+     * 已经放入提交队列但还没有提交给内核的请求个数
+     */
+    unsigned pending;
+    /*
+     * 已经提交给内核但还没有取出完成结果的请求个数
+     */
+    unsigned inFlight;
+
+    static unsigned *at(void *base, unsigned off) {
+        return (unsigned *) ((char *) base + off);
+    }
+
+public:
+    /*
+     * @函数名init
+     * @参数n:队列长度
+     * 返回:成功建立io_uring返回true
+     */
+    bool init(unsigned n) {
+#ifdef __NR_io_uring_setup
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        ringFd = (int) syscall(__NR_io_uring_setup, n, &p);
+        if (ringFd < 0) {
+            return false;
+        }
+        entries = p.sq_entries;
+        sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        sqRing = mmap(nullptr, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+        cqRing = mmap(nullptr, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+        sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+        sqes = (struct io_uring_sqe *) mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQES);
+        if (sqRing == MAP_FAILED || cqRing == MAP_FAILED || sqes == MAP_FAILED) {
+            shutdown();
+            return false;
+        }
+        sqHead = at(sqRing, p.sq_off.head);
+        sqTail = at(sqRing, p.sq_off.tail);
+        sqMask = at(sqRing, p.sq_off.ring_mask);
+        sqArray = at(sqRing, p.sq_off.array);
+        cqHead = at(cqRing, p.cq_off.head);
+        cqTail = at(cqRing, p.cq_off.tail);
+        cqMask = at(cqRing, p.cq_off.ring_mask);
+        cqes = (struct io_uring_cqe *) ((char *) cqRing + p.cq_off.cqes);
+        pending = 0;
+        inFlight = 0;
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /*
+     * @函数名capacity
+     * 返回:一次最多可以同时进行的请求个数
+     */
+    unsigned capacity() const {
+        return entries;
+    }
+
+    /*
+     * @函数名push
+     * @参数fd:文件描述符
+     * @参数iov:读写的内存区域，在请求完成之前必须保持有效
+     * @参数n:iov的个数
+     * @参数offset:文件中的偏移量
+     * @参数write:true表示写，false表示读
+     * @参数userData:请求完成时原样返回，用于区分请求
+     * 功能:把一个请求放入提交队列，调用submitAndWait之后才会交给内核
+     */
+    void push(int fd, const struct iovec *iov, unsigned n, off_t offset, bool write, unsigned long long userData) {
+        unsigned tail = *sqTail;
+        unsigned i = tail & *sqMask;
+        struct io_uring_sqe *sqe = &sqes[i];
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = write ? IORING_OP_WRITEV : IORING_OP_READV;
+        sqe->fd = fd;
+        sqe->addr = (unsigned long long) iov;
+        sqe->len = n;
+        sqe->off = offset;
+        sqe->user_data = userData;
+        sqArray[i] = i;
+        __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+        pending++;
+    }
+
+    /*
+     * @函数名submitAndWait
+     * @参数wait:至少等待完成的请求个数
+     * 功能:提交队列中所有未提交的请求，并等待至少wait个请求完成
+     * 返回:成功返回0，失败返回-1
+     */
+    int submitAndWait(unsigned wait) {
+        while (true) {
+            int r = (int) syscall(__NR_io_uring_enter, ringFd, pending, wait, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r >= 0) {
+                pending -= (unsigned) r;
+                inFlight += (unsigned) r;
+                if (pending == 0) {
+                    return 0;
+                }
+                continue;
+            }
+            if (errno != EINTR) {
+                return -1;
+            }
+        }
+    }
+
+    /*
+     * @函数名pop
+     * @参数userData:函数返回时，存储完成的请求的userData
+     * @参数res:函数返回时，存储请求的结果，与preadv/pwritev的返回值相同，失败时为-errno
+     * 返回:完成队列为空时返回false
+     */
+    bool pop(unsigned long long &userData, int &res) {
+        unsigned head = *cqHead;
+        if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        struct io_uring_cqe *cqe = &cqes[head & *cqMask];
+        userData = cqe->user_data;
+        res = cqe->res;
+        __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+        inFlight--;
+        return true;
+    }
+
+    /*
+     * @函数名drain
+     * 功能:submitAndWait失败后调用，等待已经提交给内核的请求全部完成并丢弃它们的结果
+     *           这些请求仍在读写调用者的内存，全部完成之后调用者才能重做或者释放这些内存
+     * 返回:成功返回0，io_uring_enter失败返回-1
+     */
+    int drain() {
+        unsigned long long userData;
+        int res;
+        while (true) {
+            while (pop(userData, res)) {
+            }
+            if (inFlight == 0) {
+                return 0;
+            }
+            int r = (int) syscall(__NR_io_uring_enter, ringFd, 0, inFlight, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0 && errno != EINTR) {
+                return -1;
+            }
+        }
+    }
+
+    void shutdown() {
+        if (ringFd < 0) {
+            return;
+        }
+        if (sqes != MAP_FAILED && sqes != nullptr) munmap(sqes, sqesSize);
+        if (cqRing != MAP_FAILED && cqRing != nullptr) munmap(cqRing, cqRingSize);
+        if (sqRing != MAP_FAILED && sqRing != nullptr) munmap(sqRing, sqRingSize);
+        ::close(ringFd);
+        ringFd = -1;
+    }
+
+    UringQueue() {
+        ringFd = -1;
+        entries = 0;
+        sqRing = cqRing = nullptr;
+        sqes = nullptr;
+        pending = 0;
+        inFlight = 0;
+    }
+
+    ~UringQueue() {
+        shutdown();
+    }
+};
+
+#endif
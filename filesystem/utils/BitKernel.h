@@ -0,0 +1,190 @@
+#ifndef BIT_KERNEL
+#define BIT_KERNEL
+
+#include "pagedef.h"
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BIT_KERNEL_X86
+#endif
+
+/*
+ * BitKernel
+ * 页面位图的查找和计数，位图按32位字存储，第i位在第i>>5个字的第(i&31)位
+ * 每次处理64位，用ctz找到第一个满足条件的位，用popcount计数
+ * CPU支持AVX2时先一次检查256位，跳过全0或全1的区域，否则逐个64位处理
+ * 位图最后一个字中第n位之后的位可能是页面中的其它数据，查找和计数时都被忽略
+ * 扫描稠密页面时每条记录查找一次下一位，起始位本身满足条件时直接返回，不必拼出64位
+ */
+class BitKernel {
+private:
+    /*
+     * 从第i位开始的64位中，属于前n位的那些位
+     */
+    static uint64_t mask(int i, int n) {
+        return n - i >= 64 ? ~0ULL : (1ULL << (n - i)) - 1;
+    }
+
+    /*
+     * @参数i:起始位，必须是32的倍数
+     * 返回:从第i位开始的64位，第n位及之后的位为0
+     */
+    static uint64_t chunk(const uint *words, int i, int n) {
+        uint64_t x = words[i >> 5];
+        if (i + 32 < n) {
+            x |= (uint64_t) words[(i >> 5) + 1] << 32;
+        }
+        return x & mask(i, n);
+    }
+
+#ifdef BIT_KERNEL_X86
+    static bool &hasAvx2() {
+        static bool has = __builtin_cpu_supports("avx2");
+        return has;
+    }
+
+    static bool &hasPopcnt() {
+        static bool has = __builtin_cpu_supports("popcnt");
+        return has;
+    }
+
+    /*
+     * @函数名skipAvx2
+     * @参数from:起始位，必须是32的倍数
+     * @参数ones:true表示跳过全1的256位，false表示跳过全0的256位
+     * 返回:第一个不能跳过的256位的起始位，剩余不足256位时返回剩余部分的起始位
+     */
+    __attribute__((target("avx2")))
+    static int skipAvx2(const uint *words, int from, int n, bool ones) {
+        const __m256i all = _mm256_set1_epi32(-1);
+        int i = from;
+        for (; i + 256 <= n; i += 256) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) (words + (i >> 5)));
+            if (ones ? !_mm256_testc_si256(v, all) : !_mm256_testz_si256(v, v)) {
+                break;
+            }
+        }
+        return i;
+    }
+
+    __attribute__((target("popcnt")))
+    static int popcountHw(const uint *words, int n) {
+        int count = 0;
+        for (int i = 0; i < n; i += 64) {
+            count += __builtin_popcountll(chunk(words, i, n));
+        }
+        return count;
+    }
+#endif
+
+    static int skip(const uint *words, int from, int n, bool ones) {
+#ifdef BIT_KERNEL_X86
+        if (hasAvx2()) {
+            return skipAvx2(words, from, n, ones);
+        }
+#endif
+        return from;
+    }
+
+public:
+    /*
+     * @函数名limitPaths
+     * @参数avx2:false表示不使用AVX2
+     * @参数popcnt:false表示不使用popcnt指令
+     * 功能:关闭部分指令集的实现，CPU不支持的指令不会因此打开，用于对比和检查各个实现，需要在使用位图之前调用
+     */
+    static void limitPaths(bool avx2, bool popcnt) {
+#ifdef BIT_KERNEL_X86
+        hasAvx2() = avx2 && __builtin_cpu_supports("avx2");
+        hasPopcnt() = popcnt && __builtin_cpu_supports("popcnt");
+#endif
+    }
+
+    /*
+     * @函数名findFirstZero
+     * @参数words:位图
+     * @参数n:位图的位数
+     * 返回:第一个为0的位，前n位全为1时返回-1
+     */
+    static int findFirstZero(const uint *words, int n) {
+        return findNextZero(words, 0, n);
+    }
+
+    /*
+     * @函数名findNextZero
+     * @参数words:位图
+     * @参数from:开始查找的位
+     * @参数n:位图的位数
+     * 返回:from及之后第一个为0的位，没有时返回-1
+     */
+    static int findNextZero(const uint *words, int from, int n) {
+        if (from >= n) {
+            return -1;
+        }
+        if (!((words[from >> 5] >> (from & 31)) & 1)) {
+            return from;
+        }
+        int i = from & ~31;
+        uint64_t x = ~chunk(words, i, n) & mask(i, n) & ~((1ULL << (from - i)) - 1);
+        if (x != 0) {
+            return i + __builtin_ctzll(x);
+        }
+        for (i = skip(words, i + 64, n, true); i < n; i += 64) {
+            x = ~chunk(words, i, n) & mask(i, n);
+            if (x != 0) {
+                return i + __builtin_ctzll(x);
+            }
+        }
+        return -1;
+    }
+
+    /*
+     * @函数名findNextSet
+     * @参数words:位图
+     * @参数from:开始查找的位
+     * @参数n:位图的位数
+     * 返回:from及之后第一个为1的位，没有时返回n
+     */
+    static int findNextSet(const uint *words, int from, int n) {
+        if (from >= n) {
+            return n;
+        }
+        if ((words[from >> 5] >> (from & 31)) & 1) {
+            return from;
+        }
+        int i = from & ~31;
+        uint64_t x = chunk(words, i, n) & ~((1ULL << (from - i)) - 1);
+        if (x != 0) {
+            return i + __builtin_ctzll(x);
+        }
+        for (i = skip(words, i + 64, n, false); i < n; i += 64) {
+            x = chunk(words, i, n);
+            if (x != 0) {
+                return i + __builtin_ctzll(x);
+            }
+        }
+        return n;
+    }
+
+    /*
+     * @函数名popcount
+     * @参数words:位图
+     * @参数n:位图的位数
+     * 返回:前n位中为1的位数
+     */
+    static int popcount(const uint *words, int n) {
+#ifdef BIT_KERNEL_X86
+        if (hasPopcnt()) {
+            return popcountHw(words, n);
+        }
+#endif
+        int count = 0;
+        for (int i = 0; i < n; i += 64) {
+            count += __builtin_popcountll(chunk(words, i, n));
+        }
+        return count;
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef PAGE_TABLE
+#define PAGE_TABLE
+
+#include "pagedef.h"
+
+/*
+ * 缓存页表，记录(文件号,页号)到缓存页面数组下标的映射
+ * 采用开放寻址(线性探测)，两个键合并为一个64位键后用混合函数求hash，
+ * 每个槽16字节，一个cache line容纳4个槽，查找通常只访问一个cache line
+ * 删除时将后续槽前移，不使用墓碑，探测链长度不会随着替换而增长
+ */
+class PageTable {
+private:
+    struct Slot {
+        ull key;//(k1 << 32) | k2
+        int value;//缓存页面数组下标，-1表示空槽
+        int pad;
+    };
+
+    Slot *slots;
+    /*
+     * 每个value对应的两个键，用于getKeys和remove
+     */
+    ull *keys;
+    int CAP_;
+    ull mask;
+
+    static ull makeKey(int k1, int k2) {
+        return ((ull) (uint) k1 << 32) | (uint) k2;
+    }
+
+    /*
+     * hash函数，splitmix64的混合步骤，键的每一位都会影响结果的每一位
+     */
+    static ull hash(ull k) {
+        k ^= k >> 30;
+        k *= 0xbf58476d1ce4e5b9ULL;
+        k ^= k >> 27;
+        k *= 0x94d049bb133111ebULL;
+        k ^= k >> 31;
+        return k;
+    }
+
+    void erase(ull key) {
+        ull i = hash(key) & mask;
+        while (slots[i].value != -1 && slots[i].key != key) {
+            i = (i + 1) & mask;
+        }
+        if (slots[i].value == -1) {
+            return;
+        }
+        //后移删除：把探测链上可以前移的槽移到空出的位置
+        ull j = i;
+        while (true) {
+            j = (j + 1) & mask;
+            if (slots[j].value == -1) {
+                break;
+            }
+            ull h = hash(slots[j].key) & mask;
+            //h不在(i, j]之间时，slots[j]可以移到i
+            if ((j > i && (h <= i || h > j)) || (j < i && (h <= i && h > j))) {
+                slots[i] = slots[j];
+                i = j;
+            }
+        }
+        slots[i].value = -1;
+    }
+
+public:
+    /*
+     * @函数名hashKey
+     * 返回:(k1,k2)的64位hash值，缓存管理器用它的高位选择分区
+     */
+    static ull hashKey(int k1, int k2) {
+        return hash(makeKey(k1, k2));
+    }
+
+    /*
+     * @函数名findIndex
+     * @参数k1:第一个键
+     * @参数k2:第二个键
+     * 返回:根据k1和k2，找到页表中对应的value，如果没有找到，则返回-1
+     */
+    int findIndex(int k1, int k2) {
+        ull key = makeKey(k1, k2);
+        ull i = hash(key) & mask;
+        while (slots[i].value != -1) {
+            if (slots[i].key == key) {
+                return slots[i].value;
+            }
+            i = (i + 1) & mask;
+        }
+        return -1;
+    }
+
+    /*
+     * @函数名replace
+     * @参数index:指定的value
+     * @参数k1:指定的第一个key
+     * @参数k2:指定的第二个key
+     * 功能:在页表中，将指定value对应的两个key设置为k1和k2
+     */
+    void replace(int index, int k1, int k2) {
+        remove(index);
+        ull key = makeKey(k1, k2);
+        ull i = hash(key) & mask;
+        while (slots[i].value != -1) {
+            i = (i + 1) & mask;
+        }
+        slots[i].key = key;
+        slots[i].value = index;
+        keys[index] = key;
+    }
+
+    /*
+     * @函数名remove
+     * @参数index:指定的value
+     * 功能:在页表中，将指定的value删掉
+     */
+    void remove(int index) {
+        if (keys[index] == (ull) -1) {
+            return;
+        }
+        erase(keys[index]);
+        keys[index] = (ull) -1;
+    }
+
+    /*
+     * @函数名getKeys
+     * @参数index:指定的value
+     * @参数k1:存储指定value对应的第一个key
+     * @参数k2:存储指定value对应的第二个key
+     */
+    void getKeys(int index, int &k1, int &k2) {
+        k1 = (int) (keys[index] >> 32);
+        k2 = (int) (keys[index] & 0xffffffffULL);
+    }
+
+    /*
+     * 构造函数
+     * @参数c:页表的容量上限，槽数取不小于2c的2的幂，装载因子不超过1/2
+     */
+    PageTable(int c) {
+        CAP_ = c;
+        ull n = 1;
+        while (n < (ull) c * 2) {
+            n <<= 1;
+        }
+        mask = n - 1;
+        slots = new Slot[n];
+        for (ull i = 0; i < n; ++i) {
+            slots[i].key = 0;
+            slots[i].value = -1;
+            slots[i].pad = 0;
+        }
+        keys = new ull[c];
+        for (int i = 0; i < CAP_; ++i) {
+            keys[i] = (ull) -1;
+        }
+    }
+
+    ~PageTable() {
+        delete[] slots;
+        delete[] keys;
+    }
+};
+
+#endif
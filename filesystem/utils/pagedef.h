@@ -19,18 +19,29 @@
  * 页面字节数以2为底的指数
  */
 #define PAGE_SIZE_IDX 13
+/*
+ * 创建文件时可以选择的页面大小，4KB到64KB之间的2的幂，PAGE_SIZE为默认值
+ */
+#define MIN_PAGE_SIZE_IDX 12
+#define MAX_PAGE_SIZE_IDX 16
+#define MIN_PAGE_SIZE 4096
+#define MAX_PAGE_SIZE 65536
+/*
+ * 页面大小的种类数，缓存按页面大小分为同样多的大小类
+ */
+#define PAGE_CLASS_NUM 5
+/*
+ * 文件第0页中记录页面大小的位置，在最小的页面之内，表和索引的信息头不会用到
+ */
+#define PAGE_SIZE_OFFSET 4092
 #define MAX_FMT_INT_NUM 128
 //#define BUF_PAGE_NUM 65536
 #define MAX_FILE_NUM 128
 #define MAX_TYPE_NUM 256
 /*
- * 缓存中页面个数上限
+ * 缓存中页面个数的默认值，可以通过启动参数修改
  */
 #define CAP 60000
-/*
- * hash算法的模
- */
-#define MOD 60000
 #define IN_DEBUG 0
 #define DEBUG_DELETE 0
 #define DEBUG_ERASE 1
@@ -31,17 +31,16 @@ bool IndexHandle::isSmaller(const char *data1, const char *data2, const RID &rid
         offset += _attrLens[i];
     }
     if (rid1.getPageNum() < rid2.getPageNum()) return true;
-    if (rid2.getPageNum() > rid2.getPageNum()) return false;
+    if (rid1.getPageNum() > rid2.getPageNum()) return false;
     return rid1.getSlotNum() < rid2.getSlotNum();
 }
 
 Node *IndexHandle::getNodeById(int id, bool isNew) const {
     Node *node = new Node();
-    node->_start = _bufPageManager->getPage(_fileID, id, node->_index);
-    _bufPageManager->access(node->_index);
+    node->_start = _bufPageManager->pinPage(_fileID, id, node->_index);
     memcpy(&node->_isLeaf, node->_start, 6 * sizeof(int));
     if (isNew) {
-        memset(node->_start, 0, PAGE_SIZE);
+        memset(node->_start, 0, _pageSize);
         node->_prev = node->_next = 0;
     }
     node->_key = (char *) node->_start + _header._keyStart;
@@ -53,7 +52,11 @@ Node *IndexHandle::getNodeById(int id, bool isNew) const {
 void IndexHandle::refreshNode(Node *node) const {
     memcpy(node->_start, &node->_isLeaf, 6 * sizeof(int));
     _bufPageManager->markDirty(node->_index);
-    _bufPageManager->writeBack(node->_index);
+}
+
+void IndexHandle::releaseNode(Node *node) const {
+    _bufPageManager->unpin(node->_index);
+    delete node;
 }
 
 void IndexHandle::refreshHeader() const {
@@ -61,7 +64,6 @@ void IndexHandle::refreshHeader() const {
     BufType b = _bufPageManager->getPage(_fileID, 0, index);
     memcpy(b, &_header, sizeof(IndexHeader));
     _bufPageManager->markDirty(index);
-    _bufPageManager->writeBack(index);
 }
 
 void IndexHandle::refreshTree(Node *&node, int id) const {
@@ -73,7 +75,7 @@ void IndexHandle::refreshTree(Node *&node, int id) const {
         parentNode->_rid[i] = node->_rid[0];
         refreshNode(parentNode);
         id = node->_parent;
-        delete node;
+        releaseNode(node);
         node = parentNode;
     }
 }
@@ -81,6 +83,7 @@ void IndexHandle::refreshTree(Node *&node, int id) const {
 IndexHandle::IndexHandle(BufPageManager *bufPageManager, int fileID) {
     _bufPageManager = bufPageManager;
     _fileID = fileID;
+    _pageSize = _bufPageManager->fileManager->getPageSize(fileID);
     int index;
     BufType b = _bufPageManager->getPage(_fileID, 0, index);
     _bufPageManager->access(index);
@@ -103,6 +106,7 @@ bool IndexHandle::insertEntry(BufType data, const RID &rid, bool isUnique, bool
                 //key < data，或data最小
                 if (i == 0 || isSmaller(node->_key + i * _header._attrLen, (char *)data, node->_rid[i], r)) {
                     id = node->_child[i];
+                    releaseNode(node);
                     node = getNodeById(id);
                     break;
                 }
@@ -119,20 +123,20 @@ bool IndexHandle::insertEntry(BufType data, const RID &rid, bool isUnique, bool
         //重复主键可能在当前节点或其后继
         if (pos < node->_keyNum) {
             if (memcmp(data, node->_key + pos * _header._attrLen, _header._attrLen) == 0) {
-                delete node;
+                releaseNode(node);
                 return false;
             }
         } else if (node->_next != 0) {
             pos = 0;
             Node *n = getNodeById(node->_next);
             if (memcmp(data, n->_key + pos * _header._attrLen, _header._attrLen) == 0) {
-                delete node;
-                delete n;
+                releaseNode(node);
+                releaseNode(n);
                 return false;
             }
-            delete n;
+            releaseNode(n);
         }
-        delete node;
+        releaseNode(node);
         if (check) return true;
     }
     Node *node = getNodeById(id);
@@ -142,6 +146,7 @@ bool IndexHandle::insertEntry(BufType data, const RID &rid, bool isUnique, bool
             //key < data，或data最小
             if (i == 0 || isSmaller(node->_key + i * _header._attrLen, (char *)data, node->_rid[i], rid)) {
                 id = node->_child[i];
+                releaseNode(node);
                 node = getNodeById(id);
                 break;
             }
@@ -239,7 +244,7 @@ bool IndexHandle::insertEntry(BufType data, const RID &rid, bool isUnique, bool
                     Node *childNode = getNodeById(newNode->_child[j]);
                     childNode->_parent = newID;
                     refreshNode(childNode);
-                    delete childNode;
+                    releaseNode(childNode);
                 }
                 newNode->_rid[j] = node->_rid[node->_keyNum + j];
             }
@@ -252,7 +257,7 @@ bool IndexHandle::insertEntry(BufType data, const RID &rid, bool isUnique, bool
                     Node *brotherNode = getNodeById(node->_next);
                     brotherNode->_prev = newID;
                     refreshNode(brotherNode);
-                    delete brotherNode;
+                    releaseNode(brotherNode);
                 }
                 node->_next = newID;
             }
@@ -263,8 +268,8 @@ bool IndexHandle::insertEntry(BufType data, const RID &rid, bool isUnique, bool
             parentNode->_rid[i + 1] = newNode->_rid[0];
             refreshNode(node);
             refreshNode(newNode);
-            delete node;
-            delete newNode;
+            releaseNode(node);
+            releaseNode(newNode);
             //递归处理可能新发生的上溢
             id = parent;
             node = parentNode;
@@ -274,7 +279,7 @@ bool IndexHandle::insertEntry(BufType data, const RID &rid, bool isUnique, bool
     //如果发生了上溢，需要修改信息头
     if (overflow) refreshHeader();
     refreshTree(node, id);
-    delete node;
+    releaseNode(node);
     return true;
 }
 
@@ -287,6 +292,7 @@ bool IndexHandle::deleteEntry(BufType data, const RID &rid) {
             //key < data，或data最小
             if (i == 0 || !isSmaller((char *)data, node->_key + i * _header._attrLen, rid, node->_rid[i])) {
                 id = node->_child[i];
+                releaseNode(node);
                 node = getNodeById(id);
                 break;
             }
@@ -302,7 +308,7 @@ bool IndexHandle::deleteEntry(BufType data, const RID &rid) {
     }
     //没有找到要删除的索引，返回false
     if (pos == -1) {
-        delete node;
+        releaseNode(node);
         return false;
     }
     node->_keyNum--;
@@ -321,13 +327,13 @@ bool IndexHandle::deleteEntry(BufType data, const RID &rid) {
             Node *prev = getNodeById(node->_prev);
             prev->_next = node->_next;
             refreshNode(prev);
-            delete prev;
+            releaseNode(prev);
         }
         if (node->_next) {
             Node *next = getNodeById(node->_next);
             next->_prev = node->_prev;
             refreshNode(next);
-            delete next;
+            releaseNode(next);
         }
         //递归处理下溢情况
         while (node->_keyNum == 0) {
@@ -353,7 +359,7 @@ bool IndexHandle::deleteEntry(BufType data, const RID &rid) {
             node->_nextEmptyPage = _header._firstEmptyPage;
             _header._firstEmptyPage = id;
             refreshNode(node);
-            delete node;
+            releaseNode(node);
             node = parentNode;
             //递归处理可能新发生的下溢
             id = parent;
@@ -363,7 +369,7 @@ bool IndexHandle::deleteEntry(BufType data, const RID &rid) {
     //如果发生了下溢，需要修改信息头
     if (underflow) refreshHeader();
     refreshTree(node, id);
-    delete node;
+    releaseNode(node);
     return true;
 }
 
@@ -384,6 +390,7 @@ bool IndexHandle::openScan(BufType data, bool lower) {
             //key < data，或data最小
             if (i == 0 || isSmaller(node->_key + i * _header._attrLen, (char *)data, node->_rid[i], rid)) {
                 id = node->_child[i];
+                releaseNode(node);
                 node = getNodeById(id);
                 break;
             }
@@ -403,7 +410,7 @@ bool IndexHandle::openScan(BufType data, bool lower) {
         _id = node->_next;
         _pos = 0;
     }
-    delete node;
+    releaseNode(node);
     //没有后继说明没有符合要求的记录
     return _id != 0;
 }
@@ -417,7 +424,7 @@ bool IndexHandle::getPrevEntry(RID &rid) {
     _pos--;
     //已经访问完当前节点第一个值，访问前驱节点
     if (_pos == -1) _id = node->_prev;
-    delete node;
+    releaseNode(node);
     return true;
 }
 
@@ -432,6 +439,6 @@ bool IndexHandle::getNextEntry(RID &rid) {
         _id = node->_next;
         _pos = 0;
     }
-    delete node;
+    releaseNode(node);
     return true;
 }
\ No newline at end of file
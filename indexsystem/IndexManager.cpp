@@ -6,19 +6,19 @@ IndexManager::IndexManager(BufPageManager *bufPageManager, FileManager *fileMana
     _fileManager = fileManager;
 }
 
-bool IndexManager::createIndex(const char *fileName, const std::vector<std::string> &attrNames, int attrNum, const int *attrLens, const AttrType *attrTypes) {
+bool IndexManager::createIndex(const char *fileName, const std::vector<std::string> &attrNames, int attrNum, const int *attrLens, const AttrType *attrTypes, int pageSize) {
     std::string indexName = std::string(fileName, fileName + strlen(fileName));
     for (const auto &attrName: attrNames) {
         indexName += "." + attrName;
     }
-    if (!_fileManager->createFile(indexName.c_str())) return false;
+    if (!_fileManager->createFile(indexName.c_str(), pageSize)) return false;
     int fileID;
     if (!_fileManager->openFile(indexName.c_str(), fileID)) return false;
     int attrLen = 0;
     for (int i = 0; i < attrNum; i++) {
         attrLen += attrLens[i];
     }
-    int maxChildNum = (int)((PAGE_SIZE - 6 * sizeof(int)) / (attrLen + sizeof(int) + sizeof(RID)));
+    int maxChildNum = (int)((pageSize - 6 * sizeof(int)) / (attrLen + sizeof(int) + sizeof(RID)));
     int keyStart = 6 * sizeof(int);
     int childStart = keyStart + maxChildNum * attrLen;
     int ridStart = (int)(childStart + maxChildNum * sizeof(int));
@@ -34,8 +34,8 @@ bool IndexManager::createIndex(const char *fileName, const std::vector<std::stri
         ._ridStart = ridStart
     };
     int index;
+    //第0页在创建文件时已经清零，并记录了页面大小
     BufType b = _bufPageManager->getPage(fileID, 0, index);
-    memset(b, 0, PAGE_SIZE);
     memcpy(b, &header, sizeof(IndexHeader));
     memcpy((char *) b + sizeof(IndexHeader), attrTypes, attrNum * sizeof(AttrType));
     memcpy((char *) b + sizeof(IndexHeader) + attrNum * sizeof(AttrType), attrLens, attrNum * sizeof(int));
@@ -43,21 +43,20 @@ bool IndexManager::createIndex(const char *fileName, const std::vector<std::stri
     _bufPageManager->writeBack(index);
     int node[6] = {1, 0, 0, 0, 0, 0};
     b = _bufPageManager->getPage(fileID, 1, index);
-    memset(b, 0, PAGE_SIZE);
+    memset(b, 0, pageSize);
     memcpy(b, node, 6 * sizeof(int));
     _bufPageManager->markDirty(index);
     _bufPageManager->writeBack(index);
-    return (!_fileManager->closeFile(fileID));
+    return closeIndex(fileID);
 }
 
 bool IndexManager::destroyIndex(const char *fileName, const std::vector<std::string> &attrNames) {
-    //将缓存全部写回，删除文件
-    _bufPageManager->close();
+    //索引文件仍在打开文件的缓存中时，先关闭并丢弃其缓存页面，再删除文件
     std::string indexName = std::string(fileName, fileName + strlen(fileName));
     for (const auto &attrName: attrNames) {
         indexName += "." + attrName;
     }
-    return (!remove(indexName.c_str()));
+    return _fileManager->removeFile(indexName.c_str());
 }
 
 bool IndexManager::openIndex(const char *fileName, const std::vector<std::string> &attrNames, int &fileID) {
@@ -69,7 +68,6 @@ bool IndexManager::openIndex(const char *fileName, const std::vector<std::string
 }
 
 bool IndexManager::closeIndex(int fileID) {
-    //将缓存全部写回，关闭文件
-    _bufPageManager->close();
+    //索引文件放入打开文件的缓存，再次打开时B+树的页面仍在缓存中
     return (!_fileManager->closeFile(fileID));
 }
\ No newline at end of file
@@ -34,6 +34,7 @@ class IndexHandle {
 private:
     BufPageManager *_bufPageManager;//缓存页面管理
     int _fileID;//管理的文件标识符
+    int _pageSize;//文件的页面大小，单位：字节
     struct IndexHeader _header;//第一个页面记录信息头
     std::vector<AttrType> _attrTypes;//每个索引字段的类型
     std::vector<int> _attrLens;//每个索引字段的长度
@@ -42,6 +43,7 @@ private:
     bool isSmaller(const char *data1, const char *data2, const RID &rid1, const RID &rid2);//比较索引大小
     Node *getNodeById(int id, bool isNew = false) const;//根据id获得对应节点
     void refreshNode(Node *node) const;//标记节点被修改
+    void releaseNode(Node *node) const;//解除节点页面的固定，释放节点
     void refreshHeader() const;//标记信息头被修改
     void refreshTree(Node *&node, int id) const;//更新祖先节点
 public:
@@ -61,8 +63,8 @@ private:
 public:
     IndexManager(BufPageManager *bufPageManager, FileManager *fileManager);
     ~IndexManager() {};
-    //根据文件名和索引名称创建索引文件，attrLen为索引字段总大小，单位：字节
-    bool createIndex(const char *fileName, const std::vector<std::string> &attrNames, int attrNum, const int *attrLens, const AttrType *attrTypes);
+    //根据文件名和索引名称创建索引文件，attrLen为索引字段总大小，pageSize为页面大小，单位：字节
+    bool createIndex(const char *fileName, const std::vector<std::string> &attrNames, int attrNum, const int *attrLens, const AttrType *attrTypes, int pageSize = PAGE_SIZE);
     bool destroyIndex(const char *fileName, const std::vector<std::string> &attrNames);//根据文件名和索引名称删除相应索引文件
     bool openIndex(const char *fileName, const std::vector<std::string> &attrNames, int &fileID);//打开索引文件，fileID返回文件标识符
     bool closeIndex(int fileID);//根据指定的标识符关闭相应的索引文件
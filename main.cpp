@@ -2,6 +2,7 @@
 #include "parser/SQLParser.h"
 #include "parser/SQLBaseVisitor.h"
 #include <iomanip>
+#include <regex>
 
 using namespace antlr4;
 
@@ -15,14 +16,102 @@ auto parse(const std::string& sql, SQLBaseVisitor &visitor) {
     return result;
 }
 
-int main() {
+/*
+ * 语法文件之外的语句，在交给parser之前识别
+ * CREATE TABLE ... [STORED AS PAX|COLUMN] [PAGE_SIZE n] [INDEX_PAGE_SIZE n];去掉末尾的选项后交给parser，
+ *     选项只对这一个表和建表时创建的主键、外键索引生效
+ * VACUUM tableName [LIMIT n];整理表文件，带LIMIT时至多移动n条记录，下一次从停止的位置继续
+ * 返回:sql是这样的语句时执行并返回true
+ */
+bool parseExtra(const std::string& sql, SystemManager &systemManager, QueryManager &queryManager, SQLBaseVisitor &visitor) {
+    static const std::regex showBuffer(R"(\s*SHOW\s+BUFFER\s+STATUS\s*;)");
+    static const std::regex resetBuffer(R"(\s*RESET\s+BUFFER\s+STATUS\s*;)");
+    static const std::regex tableOptions(R"((\s*CREATE\s+TABLE\s[\s\S]*\))((\s*(STORED\s+AS\s+(PAX|COLUMN)|PAGE_SIZE\s+\d{1,9}|INDEX_PAGE_SIZE\s+\d{1,9}))+)\s*;)");
+    static const std::regex tableOption(R"((STORED\s+AS|INDEX_PAGE_SIZE|PAGE_SIZE)\s+(\w+))");
+    static const std::regex vacuum(R"(\s*VACUUM\s+(\w+)(\s+LIMIT\s+([1-9]\d{0,8}))?\s*;)");
+    std::smatch match;
+    if (std::regex_match(sql, match, tableOptions)) {
+        TableStorage storage = ROW_STORAGE;
+        int defaultTablePageSize = systemManager.getTablePageSize(), defaultIndexPageSize = systemManager.getIndexPageSize();
+        int tablePageSize = defaultTablePageSize, indexPageSize = defaultIndexPageSize;
+        std::string options = match[2];
+        for (std::sregex_iterator it(options.begin(), options.end(), tableOption), end; it != end; ++it) {
+            if ((*it)[1] == "PAGE_SIZE") tablePageSize = std::stoi((*it)[2]);
+            else if ((*it)[1] == "INDEX_PAGE_SIZE") indexPageSize = std::stoi((*it)[2]);
+            else storage = (*it)[2] == "PAX" ? PAX_STORAGE : COLUMN_STORAGE;
+        }
+        //页面大小不合法时不建表
+        if (!systemManager.setPageSize(tablePageSize, indexPageSize)) return true;
+        systemManager.setTableStorage(storage);
+        parse(match[1].str() + ";", visitor);
+        systemManager.setTableStorage(ROW_STORAGE);
+        systemManager.setPageSize(defaultTablePageSize, defaultIndexPageSize);
+        return true;
+    }
+    if (std::regex_match(sql, match, vacuum)) {
+        queryManager.vacuumTable(match[1], match[3].matched ? std::stoi(match[3]) : 0);
+        return true;
+    }
+    if (std::regex_match(sql, showBuffer)) {
+        systemManager.showBufferStatus();
+        return true;
+    }
+    if (std::regex_match(sql, resetBuffer)) {
+        systemManager.resetBufferStatus();
+        return true;
+    }
+    return false;
+}
+
+int main(int argc, char *argv[]) {
+    //启动参数
+    BufPageOption option;
+    IOBackend backend = SYNC_IO;
+    bool directIO = false;
+    int tablePageSize = PAGE_SIZE, indexPageSize = PAGE_SIZE;
+    bool slottedRecords = true;
+    int scanThreads = 1;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--replace=lru") option.policy = LRU_REPLACE;
+        else if (arg == "--replace=clock") option.policy = CLOCK_REPLACE;
+        else if (arg == "--replace=2q") option.policy = TWO_QUEUE_REPLACE;
+        else if (arg.rfind("--pool-size=", 0) == 0) option.capacity = atoi(arg.c_str() + 12);
+        else if (arg.rfind("--pool-partitions=", 0) == 0) option.partitions = atoi(arg.c_str() + 18);
+        else if (arg.rfind("--pool-memory=", 0) == 0) option.memoryLimit = atoll(arg.c_str() + 14) << 20;
+        else if (arg.rfind("--pool-class-memory=", 0) == 0) option.classMemory = atoll(arg.c_str() + 20) << 20;
+        else if (arg == "--huge-pages") option.hugePage = true;
+        else if (arg == "--flusher") option.backgroundFlush = true;
+        else if (arg.rfind("--dirty-high-water=", 0) == 0) option.dirtyHighWater = atoi(arg.c_str() + 19);
+        else if (arg.rfind("--read-ahead=", 0) == 0) option.readAhead = atoi(arg.c_str() + 13);
+        else if (arg == "--io=sync") backend = SYNC_IO;
+        else if (arg == "--io=uring") backend = URING_IO;
+        else if (arg == "--direct-io") directIO = true;
+        else if (arg == "--mmap-scan") option.mmapScan = true;
+        else if (arg.rfind("--table-page-size=", 0) == 0) tablePageSize = atoi(arg.c_str() + 18);
+        else if (arg.rfind("--index-page-size=", 0) == 0) indexPageSize = atoi(arg.c_str() + 18);
+        else if (arg == "--record-format=slotted") slottedRecords = true;
+        else if (arg == "--record-format=fixed") slottedRecords = false;
+        else if (arg.rfind("--scan-threads=", 0) == 0) scanThreads = atoi(arg.c_str() + 15);
+        else {
+            std::cerr << "Unknown option " + arg + "!" << std::endl;
+            return -1;
+        }
+    }
     MyBitMap::initConst();
     FileManager fileManager;
-    BufPageManager bufPageManager(&fileManager);
+    if (!fileManager.setBackend(backend)) {
+        std::cerr << "io_uring is not available, use synchronous I/O." << std::endl;
+    }
+    fileManager.setDirectIO(directIO);
+    BufPageManager bufPageManager(&fileManager, option);
     IndexManager indexManager(&bufPageManager, &fileManager);
     RecordManager recordManager(&bufPageManager, &fileManager);
     SystemManager systemManager(&bufPageManager, &indexManager, &recordManager);
+    if (!systemManager.setPageSize(tablePageSize, indexPageSize)) return -1;
+    systemManager.setSlottedRecords(slottedRecords);
     QueryManager queryManager(&bufPageManager, &indexManager, &recordManager, &systemManager);
+    queryManager.setScanThreads(scanThreads);
     SQLBaseVisitor visitor(&systemManager, &queryManager);
     std::cout << std::setiosflags(std::ios::fixed) << std::setprecision(2);
     while (true) {
@@ -46,7 +135,7 @@ int main() {
             if (!systemManager.getDBName().empty()) systemManager.closeDB();
             break;
         }
-        else parse(sql, visitor);
+        else if (!parseExtra(sql, systemManager, queryManager, visitor)) parse(sql, visitor);
     }
     return 0;
 }
@@ -50,11 +50,32 @@ const TableInfo &SystemManager::getTableInfoByID(int id) {
     return _tables[id];
 }
 
+bool SystemManager::setPageSize(int tablePageSize, int indexPageSize) {
+    if (!FileManager::validPageSize(tablePageSize) || !FileManager::validPageSize(indexPageSize)) {
+        cerr << "Page size must be a power of 2 between " << MIN_PAGE_SIZE << " and " << MAX_PAGE_SIZE << "!" << endl;
+        return false;
+    }
+    _tablePageSize = tablePageSize;
+    _indexPageSize = indexPageSize;
+    return true;
+}
+
+void SystemManager::setSlottedRecords(bool slotted) {
+    _slottedRecords = slotted;
+}
+
+void SystemManager::setTableStorage(TableStorage storage) {
+    _tableStorage = storage;
+}
+
 SystemManager::SystemManager(BufPageManager *bufPageManager, IndexManager *indexManager, RecordManager *recordManager) {
     _bufPageManager = bufPageManager;
     _indexManager = indexManager;
     _recordManager = recordManager;
     _tableNum = 0;
+    _tablePageSize = _indexPageSize = PAGE_SIZE;
+    _slottedRecords = true;
+    _tableStorage = ROW_STORAGE;
     system("ls > temp.log");
     ifstream fin("temp.log");
     string dbName;
@@ -232,11 +253,13 @@ bool SystemManager::openDB(const string &dbName) {
         _tableName2fileID[tableInfo._tableName] = fileID;//建立表名到文件描述符的映射
     }
     fin.close();
+    loadBufferPages();
     return true;
 }
 
 bool SystemManager::closeDB() {
     _dbName.clear();
+    saveBufferPages();
     ofstream fout("meta.db");//打开元信息文件
     if (fout.fail()) {
         cerr << "Open meta.db failed!" << endl;
@@ -322,11 +345,76 @@ bool SystemManager::closeDB() {
     }
     _tables.clear();//清除表
     _tableName2fileID.clear();//清除表名到文件描述符的映射
+    _bufPageManager->fileManager->closeIdleFiles();//关闭缓存的索引文件，写回其缓存页面
     fout.close();
     chdir("..");//切换目录
     return true;
 }
 
+void SystemManager::saveBufferPages() {
+    //文件格式：文件名数量，每行一个文件名，页面数量，每行一个页面的文件名序号和页号
+    vector<pair<int, int>> pages = _bufPageManager->getResidentPages();
+    vector<int> nameID(MAX_FILE_NUM, -1);
+    vector<string> names;
+    vector<pair<int, int>> saved;
+    for (const auto &page : pages) {
+        const string &name = _bufPageManager->fileManager->getFileName(page.first);
+        if (name.empty()) continue;
+        if (nameID[page.first] == -1) {
+            nameID[page.first] = (int) names.size();
+            names.push_back(name);
+        }
+        saved.emplace_back(nameID[page.first], page.second);
+    }
+    ofstream fout("buffer.db");
+    if (fout.fail()) {
+        cerr << "Open buffer.db failed!" << endl;
+        return;
+    }
+    fout << names.size() << endl;
+    for (const auto &name : names) {
+        fout << name << endl;
+    }
+    fout << saved.size() << endl;
+    for (const auto &page : saved) {
+        fout << page.first << " " << page.second << endl;
+    }
+    fout.close();
+}
+
+void SystemManager::loadBufferPages() {
+    ifstream fin("buffer.db");
+    if (fin.fail()) return;//数据库从未关闭过，没有保存的页面
+    int nameNum, pageNum;
+    fin >> nameNum;
+    //表文件已经打开，索引文件打开后放入打开文件的缓存，预热的页面在之后打开索引时仍然有效
+    FileManager *fileManager = _bufPageManager->fileManager;
+    vector<int> fileIDs, opened;
+    for (int i = 0; i < nameNum; i++) {
+        string name;
+        fin >> name;
+        auto it = _tableName2fileID.find(name);
+        int fileID = -1;
+        if (it != _tableName2fileID.end()) fileID = it->second;
+        else if (fileManager->openFile(name.c_str(), fileID)) opened.push_back(fileID);
+        else fileID = -1;
+        fileIDs.push_back(fileID);
+    }
+    fin >> pageNum;
+    vector<pair<int, int>> pages;
+    int id, pageID;
+    for (int i = 0; i < pageNum && fin >> id >> pageID; i++) {
+        if (id >= 0 && id < nameNum && fileIDs[id] != -1) {
+            pages.emplace_back(fileIDs[id], pageID);
+        }
+    }
+    fin.close();
+    _bufPageManager->prefetch(pages);
+    for (int fileID : opened) {
+        fileManager->closeFile(fileID);
+    }
+}
+
 bool SystemManager::createTable(const TableInfo &tableInfo) {
     //检查表是否存在
     for (int i = 0; i < _tableNum; i++) {
@@ -355,8 +443,29 @@ bool SystemManager::createTable(const TableInfo &tableInfo) {
             }
         }
     }
-    //创建表文件
-    _recordManager->createFile(tableInfo._tableName.c_str(), tableInfo._recordSize);
+    //创建表文件，PAX表和列存储表的NULL位图和每列分别存放，其它含VARCHAR列的表使用变长页面
+    RecordFormat format = FIXED_RECORD;
+    vector<pair<int, int>> fields;
+    vector<AttrType> types;
+    if (_tableStorage == PAX_STORAGE || _tableStorage == COLUMN_STORAGE) {
+        format = _tableStorage == PAX_STORAGE ? PAX_RECORD : COLUMN_RECORD;
+        fields.emplace_back(0, tableInfo._attrs[0]._offset);
+        for (const auto &attr : tableInfo._attrs) {
+            fields.emplace_back(attr._offset, attr._attrLength);
+            types.push_back(attr._attrType);
+        }
+    } else if (_slottedRecords) {
+        format = SLOTTED_RECORD;
+        for (const auto &attr : tableInfo._attrs) {
+            if (attr._attrType == STRING) fields.emplace_back(attr._offset, attr._attrLength);
+        }
+    }
+    if (!_recordManager->createFile(tableInfo._tableName.c_str(), tableInfo._recordSize, _tablePageSize, format, fields, types)) {
+        if (format == PAX_RECORD || format == COLUMN_RECORD) {
+            cerr << "Table " + tableInfo._tableName + " can not be stored as " << (format == PAX_RECORD ? "PAX" : "COLUMN") << ", too many columns or rows too long!" << endl;
+        } else cerr << "Create file " + tableInfo._tableName + " failed!" << endl;
+        return false;
+    }
     int fileID;
     if (!_recordManager->openFile(tableInfo._tableName.c_str(), fileID)) {
         cerr << "Open file " + tableInfo._tableName + " failed!" << endl;
@@ -382,6 +491,8 @@ bool SystemManager::dropTable(const string &tableName) {
             return false;
         }
     }
+    //表文件即将删除，丢弃缓存中的页面，不再写回
+    _bufPageManager->invalidateFile(_tableName2fileID[tableName]);
     //关闭表文件
     if (!_recordManager->closeFile(_tableName2fileID[tableName])) {
         cerr << "Close file " + tableName + " failed!" << endl;
@@ -443,30 +554,32 @@ bool SystemManager::createIndex(const string &tableName, const vector<string> &a
         attrLen += attrInfo._attrLength;
     }
     //创建索引文件
-    _indexManager->createIndex(tableName.c_str(), attrNames, attrNum, attrLens, attrTypes);
+    _indexManager->createIndex(tableName.c_str(), attrNames, attrNum, attrLens, attrTypes, _indexPageSize);
     int fileID;
     _indexManager->openIndex(tableName.c_str(), attrNames, fileID);
     IndexHandle indexHandle(_bufPageManager, fileID);
-    RecordHandle recordHandle(_bufPageManager, _tableName2fileID[tableName]);
+    auto recordHandle = _recordManager->openTable(_tableName2fileID[tableName]);
     //扫描每一条记录，插入一条索引
-    if (recordHandle.openScan()) {
-        RID rid;
-        auto data = new char[tableInfo._recordSize];//记录数据
+    if (recordHandle->openPageScan()) {
+        vector<RecordRef> records;
         auto index = new char[attrLen];//索引数据
-        while (recordHandle.getNextRecord(rid, (BufType)data)) {
-            int offset = 0;//索引数据偏移
-            for (auto &attrName : attrNames) {
-                int attr_id = getAttrIDByName(tableInfo, attrName);
-                AttrInfo &attrInfo = tableInfo._attrs[attr_id];
-                //从记录的对应位置拷贝到索引的对应位置
-                memcpy(index + offset, data + attrInfo._offset, attrInfo._attrLength);
-                offset += attrInfo._attrLength;
+        while (recordHandle->getNextRecords(records)) {
+            for (const auto &record : records) {
+                const RID &rid = record._rid;
+                const char *data = record._data;
+                int offset = 0;//索引数据偏移
+                for (auto &attrName : attrNames) {
+                    int attr_id = getAttrIDByName(tableInfo, attrName);
+                    AttrInfo &attrInfo = tableInfo._attrs[attr_id];
+                    //从记录的对应位置拷贝到索引的对应位置
+                    memcpy(index + offset, data + attrInfo._offset, attrInfo._attrLength);
+                    offset += attrInfo._attrLength;
+                }
+                indexHandle.insertEntry((BufType)index, rid, false, false);
+                memset(index, 0, attrLen);
             }
-            indexHandle.insertEntry((BufType)index, rid, false, false);
-            memset(data, 0, tableInfo._recordSize);
-            memset(index, 0, attrLen);
         }
-        delete[] data;
+        recordHandle->closePageScan();
         delete[] index;
     }
     //关闭索引文件
@@ -546,40 +659,41 @@ bool SystemManager::createPrimary(const string &tableName, const vector<string>
         primaryKeySize += attrInfo._attrLength;
     }
     //创建主键文件，同索引文件，但要求不能重复
-    _indexManager->createIndex(tableName.c_str(), vector<string>(1, "primary"), attrNum, attrLens, attrTypes);
+    _indexManager->createIndex(tableName.c_str(), vector<string>(1, "primary"), attrNum, attrLens, attrTypes, _indexPageSize);
     int fileID;
     _indexManager->openIndex(tableName.c_str(), vector<string>(1, "primary"), fileID);
     IndexHandle indexHandle(_bufPageManager, fileID);
-    RecordHandle recordHandle(_bufPageManager, _tableName2fileID[tableName]);
+    auto recordHandle = _recordManager->openTable(_tableName2fileID[tableName]);
     //扫描每一条记录，插入一条主键
-    if (recordHandle.openScan()) {
-        RID rid;
-        auto data = new char[tableInfo._recordSize];
+    if (recordHandle->openPageScan()) {
+        vector<RecordRef> records;
         auto primary = new char[primaryKeySize];
-        while (recordHandle.getNextRecord(rid, (BufType)data)) {
-            int offset = 0;//索引数据偏移
-            for (auto &attrName : attrNames) {
-                int attr_id = getAttrIDByName(tableInfo, attrName);
-                AttrInfo &attrInfo = tableInfo._attrs[attr_id];
-                //从记录的对应位置拷贝到主键的对应位置
-                memcpy(primary + offset, data + attrInfo._offset, attrInfo._attrLength);
-                offset += attrInfo._attrLength;
-            }
-            //检查是否重复，若重复则创建主键失败
-            if (!indexHandle.insertEntry((BufType)primary, rid, true, false)) {
-                _indexManager->closeIndex(fileID);
-                _indexManager->destroyIndex(tableName.c_str(), vector<string>(1, "primary"));
-                cerr << "Repetitive primary keys!" << endl;
-                delete[] data;
-                delete[] primary;
-                delete[] attrTypes;
-                delete[] attrLens;
-                return false;
+        while (recordHandle->getNextRecords(records)) {
+            for (const auto &record : records) {
+                const RID &rid = record._rid;
+                const char *data = record._data;
+                int offset = 0;//索引数据偏移
+                for (auto &attrName : attrNames) {
+                    int attr_id = getAttrIDByName(tableInfo, attrName);
+                    AttrInfo &attrInfo = tableInfo._attrs[attr_id];
+                    //从记录的对应位置拷贝到主键的对应位置
+                    memcpy(primary + offset, data + attrInfo._offset, attrInfo._attrLength);
+                    offset += attrInfo._attrLength;
+                }
+                //检查是否重复，若重复则创建主键失败
+                if (!indexHandle.insertEntry((BufType)primary, rid, true, false)) {
+                    _indexManager->closeIndex(fileID);
+                    _indexManager->destroyIndex(tableName.c_str(), vector<string>(1, "primary"));
+                    cerr << "Repetitive primary keys!" << endl;
+                    delete[] primary;
+                    delete[] attrTypes;
+                    delete[] attrLens;
+                    return false;
+                }
+                memset(primary, 0, primaryKeySize);
             }
-            memset(data, 0, tableInfo._recordSize);
-            memset(primary, 0, primaryKeySize);
         }
-        delete[] data;
+        recordHandle->closePageScan();
         delete[] primary;
     }
     //关闭主键文件
@@ -696,7 +810,7 @@ bool SystemManager::createForeign(const std::string &tableName, const std::strin
     //创建foreign文件
     vector<string> foreignAttrNames = vector<string>(attrNames);
     foreignAttrNames.emplace_back("foreign");
-    _indexManager->createIndex(tableName.c_str(), foreignAttrNames, attrNum, attrLens, attrTypes);
+    _indexManager->createIndex(tableName.c_str(), foreignAttrNames, attrNum, attrLens, attrTypes, _indexPageSize);
     int fileID1, fileID2;
     //打开参照表的主键文件
     _indexManager->openIndex(reference.c_str(), vector<string>(1, "primary"), fileID1);
@@ -704,38 +818,39 @@ bool SystemManager::createForeign(const std::string &tableName, const std::strin
     _indexManager->openIndex(tableName.c_str(), foreignAttrNames, fileID2);
     IndexHandle indexHandle1(_bufPageManager, fileID1);
     IndexHandle indexHandle2(_bufPageManager, fileID2);
-    RecordHandle recordHandle(_bufPageManager, _tableName2fileID[tableName]);
+    auto recordHandle = _recordManager->openTable(_tableName2fileID[tableName]);
     //扫描每一条记录，检查是否出现在参照表的主键文件里
-    if (recordHandle.openScan()) {
-        RID rid;
-        auto data = new char[tableInfo._recordSize];
+    if (recordHandle->openPageScan()) {
+        vector<RecordRef> records;
         auto foreign = new char[foreignKeySize];
-        while (recordHandle.getNextRecord(rid, (BufType)data)) {
-            int offset = 0;//外键数据偏移
-            for (auto &attrName: attrNames) {
-                int attr_id = getAttrIDByName(tableInfo, attrName);
-                AttrInfo &attrInfo = tableInfo._attrs[attr_id];
-                //从记录的对应位置拷贝到外键的对应位置
-                memcpy(foreign + offset, data + attrInfo._offset, attrInfo._attrLength);
-                offset += attrInfo._attrLength;
-            }
-            //检查主键文件是否插入成功，若成功说明外键值没有出现在参照表的主键中
-            if (indexHandle1.insertEntry((BufType) foreign, rid, true, true)) {
-                _indexManager->closeIndex(fileID1);
-                _indexManager->closeIndex(fileID2);
-                _indexManager->destroyIndex(tableName.c_str(), foreignAttrNames);
-                cerr << "Foreign key value is not in the reference table!" << endl;
-                delete[] data;
-                delete[] foreign;
-                delete[] attrTypes;
-                delete[] attrLens;
-                return false;
+        while (recordHandle->getNextRecords(records)) {
+            for (const auto &record : records) {
+                const RID &rid = record._rid;
+                const char *data = record._data;
+                int offset = 0;//外键数据偏移
+                for (auto &attrName: attrNames) {
+                    int attr_id = getAttrIDByName(tableInfo, attrName);
+                    AttrInfo &attrInfo = tableInfo._attrs[attr_id];
+                    //从记录的对应位置拷贝到外键的对应位置
+                    memcpy(foreign + offset, data + attrInfo._offset, attrInfo._attrLength);
+                    offset += attrInfo._attrLength;
+                }
+                //检查主键文件是否插入成功，若成功说明外键值没有出现在参照表的主键中
+                if (indexHandle1.insertEntry((BufType) foreign, rid, true, true)) {
+                    _indexManager->closeIndex(fileID1);
+                    _indexManager->closeIndex(fileID2);
+                    _indexManager->destroyIndex(tableName.c_str(), foreignAttrNames);
+                    cerr << "Foreign key value is not in the reference table!" << endl;
+                    delete[] foreign;
+                    delete[] attrTypes;
+                    delete[] attrLens;
+                    return false;
+                }
+                indexHandle2.insertEntry((BufType) foreign, rid, false, false);
+                memset(foreign, 0, foreignKeySize);
             }
-            indexHandle2.insertEntry((BufType) foreign, rid, false, false);
-            memset(data, 0, tableInfo._recordSize);
-            memset(foreign, 0, foreignKeySize);
         }
-        delete[] data;
+        recordHandle->closePageScan();
         delete[] foreign;
     }
     //关闭主键文件和外键文件
@@ -823,40 +938,41 @@ bool SystemManager::createUnique(const string &tableName, const vector<string> &
     //创建unique文件
     vector<string> uniqueAttrNames = vector<string>(attrNames);
     uniqueAttrNames.emplace_back("unique");
-    _indexManager->createIndex(tableName.c_str(), uniqueAttrNames, attrNum, attrLens, attrTypes);
+    _indexManager->createIndex(tableName.c_str(), uniqueAttrNames, attrNum, attrLens, attrTypes, _indexPageSize);
     int fileID;
     _indexManager->openIndex(tableName.c_str(), uniqueAttrNames, fileID);
     IndexHandle indexHandle(_bufPageManager, fileID);
-    RecordHandle recordHandle(_bufPageManager, _tableName2fileID[tableName]);
+    auto recordHandle = _recordManager->openTable(_tableName2fileID[tableName]);
     //扫描每一条记录，插入一条unique数据
-    if (recordHandle.openScan()) {
-        RID rid;
-        auto data = new char[tableInfo._recordSize];//记录数据
+    if (recordHandle->openPageScan()) {
+        vector<RecordRef> records;
         auto unique = new char[attrLen];//unique数据
-        while (recordHandle.getNextRecord(rid, (BufType)data)) {
-            int offset = 0;//unique数据偏移
-            for (auto &attrName : attrNames) {
-                int attr_id = getAttrIDByName(tableInfo, attrName);
-                AttrInfo &attrInfo = tableInfo._attrs[attr_id];
-                //从记录的对应位置拷贝到unique文件的对应位置
-                memcpy(unique + offset, data + attrInfo._offset, attrInfo._attrLength);
-                offset += attrInfo._attrLength;
-            }
-            //检查是否出现重复，若重复则创建unique失败
-            if (!indexHandle.insertEntry((BufType)unique, rid, true, false)) {
-                _indexManager->closeIndex(fileID);
-                _indexManager->destroyIndex(tableName.c_str(), uniqueAttrNames);
-                cerr << "Repetitive unique keys!" << endl;
-                delete[] data;
-                delete[] unique;
-                delete[] attrTypes;
-                delete[] attrLens;
-                return false;
+        while (recordHandle->getNextRecords(records)) {
+            for (const auto &record : records) {
+                const RID &rid = record._rid;
+                const char *data = record._data;
+                int offset = 0;//unique数据偏移
+                for (auto &attrName : attrNames) {
+                    int attr_id = getAttrIDByName(tableInfo, attrName);
+                    AttrInfo &attrInfo = tableInfo._attrs[attr_id];
+                    //从记录的对应位置拷贝到unique文件的对应位置
+                    memcpy(unique + offset, data + attrInfo._offset, attrInfo._attrLength);
+                    offset += attrInfo._attrLength;
+                }
+                //检查是否出现重复，若重复则创建unique失败
+                if (!indexHandle.insertEntry((BufType)unique, rid, true, false)) {
+                    _indexManager->closeIndex(fileID);
+                    _indexManager->destroyIndex(tableName.c_str(), uniqueAttrNames);
+                    cerr << "Repetitive unique keys!" << endl;
+                    delete[] unique;
+                    delete[] attrTypes;
+                    delete[] attrLens;
+                    return false;
+                }
+                memset(unique, 0, attrLen);
             }
-            memset(data, 0, tableInfo._recordSize);
-            memset(unique, 0, attrLen);
         }
-        delete[] data;
+        recordHandle->closePageScan();
         delete[] unique;
     }
     //关闭unique文件
@@ -1010,4 +1126,86 @@ void SystemManager::showIndexNames() {
             }
         }
     }
+}
+
+string SystemManager::getObjectName(const string &fileName) {
+    //表文件名为表名，索引文件名为"表名.列名.列名"，主键、外键和unique文件名分别以primary、foreign和unique结尾
+    vector<string> parts;
+    size_t start = 0, pos;
+    while ((pos = fileName.find('.', start)) != string::npos) {
+        parts.push_back(fileName.substr(start, pos - start));
+        start = pos + 1;
+    }
+    parts.push_back(fileName.substr(start));
+    if (_tables.empty() || getTableIDByName(parts[0]) == -1) return fileName;
+    if (parts.size() == 1) return parts[0];
+    if (parts.back() == "primary") return parts[0] + " PRIMARY KEY";
+    string kind = "INDEX";
+    if (parts.back() == "foreign") kind = "FOREIGN KEY";
+    else if (parts.back() == "unique") kind = "UNIQUE";
+    if (kind != "INDEX") parts.pop_back();
+    string name = parts[0] + " " + kind + " (" + parts[1];
+    for (int i = 2; i < parts.size(); i++) {
+        name += ", " + parts[i];
+    }
+    return name + ")";
+}
+
+void SystemManager::showBufferStatus() {
+    BufStats stats = _bufPageManager->getStats();
+    long long accesses = stats.hits + stats.misses;
+    cout << "Capacity: " << stats.capacity << " pages, " << stats.partitions << " partitions" << endl;
+    //每种页面大小的缓存页面个数
+    cout << "Page classes:";
+    for (size_t i = 0; i < stats.classes.size(); i++) {
+        cout << (i == 0 ? " " : ", ") << stats.classes[i].second << " x " << (stats.classes[i].first >> 10) << "KB";
+    }
+    cout << endl;
+    cout << "Resident: " << stats.resident << " pages, dirty: " << stats.dirty << ", pinned: " << stats.pinned << endl;
+    cout << "Hits: " << stats.hits << ", misses: " << stats.misses;
+    cout << ", hit ratio: " << (accesses == 0 ? 0.0 : 100.0 * stats.hits / accesses) << "%" << endl;
+    cout << "Read-ahead: " << stats.readAhead << ", prefetched: " << stats.prefetched << ", mapped: " << stats.mapped << endl;
+    cout << "Evictions: " << stats.evictions << ", writes: " << stats.writes;
+    cout << ", synchronous writes on eviction: " << stats.dirtyEvictions << endl;
+    if (stats.files.empty()) return;
+    //每个文件一行，表头依次为名称、驻留页面数、脏页数、命中、缺页、命中率、预读、映射、换出、写回
+    const vector<string> header = {"Name", "Resident", "Dirty", "Hits", "Misses", "Hit ratio", "Read-ahead", "Mapped", "Evictions", "Writes"};
+    vector<vector<string>> rows;
+    for (const auto &file : stats.files) {
+        long long fileAccesses = file.hits + file.misses;
+        char ratio[16];
+        snprintf(ratio, sizeof(ratio), "%.2f%%", fileAccesses == 0 ? 0.0 : 100.0 * file.hits / fileAccesses);
+        rows.push_back({getObjectName(file.name), file.fileID == -1 ? "-" : to_string(file.resident),
+                        file.fileID == -1 ? "-" : to_string(file.dirty), to_string(file.hits), to_string(file.misses),
+                        ratio, to_string(file.readAhead), to_string(file.mapped), to_string(file.evictions),
+                        to_string(file.writes)});
+    }
+    vector<int> width;
+    for (const auto &title : header) width.push_back((int) title.length());
+    for (const auto &row : rows) {
+        for (int i = 0; i < row.size(); i++) {
+            width[i] = max(width[i], (int) row[i].length());
+        }
+    }
+    auto printLine = [&]() {
+        cout << "+";
+        for (int w : width) cout << setfill('-') << setw(w + 3) << "+";
+        cout << setfill(' ') << endl;
+    };
+    auto printRow = [&](const vector<string> &row) {
+        cout << "|";
+        for (int i = 0; i < row.size(); i++) {
+            cout << " " << setw(width[i]) << row[i] << " |";
+        }
+        cout << endl;
+    };
+    printLine();
+    printRow(header);
+    printLine();
+    for (const auto &row : rows) printRow(row);
+    printLine();
+}
+
+void SystemManager::resetBufferStatus() {
+    _bufPageManager->resetStats();
 }
\ No newline at end of file
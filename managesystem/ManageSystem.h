@@ -7,6 +7,12 @@
 #include "../recordsystem/RecordSystem.h"
 #include "../indexsystem/IndexSystem.h"
 
+enum TableStorage {
+    ROW_STORAGE,//按行存放，含VARCHAR列的表是否使用变长页面由setSlottedRecords决定
+    PAX_STORAGE,//页面内按列存放
+    COLUMN_STORAGE//每列分段压缩存放，见ColumnHandle
+};
+
 struct AttrInfo {
     std::string _attrName;//列名称
     AttrType _attrType;//列类型
@@ -42,7 +48,13 @@ private:
     int _tableNum;//表数量
     std::vector<TableInfo> _tables;//表
     std::unordered_map<std::string, int> _tableName2fileID;//表名到文件标识符的映射
+    int _tablePageSize, _indexPageSize;//新建表文件和索引文件的页面大小，单位：字节
+    bool _slottedRecords;//新建含VARCHAR列的表时是否使用变长页面
+    TableStorage _tableStorage;//新建表的存储方式
     bool checkForeignConstraint(const TableInfo &tableInfo, const TableInfo &refTableInfo, const std::vector<std::string> &foreignKey);//检查外键约束
+    std::string getObjectName(const std::string &fileName);//根据文件名获得对应的表或索引名称
+    void saveBufferPages();//将缓存中的页面按最近访问的先后保存到buffer.db
+    void loadBufferPages();//读取buffer.db，在后台将其中的页面装入缓存
 public:
     SystemManager(BufPageManager *bufPageManager, IndexManager *indexManager, RecordManager *recordManager);
     ~SystemManager() {};
@@ -52,6 +64,11 @@ public:
     const TableInfo &getTableInfoByID(int id);
     std::string getDBName();//获得当前数据库名称
     int getTableNum();//获得当前数据库表数量
+    bool setPageSize(int tablePageSize, int indexPageSize);//设置新建表文件和索引文件的页面大小，不是4KB到64KB之间的2的幂时返回false
+    int getTablePageSize() const { return _tablePageSize; }//新建表文件的页面大小
+    int getIndexPageSize() const { return _indexPageSize; }//新建索引文件的页面大小
+    void setSlottedRecords(bool slotted);//设置新建含VARCHAR列的表时是否使用变长页面
+    void setTableStorage(TableStorage storage);//设置之后新建的表的存储方式
     bool createDB(const std::string &dbName);//创建数据库
     bool dropDB(const std::string &dbName);//删除数据库
     bool openDB(const std::string &dbName);//打开数据库
@@ -69,6 +86,8 @@ public:
     void showDBNames();//输出所有数据库名称
     void showTableNames();//输出当前数据库所有表名称
     void showIndexNames();//输出所有索引
+    void showBufferStatus();//输出缓存统计信息
+    void resetBufferStatus();//清零缓存统计信息
 };
 
 #endif //MANAGE_SYSTEM_H
@@ -44,6 +44,7 @@ std::any SQLBaseVisitor::visitShow_dbs(SQLParser::Show_dbsContext *ctx) {
 std::any SQLBaseVisitor::visitUse_db(SQLParser::Use_dbContext *ctx) {
     string dbName = _systemManager->getDBName();
     if (!dbName.empty()) if (!_systemManager->closeDB()) return false;
+    _queryManager->resetVacuum();
     if (!_systemManager->openDB(ctx->Identifier()->getText())) return false;
     return true;
 }
@@ -215,7 +216,9 @@ std::any SQLBaseVisitor::visitDrop_table(SQLParser::Drop_tableContext *ctx) {
         std::cerr << "Please select a database first!" << std::endl;
         return false;
     }
-    return _systemManager->dropTable(ctx->Identifier()->getText());
+    if (!_systemManager->dropTable(ctx->Identifier()->getText())) return false;
+    _queryManager->resetVacuum(ctx->Identifier()->getText());
+    return true;
 }
 
 std::any SQLBaseVisitor::visitAlter_table_add_pk(SQLParser::Alter_table_add_pkContext *ctx) {
@@ -416,7 +419,7 @@ std::any SQLBaseVisitor::visitSelect_table(SQLParser::Select_tableContext *ctx)
     auto relAttrs = std::any_cast<std::vector<RelAttr>>(ctx->selectors()->accept(this));
     for (auto &relAttr : relAttrs) {
         if (tableNames.size() == 1) relAttr._relName = tableNames[0];
-        else if (relAttr._relName.empty()) {
+        else if (relAttr._relName.empty() && !relAttr._count) {
             std::cerr << "Column " + relAttr._attrName + " is ambiguous!" << std::endl;
             return false;
         }
@@ -575,6 +578,7 @@ std::any SQLBaseVisitor::visitSelectors(SQLParser::SelectorsContext *ctx) {
 std::any SQLBaseVisitor::visitSelector(SQLParser::SelectorContext *ctx) {
     RelAttr relAttr;
     if (ctx->column() != nullptr) relAttr = std::any_cast<RelAttr>(ctx->column()->accept(this));
+    else if (ctx->Count() != nullptr) relAttr._count = true;
     return relAttr;
 }
 
@@ -692,7 +696,7 @@ std::any SQLBaseVisitor::visitDump_data(SQLParser::Dump_dataContext *ctx) {
             std::cout << (i != tableInfo._attrs.size() - 1 ? ',' : '\n');
         }
         return true;
-    });
+    }, true);
     std::cout.rdbuf(backup);
     fout.close();
     return true;
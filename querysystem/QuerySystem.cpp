@@ -1,7 +1,10 @@
 #include "QuerySystem.h"
 #include <cstring>
 #include <cmath>
+#include <limits>
 #include <iomanip>
+#include <atomic>
+#include <chrono>
 
 using namespace std;
 
@@ -10,6 +13,14 @@ QueryManager::QueryManager(BufPageManager *bufPageManager, IndexManager *indexMa
     _indexManager = indexManager;
     _recordManager = recordManager;
     _systemManager = systemManager;
+    //默认不并行扫描，并行扫描要多占用处理器和缓存页面，由--scan-threads打开
+    _scanThreads = 1;
+}
+
+void QueryManager::setScanThreads(int threads) {
+    //每个处理器核一个工作线程，线程过多时合并结果的开销超过并行的收益
+    if (threads <= 0) threads = min(MAX_SCAN_THREADS, (int) thread::hardware_concurrency());
+    _scanThreads = max(1, threads);
 }
 
 bool QueryManager::compareData(const char *data1, const char *data2, const CompOp &op, const AttrType &attrType) {
@@ -144,10 +155,12 @@ bool QueryManager::checkPrimaryConstraint(const TableInfo &tableInfo, const vect
     return true;
 }
 
-bool QueryManager::checkForeignConstraint(const TableInfo &tableInfo, const vector<Value> &values) {
+bool QueryManager::checkForeignConstraint(const TableInfo &tableInfo, const vector<Value> &values, const unordered_set<string> *batchPrimaries) {
     for (int i = 0; i < tableInfo._foreignKeyNum; i++) {
         const auto &reference = tableInfo._references[i];
         const auto &foreignKey = tableInfo._foreignKeys[i];
+        //参照本表且外键值是同一批中还没有插入的主键
+        if (batchPrimaries != nullptr && reference == tableInfo._tableName && batchPrimaries->count(getKeyData(tableInfo, values, foreignKey))) continue;
         int fileID;
         //打开参照表的主键文件
         _indexManager->openIndex(reference.c_str(), vector<string>(1, "primary"), fileID);
@@ -234,17 +247,309 @@ void QueryManager::intersection(const vector<string> &attrs1, const vector<strin
     }
 }
 
-bool QueryManager::filterTable(const TableInfo &tableInfo, const vector<Condition> &conditions, const function<bool(const RID &, const char *)> &callback) {
-    int fileID, _fileID;
-    //打开数据表文件
-    _recordManager->openFile(tableInfo._tableName.c_str(), fileID);
-    RecordHandle handle(_bufPageManager, fileID);
+/*
+ * @函数名filterColumn
+ * @参数pass:每个槽是否仍然符合条件，不符合的置为0
+ * @参数column:PAX页面中的一列，n个值连续存放
+ * @参数rhs:比较的值
+ * 功能:整列连续判断数值条件，循环中没有分支，编译器可以向量化
+ */
+template<typename T>
+static void filterColumn(char *pass, const char *column, int n, T rhs, CompOp op) {
+    auto value = [column](int i) {
+        T v;
+        memcpy(&v, column + i * sizeof(T), sizeof(T));
+        return v;
+    };
+    switch (op) {
+        case EQ_OP: for (int i = 0; i < n; i++) pass[i] &= value(i) == rhs; break;
+        case NE_OP: for (int i = 0; i < n; i++) pass[i] &= value(i) != rhs; break;
+        case LT_OP: for (int i = 0; i < n; i++) pass[i] &= value(i) < rhs; break;
+        case LE_OP: for (int i = 0; i < n; i++) pass[i] &= value(i) <= rhs; break;
+        case GT_OP: for (int i = 0; i < n; i++) pass[i] &= value(i) > rhs; break;
+        case GE_OP: for (int i = 0; i < n; i++) pass[i] &= value(i) >= rhs; break;
+        default: break;
+    }
+}
+
+bool QueryManager::satisfy(const TableInfo &tableInfo, const char *data, const vector<Condition> &checks) {
+    bool ok = true;
+    for (const auto &condition : checks) {
+        int lhsAttrID = _systemManager->getAttrIDByName(tableInfo, condition._lhsAttr._attrName);
+        const auto lhsAttr = tableInfo._attrs[lhsAttrID];
+        if (condition._rhsIsAttr) {
+            //情况1: 其它列
+            int rhsAttrID = _systemManager->getAttrIDByName(tableInfo, condition._rhsAttr._attrName);
+            const auto rhsAttr = tableInfo._attrs[rhsAttrID];
+            if (((data[lhsAttrID >> 3] >> (lhsAttrID & 7)) & 1) ||
+                ((data[rhsAttrID >> 3] >> (rhsAttrID & 7)) & 1) ||
+                !compareData(data + lhsAttr._offset, data + rhsAttr._offset, condition._op, lhsAttr._attrType)) {
+                ok = false;
+                break;
+            }
+        } else if (condition._op != IS_NULL && condition._op != IS_NOT_NULL) {
+            //情况2: 数值
+            if (condition._rhsValues.empty()) {
+                if (((data[lhsAttrID >> 3] >> (lhsAttrID & 7)) & 1) ||
+                    !compareData(data + lhsAttr._offset, (char *) condition._rhsValue._data, condition._op, lhsAttr._attrType)) {
+                    ok = false;
+                    break;
+                }
+            } else {
+                ok = false;
+                if ((data[lhsAttrID >> 3] >> (lhsAttrID & 7)) & 1) {
+                    for (const auto &value: condition._rhsValues) {
+                        if (value._data == nullptr) {
+                            ok = true;
+                            break;
+                        }
+                    }
+                } else {
+                    for (const auto &value: condition._rhsValues) {
+                        if (value._data != nullptr && compareData(data + lhsAttr._offset, (char *) value._data, EQ_OP, lhsAttr._attrType)) {
+                            ok = true;
+                            break;
+                        }
+                    }
+                }
+                if (!ok) break;
+            }
+        } else {
+            //情况3: 是否为空
+            if (((data[lhsAttrID >> 3] >> (lhsAttrID & 7)) & 1) ^ (condition._op == IS_NULL)) {
+                ok = false;
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
+void QueryManager::planScan(const TableInfo &tableInfo, const vector<Condition> &conditions, const vector<string> *columns, ScanPlan &plan) {
+    //可以按列判断的条件：与数值比较和判断是否为空
+    for (const auto &condition : conditions) {
+        bool byColumn = !condition._rhsIsAttr && condition._rhsValues.empty() && (condition._op == IS_NULL || condition._op == IS_NOT_NULL || condition._rhsValue._data != nullptr);
+        (byColumn ? plan._columnConditions : plan._rowConditions).push_back(condition);
+    }
+    //按列扫描需要读取的列：NULL位图、条件中的列和回调函数读取的列
+    vector<int> &offsets = plan._offsets;
+    offsets.assign(1, 0);
+    auto use = [&](const string &attrName) {
+        int attrID = _systemManager->getAttrIDByName(tableInfo, attrName);
+        if (attrID == -1) return;
+        int offset = tableInfo._attrs[attrID]._offset;
+        if (find(offsets.begin(), offsets.end(), offset) == offsets.end()) offsets.push_back(offset);
+    };
+    for (const auto &condition : conditions) {
+        use(condition._lhsAttr._attrName);
+        if (condition._rhsIsAttr) use(condition._rhsAttr._attrName);
+    }
+    if (columns == nullptr) {
+        for (const auto &attr : tableInfo._attrs) use(attr._attrName);
+    } else {
+        for (const auto &attrName : *columns) use(attrName);
+    }
+    //与INT、FLOAT常量比较的条件给出值的范围，列存储表跳过不可能符合条件的段
+    for (const auto &condition : plan._columnConditions) {
+        const auto &attr = tableInfo._attrs[_systemManager->getAttrIDByName(tableInfo, condition._lhsAttr._attrName)];
+        if (attr._attrType == STRING || condition._op == IS_NULL || condition._op == IS_NOT_NULL || condition._op == NE_OP) continue;
+        double value;
+        if (attr._attrType == INTEGER) {
+            int v;
+            memcpy(&v, condition._rhsValue._data, 4);
+            value = v;
+        } else {
+            float v;
+            memcpy(&v, condition._rhsValue._data, 4);
+            value = v;
+        }
+        ColumnBound bound{attr._offset, -numeric_limits<double>::infinity(), numeric_limits<double>::infinity()};
+        if (condition._op == EQ_OP || condition._op == GT_OP || condition._op == GE_OP) bound._low = value;
+        if (condition._op == EQ_OP || condition._op == LT_OP || condition._op == LE_OP) bound._high = value;
+        plan._bounds.push_back(bound);
+    }
+}
+
+bool QueryManager::scanTable(TableHandle &handle, const TableInfo &tableInfo, const vector<Condition> &conditions, const ScanPlan &plan, int first, int last,
+                             const function<bool(const RID &, const char *)> &callback, bool readOnly, int *skip) {
+    vector<char> buffer(tableInfo._recordSize);
+    char *data = buffer.data();
+    bool success = true;
+    if (handle.openBatchScan(plan._offsets, plan._bounds)) {
+        //PAX页面和列存储表，按列的条件在整批的列上连续判断，其余条件和回调函数只处理符合这些条件的行
+        //只拼出需要读取的列，列存储表只解码用到的列
+        const vector<int> &offsets = plan._offsets;
+        vector<char> pass;
+        vector<ColumnRef> refs(offsets.size());
+        if (first != -1) handle.limitScan(first, last);
+        if (skip != nullptr && conditions.empty()) *skip -= handle.skipRecords(*skip);
+        ColumnBatch batch;
+        while (success && handle.getNextBatch(batch)) {
+            int slotCount = batch._rowCount;
+            pass.assign(batch._valid, batch._valid + slotCount);
+            ColumnRef nulls = handle.getBatchColumn(0);
+            for (const auto &condition : plan._columnConditions) {
+                if (find(pass.begin(), pass.end(), 1) == pass.end()) break;
+                int attrID = _systemManager->getAttrIDByName(tableInfo, condition._lhsAttr._attrName);
+                const auto &attr = tableInfo._attrs[attrID];
+                //NULL位图列中该列对应的位
+                const char *nullByte = nulls._data + (attrID >> 3);
+                int bit = attrID & 7;
+                if (condition._op == IS_NULL || condition._op == IS_NOT_NULL) {
+                    char expect = condition._op == IS_NULL;
+                    for (int i = 0; i < slotCount; i++) pass[i] &= ((nullByte[i * nulls._length] >> bit) & 1) == expect;
+                    continue;
+                }
+                for (int i = 0; i < slotCount; i++) pass[i] &= !((nullByte[i * nulls._length] >> bit) & 1);
+                ColumnRef column = handle.getBatchColumn(attr._offset);
+                const char *rhs = (const char *) condition._rhsValue._data;
+                if (attr._attrType == INTEGER) {
+                    int value;
+                    memcpy(&value, rhs, 4);
+                    filterColumn(pass.data(), column._data, slotCount, value, condition._op);
+                } else if (attr._attrType == FLOAT) {
+                    float value;
+                    memcpy(&value, rhs, 4);
+                    filterColumn(pass.data(), column._data, slotCount, value, condition._op);
+                } else {
+                    for (int i = 0; i < slotCount; i++) {
+                        if (pass[i]) pass[i] = compareData(column._data + i * column._length, rhs, condition._op, STRING);
+                    }
+                }
+            }
+            if (find(pass.begin(), pass.end(), 1) == pass.end()) continue;
+            for (int j = 0; j < (int) offsets.size(); j++) refs[j] = handle.getBatchColumn(offsets[j]);
+            for (int i = 0; i < slotCount; i++) {
+                if (!pass[i]) continue;
+                for (int j = 0; j < (int) offsets.size(); j++) memcpy(data + offsets[j], refs[j]._data + i * refs[j]._length, refs[j]._length);
+                if (!satisfy(tableInfo, data, plan._rowConditions)) continue;
+                if (!callback(RID(batch._first.getPageNum(), batch._first.getSlotNum() + i), data)) {
+                    success = false;
+                    break;
+                }
+            }
+        }
+    } else {
+        //退化为普通情形，逐页扫描，条件直接在页面上判断
+        //回调函数可能修改表时，符合条件的记录先复制出来再交给回调函数
+        vector<RecordRef> records;
+        handle.openPageScan();
+        if (first != -1) handle.limitScan(first, last);
+        if (skip != nullptr && conditions.empty()) *skip -= handle.skipRecords(*skip);
+        while (success && handle.getNextRecords(records)) {
+            for (const auto &record : records) {
+                if (!satisfy(tableInfo, record._data, conditions)) continue;
+                const char *row = record._data;
+                if (!readOnly) {
+                    memcpy(data, record._data, tableInfo._recordSize);
+                    row = data;
+                }
+                if (!callback(record._rid, row)) {
+                    success = false;
+                    break;
+                }
+            }
+        }
+    }
+    handle.closePageScan();
+    return success;
+}
+
+bool QueryManager::parallelScan(TableHandle &handle, const TableInfo &tableInfo, const vector<Condition> &conditions, const ScanPlan &plan,
+                                const function<bool(const RID &, const char *)> *callback, const function<bool(int, const RID &, const char *)> *workerCallback, bool &success) {
+    int units, morsel;
+    if (_scanThreads <= 1 || !handle.getScanUnits(units, morsel)) return false;
+    int fileID = _systemManager->getFileIDByName(tableInfo._tableName);
+    int morsels = (units + morsel - 1) / morsel;
+    //缓存较小时减少工作线程，各线程预读时固定的页面不会占满缓存
+    int workers = min({_scanThreads, morsels, _bufPageManager->maxScanThreads(fileID)});
+    if (workers <= 1) return false;
+    if (_workers == nullptr || _workers->size() != _scanThreads) _workers.reset(new WorkerPool(_scanThreads));
+    //每个工作线程使用自己的接口，扫描位置等状态互不影响，接口在调用线程中打开
+    vector<unique_ptr<TableHandle>> handles;
+    for (int i = 0; i < workers; i++) handles.push_back(_recordManager->openTable(fileID));
+    //按顺序执行回调函数时，工作线程把每块中符合条件的记录复制出来
+    struct Morsel {
+        vector<RID> _rids;
+        vector<char> _rows;
+        bool _done = false;
+    };
+    vector<Morsel> results(callback != nullptr ? morsels : 0);
+    int recordSize = tableInfo._recordSize;
+    mutex latch;//保护next、consumed和每块的_done
+    condition_variable changed;
+    int next = 0;//下一个分给工作线程的块
+    int consumed = 0;//已经交给回调函数的块数，工作线程最多领先window块，限制复制出来的记录占用的内存
+    int window = 4 * workers;
+    atomic<bool> stop(false);
+    _workers->start([&](int worker) {
+        if (worker >= workers) return;
+        TableHandle &own = *handles[worker];
+        while (true) {
+            int i;
+            {
+                unique_lock<mutex> lock(latch);
+                changed.wait(lock, [&] { return stop || next >= morsels || callback == nullptr || next < consumed + window; });
+                if (stop || next >= morsels) break;
+                i = next++;
+            }
+            int first = i * morsel, last = min(units, first + morsel);
+            if (callback != nullptr) {
+                Morsel &result = results[i];
+                scanTable(own, tableInfo, conditions, plan, first, last, [&](const RID &rid, const char *data) -> bool {
+                    result._rids.push_back(rid);
+                    result._rows.insert(result._rows.end(), data, data + recordSize);
+                    return !stop;
+                }, true, nullptr);
+                {
+                    lock_guard<mutex> lock(latch);
+                    result._done = true;
+                }
+                changed.notify_all();
+            } else if (!scanTable(own, tableInfo, conditions, plan, first, last, [&](const RID &rid, const char *data) -> bool {
+                return !stop && (*workerCallback)(worker, rid, data);
+            }, true, nullptr)) stop = true;
+        }
+    });
+    success = true;
+    if (callback != nullptr) {
+        //按块的顺序把记录交给回调函数，顺序与逐页扫描相同
+        for (int i = 0; i < morsels && success; i++) {
+            Morsel &result = results[i];
+            {
+                unique_lock<mutex> lock(latch);
+                changed.wait(lock, [&] { return result._done; });
+            }
+            for (int j = 0; j < (int) result._rids.size(); j++) {
+                if (!(*callback)(result._rids[j], result._rows.data() + (size_t) j * recordSize)) {
+                    success = false;
+                    stop = true;
+                    break;
+                }
+            }
+            vector<RID>().swap(result._rids);
+            vector<char>().swap(result._rows);
+            {
+                lock_guard<mutex> lock(latch);
+                consumed = i + 1;
+            }
+            changed.notify_all();
+        }
+    }
+    _workers->wait();
+    if (callback == nullptr) success = !stop;
+    return true;
+}
+
+bool QueryManager::filterRecords(const TableInfo &tableInfo, const vector<Condition> &conditions, const function<bool(const RID &, const char *)> &callback, bool readOnly,
+                                 const vector<string> *columns, int *skip, bool parallel, const function<bool(int, const RID &, const char *)> *workerCallback) {
+    int _fileID;
+    //使用数据表已打开的文件，保证与缓存中尚未写回的修改一致
+    auto handle = _recordManager->openTable(_systemManager->getFileIDByName(tableInfo._tableName));
     RID rid;
-    char *data = new char[tableInfo._recordSize];
     bool success = true;
     IndexHandle *indexHandle = nullptr;
     void *filterData;
-    AttrType filterType;
     //检查是否可以使用索引加速
     for (const auto &condition : conditions) {
         if (condition._op == EQ_OP && !condition._rhsIsAttr) {
@@ -254,7 +559,6 @@ bool QueryManager::filterTable(const TableInfo &tableInfo, const vector<Conditio
                 _indexManager->openIndex(tableInfo._tableName.c_str(), conditionKey, _fileID);
                 indexHandle = new IndexHandle(_bufPageManager, _fileID);
                 filterData = condition._rhsValue._data;
-                filterType = condition._rhsValue._attrType;
                 break;
             }
             //主键索引
@@ -262,7 +566,6 @@ bool QueryManager::filterTable(const TableInfo &tableInfo, const vector<Conditio
                 _indexManager->openIndex(tableInfo._tableName.c_str(), vector<string>(1, "primary"), _fileID);
                 indexHandle = new IndexHandle(_bufPageManager, _fileID);
                 filterData = condition._rhsValue._data;
-                filterType = condition._rhsValue._attrType;
                 break;
             }
             //唯一索引
@@ -271,96 +574,55 @@ bool QueryManager::filterTable(const TableInfo &tableInfo, const vector<Conditio
                 _indexManager->openIndex(tableInfo._tableName.c_str(), conditionKey, _fileID);
                 indexHandle = new IndexHandle(_bufPageManager, _fileID);
                 filterData = condition._rhsValue._data;
-                filterType = condition._rhsValue._attrType;
                 break;
             }
         }
     }
-    bool hasNext;
-    RID end(-1, -1);
     if (indexHandle != nullptr) {
+        //使用索引时先取出所有符合条件的记录位置，回调函数修改同一个索引文件时不影响扫描
+        char *data = new char[tableInfo._recordSize];
+        vector<RID> rids;
+        RID end(-1, -1);
         //先找到终止位置
         indexHandle->openScan((BufType) filterData, false);
         indexHandle->getNextEntry(end);
-        //从等于的位置开始
+        //从等于的位置开始，到达终止位置结束
         indexHandle->openScan((BufType) filterData, true);
-        hasNext = indexHandle->getNextEntry(rid);
-        if (hasNext) handle.getRecord(rid, (BufType) data);
-    } else {
-        //退化为普通情形
-        handle.openScan();
-        hasNext = handle.getNextRecord(rid, (BufType) data);
-    }
-    while (hasNext) {
-        //到达终止位置，提前结束
-        if (indexHandle != nullptr && rid == end) break;
-        bool ok = true;
-        for (const auto &condition : conditions) {
-            int lhsAttrID = _systemManager->getAttrIDByName(tableInfo, condition._lhsAttr._attrName);
-            const auto lhsAttr = tableInfo._attrs[lhsAttrID];
-            if (condition._rhsIsAttr) {
-                //情况1: 其它列
-                int rhsAttrID = _systemManager->getAttrIDByName(tableInfo, condition._rhsAttr._attrName);
-                const auto rhsAttr = tableInfo._attrs[rhsAttrID];
-                if (((data[lhsAttrID >> 3] >> (lhsAttrID & 7)) & 1) ||
-                    ((data[rhsAttrID >> 3] >> (rhsAttrID & 7)) & 1) ||
-                    !compareData(data + lhsAttr._offset, data + rhsAttr._offset, condition._op, lhsAttr._attrType)) {
-                    ok = false;
-                    break;
-                }
-            } else if (condition._op != IS_NULL && condition._op != IS_NOT_NULL) {
-                //情况2: 数值
-                if (condition._rhsValues.empty()) {
-                    if (((data[lhsAttrID >> 3] >> (lhsAttrID & 7)) & 1) ||
-                        !compareData(data + lhsAttr._offset, (char *) condition._rhsValue._data, condition._op, lhsAttr._attrType)) {
-                        ok = false;
-                        break;
-                    }
-                } else {
-                    ok = false;
-                    if ((data[lhsAttrID >> 3] >> (lhsAttrID & 7)) & 1) {
-                        for (const auto &value: condition._rhsValues) {
-                            if (value._data == nullptr) {
-                                ok = true;
-                                break;
-                            }
-                        }
-                    } else {
-                        for (const auto &value: condition._rhsValues) {
-                            if (value._data != nullptr && compareData(data + lhsAttr._offset, (char *) value._data, EQ_OP, lhsAttr._attrType)) {
-                                ok = true;
-                                break;
-                            }
-                        }
-                    }
-                    if (!ok) break;
-                }
-            } else {
-                //情况3: 是否为空
-                if (((data[lhsAttrID >> 3] >> (lhsAttrID & 7)) & 1) ^ (condition._op == IS_NULL)) {
-                    ok = false;
+        while (indexHandle->getNextEntry(rid) && !(rid == end)) rids.push_back(rid);
+        //每批记录所在的页面先一起读入缓存，再逐条取出记录
+        for (size_t i = 0; i < rids.size() && success;) {
+            size_t end = handle->prefetchRecords(rids, i);
+            for (; i < end; i++) {
+                //页面无法装入缓存时停止，缓存管理器已经报告错误
+                if (!handle->getRecord(rids[i], (BufType) data) || (satisfy(tableInfo, data, conditions) && !callback(rids[i], data))) {
+                    success = false;
                     break;
                 }
             }
         }
-        //如果符合条件，执行函数操作
-        if (ok && !callback(rid, data)) {
-            success = false;
-            break;
-        }
-        if (indexHandle != nullptr) {
-            //使用索引找到下一条记录
-            hasNext = indexHandle->getNextEntry(rid);
-            if (hasNext) handle.getRecord(rid, (BufType) data);
-        } else hasNext = handle.getNextRecord(rid, (BufType) data);
-    }
-    delete[] data;
-    if (indexHandle != nullptr) {
+        delete[] data;
         _indexManager->closeIndex(_fileID);
         delete indexHandle;
+        return success;
     }
-    _recordManager->closeFile(fileID);
-    return success;
+    ScanPlan plan;
+    planScan(tableInfo, conditions, columns, plan);
+    //没有条件时按页面占用摘要跳过开头的记录比并行扫描更快
+    bool skipping = skip != nullptr && *skip > 0 && conditions.empty();
+    if (parallel && readOnly && !skipping && parallelScan(*handle, tableInfo, conditions, plan, workerCallback == nullptr ? &callback : nullptr, workerCallback, success)) return success;
+    return scanTable(*handle, tableInfo, conditions, plan, -1, -1, callback, readOnly, skip);
+}
+
+bool QueryManager::filterTable(const TableInfo &tableInfo, const vector<Condition> &conditions, const function<bool(const RID &, const char *)> &callback, bool readOnly,
+                               const vector<string> *columns, int *skip, bool parallel) {
+    return filterRecords(tableInfo, conditions, callback, readOnly, columns, skip, parallel, nullptr);
+}
+
+bool QueryManager::filterTableByWorkers(const TableInfo &tableInfo, const vector<Condition> &conditions, const function<bool(int, const RID &, const char *)> &callback, const vector<string> *columns) {
+    //不并行时在调用线程中扫描，编号为0
+    return filterRecords(tableInfo, conditions, [&callback](const RID &rid, const char *data) -> bool {
+        return callback(0, rid, data);
+    }, true, columns, nullptr, true, &callback);
 }
 
 bool QueryManager::insertData(const string &tableName, const vector<vector<Value>> &value_list) {
@@ -371,10 +633,17 @@ bool QueryManager::insertData(const string &tableName, const vector<vector<Value
         return false;
     }
     const TableInfo &tableInfo = _systemManager->getTableInfoByID(table_id);
-    RecordHandle recordHandle(_bufPageManager, _systemManager->getFileIDByName(tableName));
-    char *data = new char[tableInfo._recordSize];
+    //先逐行检查，检查通过的行连续存放在rows中，再整批插入记录和索引
+    //遇到不合法的行时停止，它之前的行仍然插入
     int count = 0;
     bool ok = true;
+    string rows;
+    vector<string> primaries;//每行的主键
+    vector<vector<string>> foreigns(tableInfo._foreignKeyNum);//每个外键的每行键值
+    vector<vector<string>> uniques(tableInfo._uniqueNum);//每个unique的每行键值
+    //同一批中已经检查过的主键和unique值，索引中还没有这些行，需要单独检查重复
+    unordered_set<string> batchPrimaries;
+    vector<unordered_set<string>> batchUniques(tableInfo._uniqueNum);
     for (const auto &values : value_list) {
         //检查列数量是否匹配
         if (values.size() != tableInfo._attrNum) {
@@ -402,18 +671,43 @@ bool QueryManager::insertData(const string &tableName, const vector<vector<Value
             ok = false;
             break;
         }
-        //检查外键约束
-        if (!checkForeignConstraint(tableInfo, values)) {
+        string primary;
+        if (!tableInfo._primaryKeys.empty()) {
+            primary = getKeyData(tableInfo, values, tableInfo._primaryKeys);
+            if (batchPrimaries.count(primary)) {
+                cerr << "Repetitive primary keys!" << endl;
+                ok = false;
+                break;
+            }
+        }
+        //检查外键约束，参照本表时外键值也可以是同一批中前面的行的主键
+        if (!checkForeignConstraint(tableInfo, values, &batchPrimaries)) {
             ok = false;
             break;
         }
+        vector<string> foreign(tableInfo._foreignKeyNum);
+        for (int i = 0; i < tableInfo._foreignKeyNum; i++) {
+            foreign[i] = getKeyData(tableInfo, values, tableInfo._foreignKeys[i]);
+        }
         //检查唯一性约束
         if (!checkUniqueConstraint(tableInfo, values)) {
             ok = false;
             break;
         }
+        vector<string> unique(tableInfo._uniqueNum);
+        for (int i = 0; i < tableInfo._uniqueNum; i++) {
+            unique[i] = getKeyData(tableInfo, values, tableInfo._uniques[i]);
+            if (batchUniques[i].count(unique[i])) {
+                cerr << "Unique columns have duplicated values!" << endl;
+                ok = false;
+                break;
+            }
+        }
+        if (!ok) break;
         //准备数据
-        memset(data, 0, tableInfo._recordSize);
+        size_t start = rows.size();
+        rows.resize(start + tableInfo._recordSize, 0);
+        char *data = &rows[start];
         for (int i = 0; i < values.size(); i++) {
             if (values[i]._data == nullptr) data[i >> 3] |= (1 << (i & 7));//标记空位图
             else if (values[i]._attrType == STRING)
@@ -421,56 +715,55 @@ bool QueryManager::insertData(const string &tableName, const vector<vector<Value
             else
                 memcpy(data + tableInfo._attrs[i]._offset, values[i]._data, tableInfo._attrs[i]._attrLength);
         }
-        //插入数据
-        RID rid;
-        recordHandle.insertRecord((BufType) data, rid);
-        //插入主键
         if (!tableInfo._primaryKeys.empty()) {
-            int fileID;
-            //打开主键文件
-            _indexManager->openIndex(tableInfo._tableName.c_str(), vector<string>(1, "primary"), fileID);
-            IndexHandle indexHandle(_bufPageManager, fileID);
-            auto primary = getKeyData(tableInfo, values, tableInfo._primaryKeys);
-            indexHandle.insertEntry((BufType) primary.c_str(), rid, true, false);
-            _indexManager->closeIndex(fileID);
-        }
-        //插入外键
-        for (int i = 0; i < tableInfo._foreignKeyNum; i++) {
-            int fileID;
-            //打开foreign文件
-            vector<string> foreignAttrNames = vector<string>(tableInfo._foreignKeys[i]);
-            foreignAttrNames.emplace_back("foreign");
-            _indexManager->openIndex(tableName.c_str(), foreignAttrNames, fileID);
-            IndexHandle indexHandle(_bufPageManager, fileID);
-            auto foreign = getKeyData(tableInfo, values, tableInfo._foreignKeys[i]);
-            indexHandle.insertEntry((BufType) foreign.c_str(), rid, false, false);
-            _indexManager->closeIndex(fileID);
-        }
-        //插入索引
-        for (int i = 0; i < tableInfo._indexNum; i++) {
-            int fileID;
-            //打开索引文件
-            _indexManager->openIndex(tableName.c_str(), tableInfo._indexes[i], fileID);
-            IndexHandle indexHandle(_bufPageManager, fileID);
-            auto index = getKeyData(tableInfo, values, tableInfo._indexes[i]);
-            indexHandle.insertEntry((BufType) index.c_str(), rid, false, false);
-            _indexManager->closeIndex(fileID);
+            batchPrimaries.insert(primary);
+            primaries.push_back(primary);
         }
-        //插入unique
+        for (int i = 0; i < tableInfo._foreignKeyNum; i++) foreigns[i].push_back(foreign[i]);
         for (int i = 0; i < tableInfo._uniqueNum; i++) {
-            int fileID;
-            //打开unique文件
-            vector<string> uniqueAttrNames = vector<string>(tableInfo._uniques[i]);
-            uniqueAttrNames.emplace_back("unique");
-            _indexManager->openIndex(tableName.c_str(), uniqueAttrNames, fileID);
-            IndexHandle indexHandle(_bufPageManager, fileID);
-            auto unique = getKeyData(tableInfo, values, tableInfo._uniques[i]);
-            indexHandle.insertEntry((BufType) unique.c_str(), rid, true, false);
-            _indexManager->closeIndex(fileID);
+            batchUniques[i].insert(unique[i]);
+            uniques[i].push_back(unique[i]);
         }
         count++;
     }
-    delete[] data;
+    if (count == 0) {
+        cout << count << " row(s) affected" << endl;
+        return ok;
+    }
+    //插入数据
+    vector<RID> rids(count, RID(-1, -1));
+    auto recordHandle = _recordManager->openTable(_systemManager->getFileIDByName(tableName));
+    if (!recordHandle->insertRecords(rows.c_str(), count, rids.data())) {
+        //页面无法装入缓存时只插入了前面的记录，只为它们建立索引
+        count = (int) (find_if(rids.begin(), rids.end(), [](const RID &rid) { return rid.getPageNum() <= 0; }) - rids.begin());
+        cerr << "Insert into " << tableName << " stopped after " << count << " row(s)!" << endl;
+        ok = false;
+    }
+    //每个索引文件只打开一次，按行的顺序插入
+    auto insertKeys = [&](const vector<string> &attrNames, const string &suffix, const vector<string> &keys, bool isUnique) {
+        int fileID;
+        vector<string> indexAttrNames = vector<string>(attrNames);
+        if (!suffix.empty()) indexAttrNames.emplace_back(suffix);
+        _indexManager->openIndex(tableName.c_str(), indexAttrNames, fileID);
+        IndexHandle indexHandle(_bufPageManager, fileID);
+        for (int j = 0; j < count; j++) {
+            indexHandle.insertEntry((BufType) keys[j].c_str(), rids[j], isUnique, false);
+        }
+        _indexManager->closeIndex(fileID);
+    };
+    //插入主键
+    if (!tableInfo._primaryKeys.empty()) insertKeys(vector<string>(1, "primary"), "", primaries, true);
+    //插入外键
+    for (int i = 0; i < tableInfo._foreignKeyNum; i++) insertKeys(tableInfo._foreignKeys[i], "foreign", foreigns[i], false);
+    //插入索引
+    for (int i = 0; i < tableInfo._indexNum; i++) {
+        vector<string> indexes;
+        indexes.reserve(count);
+        for (int j = 0; j < count; j++) indexes.push_back(getKeyData(tableInfo, &rows[(size_t) j * tableInfo._recordSize], tableInfo._indexes[i]));
+        insertKeys(tableInfo._indexes[i], "", indexes, false);
+    }
+    //插入unique
+    for (int i = 0; i < tableInfo._uniqueNum; i++) insertKeys(tableInfo._uniques[i], "unique", uniques[i], true);
     cout << count << " row(s) affected" << endl;
     return ok;
 }
@@ -485,7 +778,8 @@ bool QueryManager::deleteData(const string &tableName, const vector<Condition> &
     const TableInfo &tableInfo = _systemManager->getTableInfoByID(table_id);
     //检查过滤条件
     if (!checkConditions(tableInfo, conditions)) return false;
-    RecordHandle recordHandle(_bufPageManager, _systemManager->getFileIDByName(tableName));
+    auto recordHandle = _recordManager->openTable(_systemManager->getFileIDByName(tableName));
+    forgetForwards(tableName);
     IndexHandle *primaryHandle = nullptr;
     int fileID;
     vector<int> fileIDs;
@@ -547,7 +841,7 @@ bool QueryManager::deleteData(const string &tableName, const vector<Condition> &
             }
         }
         return true;
-    });
+    }, true);
     //若合法则完成删除
     if (ok) {
         int count = 0;//记录删除数量
@@ -555,7 +849,7 @@ bool QueryManager::deleteData(const string &tableName, const vector<Condition> &
                     [&count, &tableInfo, &recordHandle, primaryHandle, &foreignHandles, &indexHandles, &uniqueHandles, this]
                     (const RID &rid, const char *data) -> bool {
             //删除数据记录
-            recordHandle.deleteRecord(rid);
+            recordHandle->deleteRecord(rid);
             //删除主键索引
             if (primaryHandle != nullptr) {
                 auto primary = getKeyData(tableInfo, data, tableInfo._primaryKeys);
@@ -589,6 +883,89 @@ bool QueryManager::deleteData(const string &tableName, const vector<Condition> &
     return ok;
 }
 
+void QueryManager::forgetForwards(const string &tableName) {
+    auto state = _vacuumStates.find(tableName);
+    if (state == _vacuumStates.end()) return;
+    state->second._homesValid = false;
+    state->second._forwardHomes.clear();
+}
+
+void QueryManager::resetVacuum(const string &tableName) {
+    if (tableName.empty()) _vacuumStates.clear();
+    else _vacuumStates.erase(tableName);
+}
+
+bool QueryManager::vacuumTable(const string &tableName, int limit) {
+    //检查表是否存在
+    int table_id = _systemManager->getTableIDByName(tableName);
+    if (table_id == -1) {
+        cerr << "Table " << tableName << " does not exist!" << endl;
+        return false;
+    }
+    const TableInfo &tableInfo = _systemManager->getTableInfoByID(table_id);
+    auto recordHandle = _recordManager->openTable(_systemManager->getFileIDByName(tableName));
+    //分批整理时，上一次停止的页面之前的页面已经没有空位，之后删除留下的空位留给不带limit的整理
+    //变长页面的转发关系在批与批之间保留，表没有被删改时不必重新逐页建立
+    VacuumState &state = _vacuumStates[tableName];
+    if (limit <= 0) state._cursor = 1;
+    if (!recordHandle->openVacuum(state)) {
+        _vacuumStates.erase(tableName);
+        cerr << "Table " << tableName << " can not be vacuumed!" << endl;
+        return false;
+    }
+    //指向本表记录的所有索引文件：主键、外键、索引和unique，以及各自的键和是否唯一
+    vector<IndexHandle> indexHandles;
+    vector<const vector<string> *> indexKeys;
+    vector<bool> isUniques;
+    vector<int> fileIDs;
+    auto openKeys = [&](const vector<string> &attrNames, const string &suffix, const vector<string> &keys, bool isUnique) {
+        int fileID;
+        vector<string> indexAttrNames = vector<string>(attrNames);
+        if (!suffix.empty()) indexAttrNames.emplace_back(suffix);
+        _indexManager->openIndex(tableName.c_str(), indexAttrNames, fileID);
+        indexHandles.emplace_back(_bufPageManager, fileID);
+        indexKeys.push_back(&keys);
+        isUniques.push_back(isUnique);
+        fileIDs.push_back(fileID);
+    };
+    if (!tableInfo._primaryKeys.empty()) openKeys(vector<string>(1, "primary"), "", tableInfo._primaryKeys, true);
+    for (int i = 0; i < tableInfo._foreignKeyNum; i++) openKeys(tableInfo._foreignKeys[i], "foreign", tableInfo._foreignKeys[i], false);
+    for (int i = 0; i < tableInfo._indexNum; i++) openKeys(tableInfo._indexes[i], "", tableInfo._indexes[i], false);
+    for (int i = 0; i < tableInfo._uniqueNum; i++) openKeys(tableInfo._uniques[i], "unique", tableInfo._uniques[i], true);
+    //每批移动至多VACUUM_BATCH条记录，随即改正这些记录的索引，表和索引在批与批之间保持一致
+    int count = 0;
+    vector<pair<RID, RID>> moves;
+    vector<char> data(tableInfo._recordSize);
+    bool more = false;
+    while (true) {
+        if (limit > 0 && count >= limit) {
+            more = true;
+            break;
+        }
+        int batch = limit > 0 ? min(VACUUM_BATCH, limit - count) : VACUUM_BATCH;
+        if (!recordHandle->vacuumStep(moves, batch)) break;
+        for (const auto &move : moves) {
+            recordHandle->getRecord(move.second, (BufType) data.data());
+            for (int i = 0; i < indexHandles.size(); i++) {
+                auto key = getKeyData(tableInfo, data.data(), *indexKeys[i]);
+                indexHandles[i].deleteEntry((BufType) key.c_str(), move.first);
+                indexHandles[i].insertEntry((BufType) key.c_str(), move.second, isUniques[i], false);
+            }
+        }
+        count += (int) moves.size();
+    }
+    int pages = recordHandle->closeVacuum();
+    if (!more) state._cursor = 1;
+    //关闭所有索引文件
+    for (const auto &_fileID: fileIDs) {
+        _indexManager->closeIndex(_fileID);
+    }
+    cout << count << " row(s) moved, " << pages << " page(s) released";
+    if (more) cout << ", run VACUUM " << tableName << " LIMIT n again to continue";
+    cout << endl;
+    return true;
+}
+
 bool QueryManager::updateData(const string &tableName, const vector<RelAttr> &relAttrs, const vector<Value> &values, const vector<Condition> &conditions) {
     //检查表是否存在
     int table_id = _systemManager->getTableIDByName(tableName);
@@ -619,7 +996,8 @@ bool QueryManager::updateData(const string &tableName, const vector<RelAttr> &re
     }
     //检查过滤条件
     if (!checkConditions(tableInfo, conditions)) return false;
-    RecordHandle recordHandle(_bufPageManager, _systemManager->getFileIDByName(tableName));
+    auto recordHandle = _recordManager->openTable(_systemManager->getFileIDByName(tableName));
+    forgetForwards(tableName);
     IndexHandle *primaryHandle = nullptr;
     int fileID;
     vector<int> fileIDs;
@@ -760,7 +1138,7 @@ bool QueryManager::updateData(const string &tableName, const vector<RelAttr> &re
             }
         }
         //更新数据记录
-        recordHandle.updateRecord(rid, (BufType) newData);
+        recordHandle->updateRecord(rid, (BufType) newData);
         //更新所有键值
         if (primaryHandle != nullptr) {
             updateKeyData(tableInfo, rid, *primaryHandle, data, newData, tableInfo._primaryKeys, true);
@@ -787,6 +1165,12 @@ bool QueryManager::updateData(const string &tableName, const vector<RelAttr> &re
 }
 
 bool QueryManager::selectData(const vector<string> &tableNames, const vector<RelAttr> &relAttrs, const vector<Condition> &conditions, int limit, int offset) {
+    for (const auto &relAttr : relAttrs) {
+        if (relAttr._count && (relAttrs.size() > 1 || tableNames.size() > 1)) {
+            cerr << "COUNT(*) can only be selected alone from one table!" << endl;
+            return false;
+        }
+    }
     if (tableNames.size() == 1) {
         //检查表是否存在
         int table_id = _systemManager->getTableIDByName(tableNames[0]);
@@ -797,6 +1181,7 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
         const TableInfo &tableInfo = _systemManager->getTableInfoByID(table_id);
         vector<string> attrNames;
         for (const auto &relAttr : relAttrs) {
+            if (relAttr._count) continue;
             if (_systemManager->getAttrIDByName(tableInfo, relAttr._attrName) == -1) {
                 cerr << "Column " + relAttr._attrName + " does not exist!" << endl;
                 return false;
@@ -804,6 +1189,33 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
             attrNames.push_back(relAttr._attrName);
         }
         if (!checkConditions(tableInfo, conditions)) return false;
+        if (!relAttrs.empty() && relAttrs[0]._count) {
+            //没有条件时直接使用信息头中维护的记录条数，不需要扫描
+            int count = 0;
+            auto start = chrono::steady_clock::now();
+            if (conditions.empty()) count = _recordManager->openTable(_systemManager->getFileIDByName(tableInfo._tableName))->getRecordCount();
+            else {
+                //每个工作线程单独计数，最后相加，计数器各占一个缓存行
+                struct alignas(64) Counter {
+                    int _count = 0;
+                };
+                vector<Counter> counters(_scanThreads);
+                vector<string> noColumns;
+                filterTableByWorkers(tableInfo, conditions, [&counters](int worker, const RID &rid, const char *data) -> bool {
+                    counters[worker]._count++;
+                    return true;
+                }, &noColumns);
+                for (const auto &counter : counters) count += counter._count;
+            }
+            int rows = offset == 0 && limit > 0 ? 1 : 0;
+            cout << "+" << setfill('-') << setw(13) << "+" << setfill(' ') << endl;
+            cout << "| " << setw(10) << "COUNT(*)" << " | " << endl;
+            cout << "+" << setfill('-') << setw(13) << "+" << setfill(' ') << endl;
+            if (rows == 1) cout << "| " << setw(10) << count << " |" << endl;
+            cout << "+" << setfill('-') << setw(13) << "+" << setfill(' ') << endl;
+            cout << rows << " row(s) in set (" << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " sec)" << endl;
+            return true;
+        }
         //记录每列长度
         vector<int> headerLength;
         vector<string> colNames;
@@ -832,7 +1244,9 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
         }
         cout << setfill(' ') << endl;
         int count = 0;
-        clock_t start = clock();
+        //工作线程占用的处理器时间会计入clock()，用经过的时间
+        auto start = chrono::steady_clock::now();
+        bool parallel = (long long) limit + offset >= PARALLEL_ROWS;
         filterTable(tableInfo, conditions, [&headerLength, &count, &tableInfo, &colNames, &limit, &offset](const RID &rid, const char *data) -> bool {
             if (offset == 0) {
                 cout << "|";
@@ -858,20 +1272,20 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
                         }
                         cout << " |";
                         pos++;
-                        if (iter++ == colNames.end()) break;
+                        if (++iter == colNames.end()) break;
                     }
                 }
                 cout << endl;
                 count++;
             } else offset--;
             return count < limit;
-        });
+        }, true, relAttrs.empty() ? nullptr : &attrNames, &offset, parallel);
         cout << "+";
         for (int i = 0; i < colNames.size(); i++) {
             cout << setfill('-') << setw(headerLength[i] + 3) << "+";
         }
         cout << setfill(' ') << endl;
-        cout << count << " row(s) in set (" << (double)(clock() - start) / CLOCKS_PER_SEC << " sec)" << endl;
+        cout << count << " row(s) in set (" << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " sec)" << endl;
     } else if (tableNames.size() == 2) {
         //检查表是否存在
         int table_id_1 = _systemManager->getTableIDByName(tableNames[0]);
@@ -974,37 +1388,38 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
                 else attrNames2.push_back(relAttr._attrName);
             }
         }
-        //检查table2是否有对应条件列的索引
-        bool hasIndex = false;
-        for (const auto &condition : conditions) {
-            if (condition._op == EQ_OP) {
-                vector<string> conditionKey(1, condition._lhsAttr._attrName);
-                if (find(tableInfo2._indexes.begin(), tableInfo2._indexes.end(), conditionKey) != tableInfo2._indexes.end()) {
-                    hasIndex = true;
-                    break;
-                }
-                if (tableInfo2._primaryKeys == conditionKey) {
-                    hasIndex = true;
-                    break;
-                }
-                if (find(tableInfo2._uniques.begin(), tableInfo2._uniques.end(), conditionKey) != tableInfo2._uniques.end()) {
-                    hasIndex = true;
-                    break;
-                }
+        //检查表是否有等值条件列的索引，作为内表时可以用索引查找
+        auto indexed = [&conditions](const TableInfo &tableInfo) -> bool {
+            for (const auto &condition : conditions) {
+                if (condition._op != EQ_OP) continue;
+                string attrName;
+                if (condition._lhsAttr._relName == tableInfo._tableName) attrName = condition._lhsAttr._attrName;
+                else if (condition._rhsIsAttr && condition._rhsAttr._relName == tableInfo._tableName) attrName = condition._rhsAttr._attrName;
+                else continue;
+                vector<string> conditionKey(1, attrName);
+                if (find(tableInfo._indexes.begin(), tableInfo._indexes.end(), conditionKey) != tableInfo._indexes.end()) return true;
+                if (tableInfo._primaryKeys == conditionKey) return true;
+                if (find(tableInfo._uniques.begin(), tableInfo._uniques.end(), conditionKey) != tableInfo._uniques.end()) return true;
             }
-        }
-        //循环内的的表尽量有索引
-        const TableInfo &inTableInfo = hasIndex ? tableInfo2 : tableInfo1;
-        const TableInfo &outTableInfo = hasIndex ? tableInfo1 : tableInfo2;
-        const vector<string> &inRelAttrs = hasIndex ? attrNames2 : attrNames1;
-        const vector<string> &outRelAttrs = hasIndex ? attrNames1 : attrNames2;
-        //记录每列长度
+            return false;
+        };
+        //用信息头中的记录条数估计嵌套循环的代价：外表扫描一次，每条外表记录扫描一次内表或在内表的索引中查找一次
+        int rows1 = _recordManager->openTable(_systemManager->getFileIDByName(tableInfo1._tableName))->getRecordCount();
+        int rows2 = _recordManager->openTable(_systemManager->getFileIDByName(tableInfo2._tableName))->getRecordCount();
+        auto joinCost = [](double outRows, double inRows, bool inIndexed) -> double {
+            return outRows + outRows * (inIndexed ? log2(inRows + 2) : inRows + 1);
+        };
+        bool inTable2 = joinCost(rows1, rows2, indexed(tableInfo2)) < joinCost(rows2, rows1, indexed(tableInfo1));
+        //选择代价较小的顺序，代价相同时table1为内表
+        const TableInfo &inTableInfo = inTable2 ? tableInfo2 : tableInfo1;
+        const TableInfo &outTableInfo = inTable2 ? tableInfo1 : tableInfo2;
+        //记录每列长度，列按FROM中表的顺序输出，与内外表的选择无关
         vector<int> headerLength;
         vector<string> colNames;
         vector<string> attrNames;
-        for (const auto &attr : outTableInfo._attrs) {
-            if (find(outRelAttrs.begin(), outRelAttrs.end(), attr._attrName) != outRelAttrs.end()) {
-                string colName = outTableInfo._tableName + "." + attr._attrName;
+        for (const auto &attr : tableInfo1._attrs) {
+            if (find(attrNames1.begin(), attrNames1.end(), attr._attrName) != attrNames1.end()) {
+                string colName = tableInfo1._tableName + "." + attr._attrName;
                 if (attr._attrType == INTEGER) headerLength.push_back(max(10, (int) colName.length()));
                 else if (attr._attrType == FLOAT) headerLength.push_back(max(12, (int) colName.length()));
                 else headerLength.push_back(max(attr._attrLength, (int) colName.length()));
@@ -1012,9 +1427,11 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
                 attrNames.push_back(attr._attrName);
             }
         }
-        for (const auto &attr : inTableInfo._attrs) {
-            if (find(inRelAttrs.begin(), inRelAttrs.end(), attr._attrName) != inRelAttrs.end()) {
-                string colName = inTableInfo._tableName + "." + attr._attrName;
+        //attrNames中前columns1列属于table1，两张表可能有同名的列，输出时分别匹配
+        int columns1 = (int) attrNames.size();
+        for (const auto &attr : tableInfo2._attrs) {
+            if (find(attrNames2.begin(), attrNames2.end(), attr._attrName) != attrNames2.end()) {
+                string colName = tableInfo2._tableName + "." + attr._attrName;
                 if (attr._attrType == INTEGER) headerLength.push_back(max(10, (int) colName.length()));
                 else if (attr._attrType == FLOAT) headerLength.push_back(max(12, (int) colName.length()));
                 else headerLength.push_back(max(attr._attrLength, (int) colName.length()));
@@ -1039,16 +1456,14 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
         }
         cout << setfill(' ') << endl;
         int count = 0;
-        clock_t start = clock();
-        //打开外表的记录文件
-        int fileID;
-        _recordManager->openFile(outTableInfo._tableName.c_str(), fileID);
-        RecordHandle handle(_bufPageManager, fileID);
+        auto start = chrono::steady_clock::now();
+        //外表的记录文件
+        auto handle = _recordManager->openTable(_systemManager->getFileIDByName(outTableInfo._tableName));
         RID rid;
         char *outData = new char[outTableInfo._recordSize];
         //遍历外表，筛选出符合条件的记录，将内表的条件更新为对应数据
-        handle.openScan();
-        while (handle.getNextRecord(rid, (BufType) outData)) {
+        handle->openScan();
+        while (handle->getNextRecord(rid, (BufType) outData)) {
             bool ok = true;
             //内表的所有筛选条件
             vector<Condition> inConditions;
@@ -1148,64 +1563,66 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
             }
             //对每条符合条件的外表记录，筛选出对应的符合条件的内表记录
             if (ok) {
-                filterTable(inTableInfo, inConditions, [&headerLength, &count, &outTableInfo, &inTableInfo, &attrNames, outData, &limit, &offset](const RID &rid, const char *data) -> bool {
+                filterTable(inTableInfo, inConditions, [&headerLength, &count, &tableInfo1, &tableInfo2, &attrNames, columns1, outData, inTable2, &limit, &offset](const RID &rid, const char *data) -> bool {
                     if (offset == 0) {
+                        const char *row1 = inTable2 ? outData : data;
+                        const char *row2 = inTable2 ? data : outData;
                         cout << "|";
                         int pos = 0;
-                        //输出外表数据
+                        //输出table1的数据
                         auto iter = attrNames.begin();
-                        for (int i = 0; i < outTableInfo._attrs.size(); i++) {
-                            if (*iter == outTableInfo._attrs[i]._attrName) {
+                        for (int i = 0; i < tableInfo1._attrs.size() && iter != attrNames.begin() + columns1; i++) {
+                            if (*iter == tableInfo1._attrs[i]._attrName) {
                                 cout << " ";
-                                if ((outData[i >> 3] >> (i & 7)) & 1) cout << setw(headerLength[pos]) << "NULL";
-                                else if (outTableInfo._attrs[i]._attrType == INTEGER) {
+                                if ((row1[i >> 3] >> (i & 7)) & 1) cout << setw(headerLength[pos]) << "NULL";
+                                else if (tableInfo1._attrs[i]._attrType == INTEGER) {
                                     int a;
-                                    memcpy(&a, outData + outTableInfo._attrs[i]._offset, outTableInfo._attrs[i]._attrLength);
+                                    memcpy(&a, row1 + tableInfo1._attrs[i]._offset, tableInfo1._attrs[i]._attrLength);
                                     cout << setw(headerLength[pos]) << a;
-                                } else if (outTableInfo._attrs[i]._attrType == FLOAT) {
+                                } else if (tableInfo1._attrs[i]._attrType == FLOAT) {
                                     float a;
-                                    memcpy(&a, outData + outTableInfo._attrs[i]._offset, outTableInfo._attrs[i]._attrLength);
+                                    memcpy(&a, row1 + tableInfo1._attrs[i]._offset, tableInfo1._attrs[i]._attrLength);
                                     cout << setw(headerLength[pos]) << a;
                                 } else {
-                                    char *a = new char[outTableInfo._attrs[i]._attrLength];
-                                    memcpy(a, outData + outTableInfo._attrs[i]._offset, outTableInfo._attrs[i]._attrLength);
+                                    char *a = new char[tableInfo1._attrs[i]._attrLength];
+                                    memcpy(a, row1 + tableInfo1._attrs[i]._offset, tableInfo1._attrs[i]._attrLength);
                                     cout << setw(headerLength[pos]) << a;
                                     delete[] a;
                                 }
                                 cout << " |";
                                 pos++;
-                                if (iter++ == attrNames.end()) break;
+                                iter++;
                             }
                         }
-                        //输出内表数据
-                        for (int i = 0; i < inTableInfo._attrs.size(); i++) {
-                            if (*iter == inTableInfo._attrs[i]._attrName) {
+                        //输出table2的数据
+                        for (int i = 0; i < tableInfo2._attrs.size() && iter != attrNames.end(); i++) {
+                            if (*iter == tableInfo2._attrs[i]._attrName) {
                                 cout << " ";
-                                if ((data[i >> 3] >> (i & 7)) & 1) cout << setw(headerLength[pos]) << "NULL";
-                                else if (inTableInfo._attrs[i]._attrType == INTEGER) {
+                                if ((row2[i >> 3] >> (i & 7)) & 1) cout << setw(headerLength[pos]) << "NULL";
+                                else if (tableInfo2._attrs[i]._attrType == INTEGER) {
                                     int a;
-                                    memcpy(&a, data + inTableInfo._attrs[i]._offset, inTableInfo._attrs[i]._attrLength);
+                                    memcpy(&a, row2 + tableInfo2._attrs[i]._offset, tableInfo2._attrs[i]._attrLength);
                                     cout << setw(headerLength[pos]) << a;
-                                } else if (inTableInfo._attrs[i]._attrType == FLOAT) {
+                                } else if (tableInfo2._attrs[i]._attrType == FLOAT) {
                                     float a;
-                                    memcpy(&a, data + inTableInfo._attrs[i]._offset, inTableInfo._attrs[i]._attrLength);
+                                    memcpy(&a, row2 + tableInfo2._attrs[i]._offset, tableInfo2._attrs[i]._attrLength);
                                     cout << setw(headerLength[pos]) << a;
                                 } else {
-                                    char *a = new char[inTableInfo._attrs[i]._attrLength];
-                                    memcpy(a, data + inTableInfo._attrs[i]._offset, inTableInfo._attrs[i]._attrLength);
+                                    char *a = new char[tableInfo2._attrs[i]._attrLength];
+                                    memcpy(a, row2 + tableInfo2._attrs[i]._offset, tableInfo2._attrs[i]._attrLength);
                                     cout << setw(headerLength[pos]) << a;
                                     delete[] a;
                                 }
                                 cout << " |";
                                 pos++;
-                                if (iter++ == attrNames.end()) break;
+                                iter++;
                             }
                         }
                         cout << endl;
                         count++;
                     } else offset--;
                     return count < limit;
-                });
+                }, true);
                 if (count == limit) break;
             }
         }
@@ -1214,9 +1631,8 @@ bool QueryManager::selectData(const vector<string> &tableNames, const vector<Rel
             cout << setfill('-') << setw(headerLength[i] + 3) << "+";
         }
         cout << setfill(' ') << endl;
-        cout << count << " row(s) in set (" << (double)(clock() - start) / CLOCKS_PER_SEC << " sec)" << endl;
+        cout << count << " row(s) in set (" << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " sec)" << endl;
         delete[] outData;
-        _recordManager->closeFile(fileID);
     }
     return true;
 }
\ No newline at end of file
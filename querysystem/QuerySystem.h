@@ -3,6 +3,10 @@
 
 #include <vector>
 #include <functional>
+#include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include "WorkerPool.h"
 #include "../recordsystem/RecordSystem.h"
 #include "../indexsystem/IndexSystem.h"
 #include "../managesystem/ManageSystem.h"
@@ -14,6 +18,7 @@ enum CompOp {
 struct RelAttr {
     std::string _relName;
     std::string _attrName;
+    bool _count = false;//是否为COUNT(*)
 };
 
 struct Value {
@@ -32,27 +37,72 @@ struct Condition {
 
 class QueryManager {
 private:
+    static constexpr int VACUUM_BATCH = 1024;//整理表文件时每批移动的记录数
+    static constexpr int MAX_SCAN_THREADS = 16;//按处理器核数设置并行扫描工作线程数时的上限
+    static constexpr int PARALLEL_ROWS = 4096;//LIMIT和OFFSET合计少于这个行数的查询逐页扫描，工作线程预先复制出的块大多用不到
     BufPageManager *_bufPageManager;//缓存页面管理
     IndexManager *_indexManager;//索引管理
     RecordManager *_recordManager;//记录管理
     SystemManager *_systemManager;//系统管理
+    int _scanThreads;//并行扫描的工作线程数，1表示不并行
+    std::unique_ptr<WorkerPool> _workers;//并行扫描的工作线程，第一次并行扫描时创建
+    std::unordered_map<std::string, VacuumState> _vacuumStates;//分批整理的表在批与批之间保留的状态
+    void forgetForwards(const std::string &tableName);//删改记录后转发关系可能改变，下一次整理重新建立
+
+    //不使用索引时扫描数据表的方式，由条件和要读取的列决定
+    struct ScanPlan {
+        std::vector<Condition> _columnConditions;//可以按列判断的条件：与数值比较和判断是否为空
+        std::vector<Condition> _rowConditions;//其余条件，在拼出的记录上判断
+        std::vector<int> _offsets;//按列扫描需要读取的列在记录中的偏移
+        std::vector<ColumnBound> _bounds;//与INT、FLOAT常量比较的条件给出的值的范围
+    };
+
     bool compareData(const char *data1, const char *data2, const CompOp &op, const AttrType &attrType);//比较数据关系
     std::string getKeyData(const TableInfo &tableInfo, const std::vector<Value> &values, const std::vector<std::string> &keys);//获得键数据
     std::string getKeyData(const TableInfo &tableInfo, const char *data, const std::vector<std::string> &keys);//获得键数据
     void updateKeyData(const TableInfo &tableInfo, const RID &rid, IndexHandle indexHandle, const char *data, const char *newData, const std::vector<std::string> &keys, bool isUnique);//更新键数据
     bool checkPrimaryConstraint(const TableInfo &tableInfo, const std::vector<Value> &values);//检查主键约束
-    bool checkForeignConstraint(const TableInfo &tableInfo, const std::vector<Value> &values);//检查外键约束
+    //检查外键约束，batchPrimaries为同一批插入中还没有写入主键文件的主键，参照本表的外键值在其中时也满足约束
+    bool checkForeignConstraint(const TableInfo &tableInfo, const std::vector<Value> &values, const std::unordered_set<std::string> *batchPrimaries = nullptr);
     bool checkUniqueConstraint(const TableInfo &tableInfo, const std::vector<Value> &values);//检查唯一性约束
     bool checkConditions(const TableInfo &tableInfo, const std::vector<Condition> &conditions);//检查过滤条件是否合法
     void intersection(const std::vector<std::string> &attrs1, const std::vector<std::string> &attrs2, std::vector<std::string> &attrs);//求两个向量的交集
+    bool satisfy(const TableInfo &tableInfo, const char *data, const std::vector<Condition> &checks);//判断一条记录是否符合checks中的所有条件
+    void planScan(const TableInfo &tableInfo, const std::vector<Condition> &conditions, const std::vector<std::string> *columns, ScanPlan &plan);
+    //用handle扫描扫描单位在[first,last)中的记录，first为-1时扫描整个表，符合条件的记录交给回调函数，回调函数返回false时停止并返回false
+    bool scanTable(TableHandle &handle, const TableInfo &tableInfo, const std::vector<Condition> &conditions, const ScanPlan &plan, int first, int last,
+                   const std::function<bool(const RID &, const char *)> &callback, bool readOnly, int *skip);
+    //把表分块交给工作线程并行扫描，表太小或不支持分块时返回false，不扫描
+    //callback不为空时按分块顺序在调用线程中执行，否则workerCallback在工作线程中执行，success返回回调函数是否没有要求停止
+    bool parallelScan(TableHandle &handle, const TableInfo &tableInfo, const std::vector<Condition> &conditions, const ScanPlan &plan,
+                      const std::function<bool(const RID &, const char *)> *callback, const std::function<bool(int, const RID &, const char *)> *workerCallback, bool &success);
+    bool filterRecords(const TableInfo &tableInfo, const std::vector<Condition> &conditions, const std::function<bool(const RID &, const char *)> &callback, bool readOnly,
+                       const std::vector<std::string> *columns, int *skip, bool parallel, const std::function<bool(int, const RID &, const char *)> *workerCallback);
 public:
     QueryManager(BufPageManager *bufPageManager, IndexManager *indexManager, RecordManager *recordManager, SystemManager *systemManager);
     ~QueryManager() {};
-    bool filterTable(const TableInfo &tableInfo, const std::vector<Condition> &conditions, const std::function<bool(const RID &, const char *)> &callback);//根据条件筛选符合的数据，用传入的函数对象进行操作
+    //根据条件筛选符合的数据，用传入的函数对象进行操作，函数对象返回false时停止
+    //readOnly为true表示函数对象不修改表，此时传入的数据直接指向缓存页面，不再复制
+    //columns不为空时函数对象只读取NULL位图和这些列，按列存放的表只拼出这些列
+    //skip不为空且没有条件时，扫描前按页面占用摘要跳过开头至多*skip条记录，*skip减去跳过的记录条数
+    //parallel为true且readOnly为true时，不使用索引的扫描分块交给工作线程并行执行，回调函数仍在调用线程中按逐页扫描的顺序执行
+    //此时回调函数不能访问缓存页面，只适合输出、统计等操作
+    bool filterTable(const TableInfo &tableInfo, const std::vector<Condition> &conditions, const std::function<bool(const RID &, const char *)> &callback, bool readOnly = false, const std::vector<std::string> *columns = nullptr, int *skip = nullptr, bool parallel = false);
+    //与filterTable相同，但回调函数在工作线程中并行执行，第一个参数为工作线程的编号，记录的顺序不确定
+    //回调函数只能修改该编号自己的状态，不能访问缓存页面，不能修改表；不并行时编号为0
+    bool filterTableByWorkers(const TableInfo &tableInfo, const std::vector<Condition> &conditions, const std::function<bool(int, const RID &, const char *)> &callback, const std::vector<std::string> *columns = nullptr);
+    int getScanThreads() const { return _scanThreads; }
+    void setScanThreads(int threads);//设置并行扫描的工作线程数，0表示每个处理器核一个，已有的工作线程在下一次并行扫描时重建
     bool insertData(const std::string &tableName, const std::vector<std::vector<Value>> &value_list);//插入数据
     bool deleteData(const std::string &tableName, const std::vector<Condition> &conditions);//删除数据
     bool updateData(const std::string &tableName, const std::vector<RelAttr> &relAttrs, const std::vector<Value> &values, const std::vector<Condition> &conditions);//更新数据
     bool selectData(const std::vector<std::string> &tableNames, const std::vector<RelAttr> &relAttrs, const std::vector<Condition> &conditions, int limit, int offset);//查询数据
+    //整理表文件，把末尾页面中的记录移到前面页面的空位，改正指向这些记录的索引，再截掉文件末尾的空页面
+    //limit大于0时至多移动limit条记录后停止，并记住寻找空位的位置，下一次带limit的整理从这里继续
+    //limit为0时从头整理到完成，语句执行期间不能执行其它语句
+    bool vacuumTable(const std::string &tableName, int limit = 0);
+    //删除表或切换数据库后丢弃分批整理保留的状态，tableName为空时丢弃所有表的状态
+    void resetVacuum(const std::string &tableName = "");
 };
 
 #endif //QUERY_SYSTEM_H
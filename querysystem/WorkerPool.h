@@ -0,0 +1,86 @@
+#ifndef WORKER_POOL
+#define WORKER_POOL
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/*
+ * WorkerPool
+ * 常驻的工作线程，用于并行扫描数据表
+ * 每次start让所有工作线程各执行一次同一个任务，参数为工作线程的编号，wait等待所有线程执行完
+ * 线程在第一次start时才创建，之后一直等待下一个任务，避免每次扫描都创建线程
+ */
+class WorkerPool {
+public:
+    explicit WorkerPool(int threads) : _size(threads), _round(0), _busy(0), _stop(false) {}
+
+    WorkerPool(const WorkerPool &) = delete;
+
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(_latch);
+            _stop = true;
+        }
+        _wake.notify_all();
+        for (auto &thread : _threads) thread.join();
+    }
+
+    int size() const { return _size; }
+
+    /*
+     * @函数名start
+     * @参数task:每个工作线程执行一次的任务，参数为工作线程的编号
+     * 功能:所有工作线程开始执行task，调用前上一轮任务必须已经wait完成
+     */
+    void start(const std::function<void(int)> &task) {
+        std::lock_guard<std::mutex> lock(_latch);
+        while ((int) _threads.size() < _size) {
+            int worker = (int) _threads.size();
+            _threads.emplace_back([this, worker] { loop(worker); });
+        }
+        _task = task;
+        _busy = _size;
+        _round++;
+        _wake.notify_all();
+    }
+
+    /*
+     * @函数名wait
+     * 功能:等待本轮任务在所有工作线程中执行完
+     */
+    void wait() {
+        std::unique_lock<std::mutex> lock(_latch);
+        _idle.wait(lock, [this] { return _busy == 0; });
+    }
+
+private:
+    int _size;//工作线程数
+    std::vector<std::thread> _threads;
+    std::mutex _latch;//保护以下所有成员
+    std::condition_variable _wake, _idle;//分别通知工作线程有新任务、调用者本轮任务已完成
+    std::function<void(int)> _task;//本轮任务
+    long long _round;//已经开始的任务轮数
+    int _busy;//本轮还没有执行完任务的线程数
+    bool _stop;//析构时通知工作线程退出
+
+    void loop(int worker) {
+        long long done = 0;
+        std::unique_lock<std::mutex> lock(_latch);
+        while (true) {
+            _wake.wait(lock, [&] { return _stop || _round != done; });
+            if (_stop) return;
+            done = _round;
+            lock.unlock();
+            _task(worker);
+            lock.lock();
+            if (--_busy == 0) _idle.notify_all();
+        }
+    }
+};
+
+#endif //WORKER_POOL
@@ -0,0 +1,519 @@
+#include "RecordSystem.h"
+#include "ColumnSegment.h"
+#include "../filesystem/utils/BitKernel.h"
+#include <cstring>
+#include <algorithm>
+
+//列存储文件格式：
+//第0页：| 信息头 | 每列的(偏移,长度) | 每列的类型 | 列存储信息头 |
+//段目录页面：| 下一个段目录页面 | 本页的段数 | 段 | 段 | ... |，依次存放每列的段，最后是有效位图页面
+//段页面格式见ColumnSegment.h，有效位图页面整页都是位图，每行一位，为1表示该行有记录
+//空闲页面用页面的前四个字节链接成链表，链表头在信息头的_firstEmptyPage中
+
+/*
+ * @函数名extendRange
+ * 功能:INT、FLOAT列中用n个值扩展范围[low,high]，empty为true时范围从这些值开始
+ */
+static void extendRange(int type, const char *values, int n, bool empty, double &low, double &high) {
+    if (type != INTEGER && type != FLOAT) return;
+    for (int i = 0; i < n; i++) {
+        double value;
+        if (type == INTEGER) {
+            int v;
+            memcpy(&v, values + (size_t) i * 4, 4);
+            value = v;
+        } else {
+            float v;
+            memcpy(&v, values + (size_t) i * 4, 4);
+            value = v;
+        }
+        if ((empty && i == 0) || value < low) low = value;
+        if ((empty && i == 0) || value > high) high = value;
+    }
+}
+
+ColumnHandle::ColumnHandle(BufPageManager *bufPageManager, int fileID) {
+    _bufPageManager = bufPageManager;
+    _fileID = fileID;
+    _pageSize = _bufPageManager->fileManager->getPageSize(fileID);
+    _rowsPerPage = _pageSize * 8;
+    _directoryChanged = false;
+    _scanRow = 0;
+    _scanEnd = 0;
+    _batchRow = 0;
+    int index;
+    BufType b = _bufPageManager->getPage(_fileID, 0, index);
+    _bufPageManager->access(index);
+    memcpy(&_header, b, sizeof(RecordHeader));
+    int n = _header._fieldNum;
+    _types.resize(n);
+    const char *p = (const char *) b + sizeof(RecordHeader);
+    //每列是两个int：(偏移,长度)
+    std::vector<int> fields(2 * n);
+    memcpy(fields.data(), p, fields.size() * sizeof(int));
+    for (int i = 0; i < n; i++) _columns.emplace_back(fields[2 * i], fields[2 * i + 1]);
+    p += fields.size() * sizeof(int);
+    memcpy(_types.data(), p, n * sizeof(int));
+    p += n * sizeof(int);
+    _fileHeaderOffset = (int) (p - (const char *) b);
+    memcpy(&_file, p, sizeof(FileHeader));
+    _segments.resize(n);
+    _cachedSegment.assign(n, -1);
+    _cache.resize(n);
+    //读入段目录
+    int pageNum = _file._directoryPage;
+    while (pageNum != 0) {
+        _directoryPages.push_back(pageNum);
+        b = _bufPageManager->getPage(_fileID, pageNum, index);
+        _bufPageManager->access(index);
+        int count;
+        memcpy(&count, (const char *) b + sizeof(int), sizeof(int));
+        for (int i = 0; i < count; i++) {
+            Segment segment;
+            memcpy(&segment, (const char *) b + 2 * sizeof(int) + i * sizeof(Segment), sizeof(Segment));
+            if (segment._column == -1) _validPages.push_back(segment._pageNum);
+            else _segments[segment._column].push_back(segment);
+        }
+        memcpy(&pageNum, b, sizeof(int));
+    }
+}
+
+ColumnHandle::~ColumnHandle() {
+    flushUpdates();
+    if (_directoryChanged) writeDirectory();
+}
+
+int ColumnHandle::columnOf(int offset) const {
+    for (int i = 0; i < (int) _columns.size(); i++) {
+        if (_columns[i].first == offset) return i;
+    }
+    return -1;
+}
+
+int ColumnHandle::findSegment(int column, int row) const {
+    const auto &segments = _segments[column];
+    //顺序访问时多半还在最近解码的段中
+    int cached = _cachedSegment[column];
+    if (cached != -1 && segments[cached]._firstRow <= row && row < segments[cached]._firstRow + segments[cached]._rowCount) return cached;
+    auto it = std::upper_bound(segments.begin(), segments.end(), row, [](int r, const Segment &segment) { return r < segment._firstRow; });
+    return (int) (it - segments.begin()) - 1;
+}
+
+const char *ColumnHandle::segmentValues(int column, int segment) {
+    auto it = _updated.find({column, segment});
+    if (it != _updated.end()) return it->second.data();
+    if (_cachedSegment[column] != segment) {
+        const Segment &s = _segments[column][segment];
+        int width = _columns[column].second;
+        int index;
+        //并行扫描时其它线程可能换出页面，解码期间固定页面
+        BufType b = _bufPageManager->getScanPage(_fileID, s._pageNum, index, true);
+        _cache[column].resize((size_t) std::max(s._rowCount, ColumnSegment::header(b)->_rowCount) * width);
+        ColumnSegment::decode(b, _cache[column].data(), width, varlen(column));
+        if (index != -1) _bufPageManager->unpin(index);
+        _cachedSegment[column] = segment;
+    }
+    return _cache[column].data();
+}
+
+bool ColumnHandle::isValid(int row) {
+    if (row < 0 || row >= _file._rowCount) return false;
+    int index;
+    BufType b = _bufPageManager->getPage(_fileID, _validPages[row / _rowsPerPage], index);
+    _bufPageManager->access(index);
+    int bit = row % _rowsPerPage;
+    return (b[bit >> 5] >> (bit & 31)) & 1;
+}
+
+int ColumnHandle::nextValid(int row) {
+    while (row < _file._rowCount) {
+        int start = row / _rowsPerPage * _rowsPerPage;
+        int n = std::min(_rowsPerPage, _file._rowCount - start);
+        int index;
+        BufType b = _bufPageManager->getScanPage(_fileID, _validPages[row / _rowsPerPage], index);
+        int bit = BitKernel::findNextSet(b, row - start, n);
+        if (bit < n) return start + bit;
+        row = start + _rowsPerPage;
+    }
+    return _file._rowCount;
+}
+
+int ColumnHandle::allocPage() {
+    int pageNum;
+    if (_header._firstEmptyPage != 0) {
+        pageNum = _header._firstEmptyPage;
+        int index;
+        BufType b = _bufPageManager->getPage(_fileID, pageNum, index);
+        memcpy(&_header._firstEmptyPage, b, sizeof(int));
+    } else pageNum = ++_header._pageNumber;
+    _directoryChanged = true;
+    return pageNum;
+}
+
+void ColumnHandle::freePage(int pageNum) {
+    int index;
+    BufType b = _bufPageManager->getPage(_fileID, pageNum, index);
+    memcpy(b, &_header._firstEmptyPage, sizeof(int));
+    _bufPageManager->markDirty(index);
+    _header._firstEmptyPage = pageNum;
+    _directoryChanged = true;
+}
+
+void ColumnHandle::writeSegments(int column, int first, int last, int firstRow, const char *values, int n, bool tail) {
+    int width = _columns[column].second;
+    bool var = varlen(column);
+    int capacity = _pageSize - ColumnSegment::HEADER_SIZE;
+    int limit = ColumnSegment::maxRows(width);
+    std::vector<int> pages;
+    for (int i = first; i < last; i++) pages.push_back(_segments[column][i]._pageNum);
+    std::vector<Segment> written;
+    int pos = 0, used = 0;
+    //将从pos开始的count个值用encoding编码写入一个页面，优先使用原来的页面
+    auto emit = [&](int count, int encoding) {
+        int pageNum = used < (int) pages.size() ? pages[used++] : allocPage();
+        int index;
+        BufType b = _bufPageManager->getPage(_fileID, pageNum, index);
+        const char *start = values + (size_t) pos * width;
+        int size = ColumnSegment::encode(encoding, start, count, width, var, ColumnSegment::payload(b));
+        *ColumnSegment::header(b) = {encoding, count, size};
+        _bufPageManager->markDirty(index);
+        Segment segment{column, firstRow + pos, count, pageNum, encoding, 0, 0};
+        extendRange(_types[column], start, count, true, segment._min, segment._max);
+        written.push_back(segment);
+        pos += count;
+    };
+    while (pos < n) {
+        //逐个加入值，直到最短的编码也放不下
+        ColumnSegment::Sizer sizer(width, var, _types[column] == INTEGER);
+        int encoding = ColumnSegment::PLAIN, count = 0;
+        while (pos + count < n && count < limit) {
+            int next;
+            sizer.add(values + (size_t) (pos + count) * width);
+            if (sizer.best(next) > capacity) break;
+            encoding = next;
+            count++;
+        }
+        if (pos + count < n || !tail) {
+            emit(count, encoding);
+            continue;
+        }
+        //末尾放不满一页的值不压缩，之后可以直接追加
+        while (pos < n) {
+            int size = 0;
+            count = 0;
+            while (pos + count < n && count < limit) {
+                int valueSize = ColumnSegment::valueSize(values + (size_t) (pos + count) * width, width, var);
+                if (size + valueSize > capacity) break;
+                size += valueSize;
+                count++;
+            }
+            emit(count, ColumnSegment::TAIL);
+        }
+    }
+    for (int i = used; i < (int) pages.size(); i++) freePage(pages[i]);
+    auto &segments = _segments[column];
+    segments.erase(segments.begin() + first, segments.begin() + last);
+    segments.insert(segments.begin() + first, written.begin(), written.end());
+    _cachedSegment[column] = -1;
+    _directoryChanged = true;
+}
+
+void ColumnHandle::appendColumn(int column, const char *values, int n) {
+    auto &segments = _segments[column];
+    int width = _columns[column].second;
+    bool var = varlen(column);
+    //末尾的TAIL段放得下时直接追加
+    if (!segments.empty() && segments.back()._encoding == ColumnSegment::TAIL) {
+        Segment &last = segments.back();
+        int size = 0;
+        for (int i = 0; i < n; i++) size += ColumnSegment::valueSize(values + (size_t) i * width, width, var);
+        int index;
+        BufType b = _bufPageManager->getPage(_fileID, last._pageNum, index);
+        ColumnSegment::Header *h = ColumnSegment::header(b);
+        if (h->_size + size <= _pageSize - ColumnSegment::HEADER_SIZE && last._rowCount + n <= ColumnSegment::maxRows(width)) {
+            char *p = ColumnSegment::payload(b) + h->_size;
+            for (int i = 0; i < n; i++) p = ColumnSegment::putValue(p, values + (size_t) i * width, width, var);
+            h->_size += size;
+            h->_rowCount += n;
+            _bufPageManager->markDirty(index);
+            extendRange(_types[column], values, n, false, last._min, last._max);
+            last._rowCount += n;
+            if (_cachedSegment[column] == (int) segments.size() - 1) _cachedSegment[column] = -1;
+            _directoryChanged = true;
+            return;
+        }
+    }
+    //否则末尾连续的TAIL段和新值一起重新编码
+    int first = (int) segments.size();
+    while (first > 0 && segments[first - 1]._encoding == ColumnSegment::TAIL) first--;
+    int firstRow = first < (int) segments.size() ? segments[first]._firstRow : _file._rowCount;
+    std::vector<char> merged;
+    for (int i = first; i < (int) segments.size(); i++) {
+        size_t offset = merged.size();
+        int index;
+        BufType b = _bufPageManager->getPage(_fileID, segments[i]._pageNum, index);
+        merged.resize(offset + (size_t) ColumnSegment::header(b)->_rowCount * width);
+        ColumnSegment::decode(b, merged.data() + offset, width, var);
+    }
+    merged.insert(merged.end(), values, values + (size_t) n * width);
+    writeSegments(column, first, (int) segments.size(), firstRow, merged.data(), (int) (merged.size() / width), true);
+}
+
+void ColumnHandle::flushUpdates() {
+    //同一列中段号从大到小写回，拆分后面的段不影响前面的段号
+    for (auto it = _updated.rbegin(); it != _updated.rend(); ++it) {
+        int column = it->first.first, segment = it->first.second;
+        Segment s = _segments[column][segment];
+        writeSegments(column, segment, segment + 1, s._firstRow, it->second.data(), s._rowCount, s._encoding == ColumnSegment::TAIL);
+    }
+    _updated.clear();
+}
+
+void ColumnHandle::writeDirectory() {
+    std::vector<Segment> entries;
+    for (const auto &segments : _segments) entries.insert(entries.end(), segments.begin(), segments.end());
+    for (int i = 0; i < (int) _validPages.size(); i++) entries.push_back({-1, i * _rowsPerPage, 0, _validPages[i], 0, 0, 0});
+    int perPage = (int) ((_pageSize - 2 * sizeof(int)) / sizeof(Segment));
+    int pages = ((int) entries.size() + perPage - 1) / perPage;
+    while ((int) _directoryPages.size() < pages) _directoryPages.push_back(allocPage());
+    while ((int) _directoryPages.size() > pages) {
+        freePage(_directoryPages.back());
+        _directoryPages.pop_back();
+    }
+    int index;
+    for (int i = 0; i < pages; i++) {
+        BufType b = _bufPageManager->getPage(_fileID, _directoryPages[i], index);
+        int next = i + 1 < pages ? _directoryPages[i + 1] : 0;
+        int count = std::min(perPage, (int) entries.size() - i * perPage);
+        memcpy(b, &next, sizeof(int));
+        memcpy((char *) b + sizeof(int), &count, sizeof(int));
+        memcpy((char *) b + 2 * sizeof(int), entries.data() + i * perPage, count * sizeof(Segment));
+        _bufPageManager->markDirty(index);
+    }
+    _file._directoryPage = pages > 0 ? _directoryPages[0] : 0;
+    BufType b = _bufPageManager->getPage(_fileID, 0, index);
+    memcpy(b, &_header, sizeof(RecordHeader));
+    memcpy((char *) b + _fileHeaderOffset, &_file, sizeof(FileHeader));
+    _bufPageManager->markDirty(index);
+    _directoryChanged = false;
+}
+
+bool ColumnHandle::getRecord(const RID &rid, BufType data) {
+    int row = rowOf(rid);
+    if (row < 0 || row >= _file._rowCount) return false;
+    for (int i = 0; i < (int) _columns.size(); i++) {
+        int segment = findSegment(i, row);
+        const char *values = segmentValues(i, segment);
+        int width = _columns[i].second;
+        memcpy((char *) data + _columns[i].first, values + (size_t) (row - _segments[i][segment]._firstRow) * width, width);
+    }
+    return true;
+}
+
+bool ColumnHandle::insertRecords(const char *rows, int n, RID *rids) {
+    if (n <= 0) return true;
+    flushUpdates();
+    std::vector<char> values;
+    for (int i = 0; i < (int) _columns.size(); i++) {
+        int offset = _columns[i].first, width = _columns[i].second;
+        values.resize((size_t) n * width);
+        for (int j = 0; j < n; j++) memcpy(values.data() + (size_t) j * width, rows + (size_t) j * _header._recordSize + offset, width);
+        appendColumn(i, values.data(), n);
+    }
+    //在有效位图中标记新行，逐个有效位图页面处理
+    int row = _file._rowCount, end = row + n;
+    while (row < end) {
+        int page = row / _rowsPerPage;
+        int index;
+        BufType b;
+        if (page == (int) _validPages.size()) {
+            _validPages.push_back(allocPage());
+            b = _bufPageManager->getPage(_fileID, _validPages[page], index);
+            memset(b, 0, _pageSize);
+        } else b = _bufPageManager->getPage(_fileID, _validPages[page], index);
+        int stop = std::min(end, (page + 1) * _rowsPerPage);
+        for (; row < stop; row++) {
+            int bit = row % _rowsPerPage;
+            b[bit >> 5] |= 1u << (bit & 31);
+            rids[row - _file._rowCount] = ridOf(row);
+        }
+        _bufPageManager->markDirty(index);
+    }
+    _file._rowCount = end;
+    _header._rowCount += n;
+    writeDirectory();
+    return true;
+}
+
+bool ColumnHandle::deleteRecord(const RID &rid) {
+    if (rid.getPageNum() <= 0 || rid.getSlotNum() < 0 || rid.getSlotNum() >= _rowsPerPage) return false;
+    int row = rowOf(rid);
+    if (row >= _file._rowCount) return false;
+    int index;
+    BufType b = _bufPageManager->getPage(_fileID, _validPages[row / _rowsPerPage], index);
+    _bufPageManager->access(index);
+    int bit = row % _rowsPerPage;
+    if (!(b[bit >> 5] & (1u << (bit & 31)))) return false;
+    b[bit >> 5] &= ~(1u << (bit & 31));
+    _bufPageManager->markDirty(index);
+    //记录总数写回信息头，不需要重写段目录
+    _header._rowCount--;
+    b = _bufPageManager->getPage(_fileID, 0, index);
+    memcpy(b, &_header, sizeof(RecordHeader));
+    _bufPageManager->markDirty(index);
+    return true;
+}
+
+bool ColumnHandle::updateRecord(const RID &rid, BufType data) {
+    if (rid.getPageNum() <= 0 || rid.getSlotNum() < 0 || rid.getSlotNum() >= _rowsPerPage) return false;
+    int row = rowOf(rid);
+    if (!isValid(row)) return false;
+    //只有值改变的列才修改对应的段
+    for (int i = 0; i < (int) _columns.size(); i++) {
+        int segment = findSegment(i, row);
+        const Segment &s = _segments[i][segment];
+        int width = _columns[i].second;
+        const char *newValue = (const char *) data + _columns[i].first;
+        const char *values = segmentValues(i, segment);
+        size_t offset = (size_t) (row - s._firstRow) * width;
+        if (memcmp(values + offset, newValue, width) == 0) continue;
+        auto it = _updated.find({i, segment});
+        if (it == _updated.end()) it = _updated.emplace(std::make_pair(i, segment), std::vector<char>(values, values + (size_t) s._rowCount * width)).first;
+        memcpy(it->second.data() + offset, newValue, width);
+    }
+    return true;
+}
+
+bool ColumnHandle::openScan() {
+    _scanRow = nextValid(0);
+    return _scanRow < _file._rowCount;
+}
+
+bool ColumnHandle::getNextRecord(RID &rid, BufType data) {
+    if (_scanRow >= _file._rowCount) return false;
+    rid = ridOf(_scanRow);
+    getRecord(rid, data);
+    _scanRow = nextValid(_scanRow + 1);
+    return true;
+}
+
+bool ColumnHandle::openPageScan() {
+    std::vector<int> offsets;
+    for (const auto &column : _columns) offsets.push_back(column.first);
+    openBatchScan(offsets, {});
+    return _file._rowCount > 0;
+}
+
+bool ColumnHandle::getNextRecords(std::vector<RecordRef> &records, int maxCount) {
+    records.clear();
+    ColumnBatch batch;
+    while (records.empty() && getNextBatch(batch)) {
+        int i = 0;
+        for (; i < batch._rowCount && (int) records.size() < maxCount; i++) {
+            if (batch._valid[i]) records.push_back({ridOf(_batchRow + i), nullptr});
+        }
+        //没有返回的行下次继续
+        if (i < batch._rowCount) _scanRow = _batchRow + i;
+    }
+    if (records.empty()) return false;
+    //逐列拼出记录
+    int recordSize = _header._recordSize;
+    _scanRows.resize(records.size() * recordSize);
+    for (const auto &column : _columns) {
+        ColumnRef ref = getBatchColumn(column.first);
+        for (int i = 0; i < (int) records.size(); i++) {
+            int j = rowOf(records[i]._rid) - _batchRow;
+            memcpy(_scanRows.data() + (size_t) i * recordSize + column.first, ref._data + (size_t) j * ref._length, ref._length);
+        }
+    }
+    for (int i = 0; i < (int) records.size(); i++) records[i]._data = _scanRows.data() + (size_t) i * recordSize;
+    return true;
+}
+
+bool ColumnHandle::openBatchScan(const std::vector<int> &offsets, const std::vector<ColumnBound> &bounds) {
+    //之前的更新写回后段的范围才准确
+    flushUpdates();
+    _scanColumns.clear();
+    for (int offset : offsets) {
+        int column = columnOf(offset);
+        if (column != -1) _scanColumns.push_back(column);
+    }
+    _scanBounds.clear();
+    for (const auto &bound : bounds) {
+        int column = columnOf(bound._offset);
+        if (column != -1 && (_types[column] == INTEGER || _types[column] == FLOAT)) _scanBounds.emplace_back(column, bound);
+    }
+    _scanRow = 0;
+    _scanEnd = _file._rowCount;
+    return true;
+}
+
+bool ColumnHandle::getNextBatch(ColumnBatch &batch) {
+    while (_scanRow < _scanEnd) {
+        int row = _scanRow;
+        //一批不跨过有效位图页面，位置中的页号相同
+        int end = std::min(_scanEnd, (row / _rowsPerPage + 1) * _rowsPerPage);
+        bool skip = false;
+        for (const auto &bound : _scanBounds) {
+            const Segment &s = _segments[bound.first][findSegment(bound.first, row)];
+            end = std::min(end, s._firstRow + s._rowCount);
+            if (s._max < bound.second._low || s._min > bound.second._high) skip = true;
+        }
+        for (int column : _scanColumns) {
+            const Segment &s = _segments[column][findSegment(column, row)];
+            end = std::min(end, s._firstRow + s._rowCount);
+        }
+        _scanRow = end;
+        if (skip) continue;
+        int index;
+        BufType b = _bufPageManager->getScanPage(_fileID, _validPages[row / _rowsPerPage], index, true);
+        _batchValid.resize(end - row);
+        bool any = false;
+        for (int i = 0, bit = row % _rowsPerPage; i < end - row; i++, bit++) {
+            _batchValid[i] = (b[bit >> 5] >> (bit & 31)) & 1;
+            any |= _batchValid[i];
+        }
+        if (index != -1) _bufPageManager->unpin(index);
+        if (!any) continue;
+        _batchRow = row;
+        batch = {ridOf(row), end - row, _batchValid.data()};
+        return true;
+    }
+    return false;
+}
+
+ColumnRef ColumnHandle::getBatchColumn(int offset) {
+    int column = columnOf(offset);
+    if (column == -1) return {nullptr, 0};
+    int segment = findSegment(column, _batchRow);
+    const char *values = segmentValues(column, segment);
+    int width = _columns[column].second;
+    return {values + (size_t) (_batchRow - _segments[column][segment]._firstRow) * width, width};
+}
+
+int ColumnHandle::skipRecords(int count) {
+    //只能从有效位图页面的开头跳过
+    if (_scanRow % _rowsPerPage != 0) return 0;
+    int skipped = 0;
+    while (_scanRow < _file._rowCount) {
+        int n = std::min(_rowsPerPage, _file._rowCount - _scanRow);
+        int index;
+        BufType b = _bufPageManager->getScanPage(_fileID, _validPages[_scanRow / _rowsPerPage], index);
+        int valid = BitKernel::popcount(b, n);
+        if (skipped + valid > count) break;
+        skipped += valid;
+        _scanRow += n;
+    }
+    return skipped;
+}
+
+bool ColumnHandle::getScanUnits(int &units, int &morsel) const {
+    units = _file._rowCount;
+    morsel = _rowsPerPage;
+    return true;
+}
+
+void ColumnHandle::limitScan(int first, int last) {
+    _scanRow = std::max(first, 0);
+    _scanEnd = std::min(last, _file._rowCount);
+}
\ No newline at end of file
@@ -0,0 +1,344 @@
+#ifndef COLUMN_SEGMENT
+#define COLUMN_SEGMENT
+
+#include <cstring>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+/*
+ * ColumnSegment
+ * 列存储表中一列的一段连续行，占一个页面
+ * 页面格式：| 页头 | 编码后的值 |
+ * 每段单独选择编码后最短的一种：
+ *   PLAIN：依次存放每个值
+ *   RLE：依次存放(重复次数,值)，重复次数2字节
+ *   DICTIONARY：字典大小(2字节)、字典中的值、每行在字典中的编号，字典不超过256个值时编号1字节，否则2字节
+ *   FRAME_OF_REFERENCE：只用于INT列，存放最小值(4字节)、位宽(1字节)，每行存放与最小值的差，按位宽紧密排列
+ *   TAIL：与PLAIN相同，是列末尾还可以直接追加的段，追加放不下时与新值一起重新选择编码
+ * VARCHAR的值按实际长度存放，长度为1字节(字段长度不超过255)或2字节，其它值按字段长度存放
+ */
+class ColumnSegment {
+public:
+    enum Encoding {
+        PLAIN,
+        RLE,
+        DICTIONARY,
+        FRAME_OF_REFERENCE,
+        TAIL
+    };
+
+    struct Header {
+        int _encoding;//编码方式
+        int _rowCount;//段中的行数
+        int _size;//编码后的值占用的字节数
+    };
+
+    static constexpr int HEADER_SIZE = sizeof(Header);
+    static constexpr int MAX_ROWS = 65535;//一段最多的行数，RLE的重复次数和字典编号都用2字节表示
+    static constexpr int MAX_DECODED = 1 << 20;//一段解码后最多占用的字节数
+
+    static Header *header(void *b) {
+        return (Header *) b;
+    }
+
+    static char *payload(void *b) {
+        return (char *) b + HEADER_SIZE;
+    }
+
+    /*
+     * 返回:长度为width的值一段最多存放的行数
+     */
+    static int maxRows(int width) {
+        return std::max(1, std::min(MAX_ROWS, MAX_DECODED / width));
+    }
+
+    /*
+     * 返回:值v编码后占用的字节数
+     */
+    static int valueSize(const char *v, int width, bool varlen) {
+        if (!varlen) return width;
+        return (width <= 255 ? 1 : 2) + (int) strnlen(v, width);
+    }
+
+    /*
+     * @函数名putValue
+     * 功能:将值v写入p，返回写入之后的位置
+     */
+    static char *putValue(char *p, const char *v, int width, bool varlen) {
+        if (!varlen) {
+            memcpy(p, v, width);
+            return p + width;
+        }
+        int length = (int) strnlen(v, width);
+        if (width <= 255) *p++ = (char) length;
+        else {
+            uint16_t length16 = (uint16_t) length;
+            memcpy(p, &length16, 2);
+            p += 2;
+        }
+        memcpy(p, v, length);
+        return p + length;
+    }
+
+    /*
+     * @函数名getValue
+     * @参数clear:VARCHAR剩余部分是否清零，v已经清零时不需要
+     * 功能:从p读出一个值写入v，返回读取之后的位置
+     */
+    static const char *getValue(const char *p, char *v, int width, bool varlen, bool clear = true) {
+        if (!varlen) {
+            memcpy(v, p, width);
+            return p + width;
+        }
+        int length;
+        if (width <= 255) length = (unsigned char) *p++;
+        else {
+            uint16_t length16;
+            memcpy(&length16, p, 2);
+            length = length16;
+            p += 2;
+        }
+        //值一般很短，按8字节复制，避免编译器对不定长度的复制生成启动开销很大的rep movs
+        int i = 0;
+        for (; i + 8 <= length; i += 8) memcpy(v + i, p + i, 8);
+        for (; i < length; i++) v[i] = p[i];
+        if (clear) memset(v + length, 0, width - length);
+        return p + length;
+    }
+
+    /*
+     * 返回:表示0到range之间的差需要的位数
+     */
+    static int bitWidth(uint32_t range) {
+        return range == 0 ? 0 : 32 - __builtin_clz(range);
+    }
+
+    /*
+     * Sizer
+     * 逐个加入一段中的值，同时统计每种编码的长度，用于决定一段放多少行以及使用哪种编码
+     */
+    class Sizer {
+    private:
+        int _width;
+        bool _varlen;
+        bool _integer;
+        int _rows = 0;
+        int _plain = 0;
+        int _rle = 0;
+        int _dictionary = 0;//字典中的值占用的字节数
+        const char *_last = nullptr;
+        int _runLength = 0;
+        int _min = 0, _max = 0;
+        std::unordered_set<std::string_view> _values;
+    public:
+        Sizer(int width, bool varlen, bool integer) : _width(width), _varlen(varlen), _integer(integer) {}
+
+        int rows() const { return _rows; }
+
+        void add(const char *v) {
+            int size = valueSize(v, _width, _varlen);
+            std::string_view key(v, _varlen ? size - (_width <= 255 ? 1 : 2) : _width);
+            _plain += size;
+            if (_last == nullptr || _runLength == MAX_ROWS || memcmp(_last, v, _width) != 0) {
+                _rle += 2 + size;
+                _runLength = 0;
+            }
+            _runLength++;
+            _last = v;
+            if (_values.insert(key).second) _dictionary += size;
+            if (_integer) {
+                int value;
+                memcpy(&value, v, 4);
+                if (_rows == 0 || value < _min) _min = value;
+                if (_rows == 0 || value > _max) _max = value;
+            }
+            _rows++;
+        }
+
+        /*
+         * @函数名best
+         * 返回:已加入的值编码后最短的长度，encoding返回对应的编码
+         */
+        int best(int &encoding) const {
+            encoding = PLAIN;
+            int size = _plain;
+            if (_rle < size) {
+                encoding = RLE;
+                size = _rle;
+            }
+            int dictionary = 2 + _dictionary + _rows * (_values.size() <= 256 ? 1 : 2);
+            if (dictionary < size) {
+                encoding = DICTIONARY;
+                size = dictionary;
+            }
+            if (_integer) {
+                int bits = bitWidth((uint32_t) ((int64_t) _max - _min));
+                int packed = 5 + (int) (((int64_t) _rows * bits + 7) / 8);
+                if (packed < size) {
+                    encoding = FRAME_OF_REFERENCE;
+                    size = packed;
+                }
+            }
+            return size;
+        }
+
+        int plainSize() const { return _plain; }
+    };
+
+    /*
+     * @函数名encode
+     * @参数values:n个连续存放的值，每个长度为width
+     * 功能:用encoding编码这些值写入out
+     * 返回:编码后的字节数
+     */
+    static int encode(int encoding, const char *values, int n, int width, bool varlen, char *out) {
+        char *p = out;
+        switch (encoding) {
+            case RLE:
+                for (int i = 0; i < n;) {
+                    int j = i + 1;
+                    while (j < n && j - i < MAX_ROWS && memcmp(values + (size_t) i * width, values + (size_t) j * width, width) == 0) j++;
+                    uint16_t run = (uint16_t) (j - i);
+                    memcpy(p, &run, 2);
+                    p = putValue(p + 2, values + (size_t) i * width, width, varlen);
+                    i = j;
+                }
+                break;
+            case DICTIONARY: {
+                std::unordered_map<std::string_view, int> codes;
+                std::vector<int> rows(n);
+                std::vector<const char *> dictionary;
+                for (int i = 0; i < n; i++) {
+                    const char *v = values + (size_t) i * width;
+                    std::string_view key(v, varlen ? strnlen(v, width) : width);
+                    auto it = codes.emplace(key, (int) dictionary.size()).first;
+                    if (it->second == (int) dictionary.size()) dictionary.push_back(v);
+                    rows[i] = it->second;
+                }
+                uint16_t count = (uint16_t) dictionary.size();
+                memcpy(p, &count, 2);
+                p += 2;
+                for (const char *v : dictionary) p = putValue(p, v, width, varlen);
+                bool wide = dictionary.size() > 256;
+                for (int i = 0; i < n; i++) {
+                    if (wide) {
+                        uint16_t code = (uint16_t) rows[i];
+                        memcpy(p, &code, 2);
+                        p += 2;
+                    } else *p++ = (char) rows[i];
+                }
+                break;
+            }
+            case FRAME_OF_REFERENCE: {
+                int base = 0, top = 0;
+                for (int i = 0; i < n; i++) {
+                    int value;
+                    memcpy(&value, values + (size_t) i * 4, 4);
+                    if (i == 0 || value < base) base = value;
+                    if (i == 0 || value > top) top = value;
+                }
+                int bits = bitWidth((uint32_t) ((int64_t) top - base));
+                memcpy(p, &base, 4);
+                p[4] = (char) bits;
+                p += 5;
+                uint64_t buffer = 0;
+                int used = 0;
+                for (int i = 0; i < n && bits > 0; i++) {
+                    int value;
+                    memcpy(&value, values + (size_t) i * 4, 4);
+                    buffer |= (uint64_t) (uint32_t) ((int64_t) value - base) << used;
+                    used += bits;
+                    while (used >= 8) {
+                        *p++ = (char) buffer;
+                        buffer >>= 8;
+                        used -= 8;
+                    }
+                }
+                if (used > 0) *p++ = (char) buffer;
+                break;
+            }
+            default:
+                for (int i = 0; i < n; i++) p = putValue(p, values + (size_t) i * width, width, varlen);
+                break;
+        }
+        return (int) (p - out);
+    }
+
+    /*
+     * @函数名decode
+     * 功能:将页面b中的段解码为连续存放的值写入values，values至少能放下段中的所有行
+     */
+    static void decode(const void *b, char *values, int width, bool varlen) {
+        const Header *h = (const Header *) b;
+        const char *p = (const char *) b + HEADER_SIZE;
+        int n = h->_rowCount;
+        switch (h->_encoding) {
+            case RLE:
+                for (int i = 0; i < n;) {
+                    uint16_t run;
+                    memcpy(&run, p, 2);
+                    char *v = values + (size_t) i * width;
+                    p = getValue(p + 2, v, width, varlen);
+                    //已经复制好的部分成倍扩展
+                    if (width == 1) memset(v + 1, *v, run - 1);
+                    else {
+                        for (size_t done = 1; done < run;) {
+                            size_t count = std::min(done, (size_t) run - done);
+                            memcpy(v + done * width, v, count * width);
+                            done += count;
+                        }
+                    }
+                    i += run;
+                }
+                break;
+            case DICTIONARY: {
+                uint16_t count;
+                memcpy(&count, p, 2);
+                p += 2;
+                std::vector<char> dictionary((size_t) count * width);
+                for (int i = 0; i < count; i++) p = getValue(p, dictionary.data() + (size_t) i * width, width, varlen);
+                for (int i = 0; i < n; i++) {
+                    int code;
+                    if (count > 256) {
+                        uint16_t code16;
+                        memcpy(&code16, p, 2);
+                        code = code16;
+                        p += 2;
+                    } else code = (unsigned char) *p++;
+                    memcpy(values + (size_t) i * width, dictionary.data() + (size_t) code * width, width);
+                }
+                break;
+            }
+            case FRAME_OF_REFERENCE: {
+                int base;
+                memcpy(&base, p, 4);
+                int bits = (unsigned char) p[4];
+                p += 5;
+                uint64_t buffer = 0, mask = bits == 32 ? 0xffffffffULL : (1ULL << bits) - 1;
+                int used = 0;
+                for (int i = 0; i < n; i++) {
+                    while (used < bits) {
+                        buffer |= (uint64_t) (unsigned char) *p++ << used;
+                        used += 8;
+                    }
+                    int value = (int) (uint32_t) ((int64_t) base + (int64_t) (buffer & mask));
+                    buffer >>= bits;
+                    used -= bits;
+                    memcpy(values + (size_t) i * 4, &value, 4);
+                }
+                break;
+            }
+            default:
+                //整段一次清零，逐个值只复制实际长度
+                if (varlen) memset(values, 0, (size_t) n * width);
+                for (int i = 0; i < n; i++) p = getValue(p, values + (size_t) i * width, width, varlen, false);
+                break;
+        }
+    }
+};
+
+#endif
@@ -1,124 +1,342 @@
 #include "RecordSystem.h"
+#include "SlottedPage.h"
+#include "../filesystem/utils/BitKernel.h"
 #include <cstring>
+#include <algorithm>
+#include <unordered_set>
 
-//页面格式：| bitmap | nextFreePage | records |
+//定长页面格式：| bitmap | nextFreePage | records |
+//PAX页面格式：| bitmap | nextFreePage | column 0 | column 1 | ... |，槽数和位图与定长页面相同
+//变长页面格式见SlottedPage.h，记录编码为：| 定长部分 | 每个VARCHAR的长度和内容 |，长度为1字节(字段长度不超过255)或2字节
 
-int RecordHandle::getFirstZeroBit(BufType b, int size) const {
-    for (int i = 0; i < size; i++) {
-        if (!(b[i >> 5] & (1u << (i & 31)))) return i;
-    }
-    return -1;
+int RecordHandle::getFreeSlots(int pageNum, BufType b) {
+    if (pageNum >= (int) _freeSlots.size()) _freeSlots.resize(pageNum + 1, -1);
+    if (_freeSlots[pageNum] == -1) _freeSlots[pageNum] = _header._recordCount - BitKernel::popcount(b, _header._recordCount);
+    return _freeSlots[pageNum];
 }
 
-void RecordHandle::refreshHeader() const {
+void RecordHandle::refreshHeader() {
     int index;
     BufType b = _bufPageManager->getPage(_fileID, 0, index);
     memcpy(b, &_header, sizeof(RecordHeader));
+    //页面占用摘要只写回修改过的组
+    if (_changedLow < _changedHigh) {
+        memcpy((char *) b + occupancyOffset + _changedLow * sizeof(int), _occupancy.data() + _changedLow, (_changedHigh - _changedLow) * sizeof(int));
+        _changedLow = occupancyGroups;
+        _changedHigh = 0;
+    }
     _bufPageManager->markDirty(index);
-    _bufPageManager->writeBack(index);
+}
+
+void RecordHandle::occupy(int pageNum, int delta) {
+    if (delta == 0) return;
+    _header._rowCount += delta;
+    //页号超出摘要的范围时每组页面数加倍，相邻的两组合并为一组
+    while ((pageNum >> _header._groupShift) >= occupancyGroups) {
+        for (int i = 0; i < occupancyGroups / 2; i++) _occupancy[i] = _occupancy[2 * i] + _occupancy[2 * i + 1];
+        std::fill(_occupancy.begin() + occupancyGroups / 2, _occupancy.end(), 0);
+        _header._groupShift++;
+        _changedLow = 0;
+        _changedHigh = occupancyGroups;
+    }
+    int group = pageNum >> _header._groupShift;
+    _occupancy[group] += delta;
+    _changedLow = std::min(_changedLow, group);
+    _changedHigh = std::max(_changedHigh, group + 1);
+}
+
+void RecordHandle::rebuildOccupancy() {
+    _header._rowCount = 0;
+    _header._groupShift = 0;
+    while ((_header._pageNumber >> _header._groupShift) >= occupancyGroups) _header._groupShift++;
+    _occupancy.assign(occupancyGroups, 0);
+    for (int pageNum = 1; pageNum <= _header._pageNumber; pageNum++) {
+        int count = pageRecords(pageNum);
+        _occupancy[pageNum >> _header._groupShift] += count;
+        _header._rowCount += count;
+    }
+    _header._version = recordHeaderVersion;
+    _changedLow = 0;
+    _changedHigh = occupancyGroups;
+    refreshHeader();
+}
+
+int RecordHandle::nextOccupied(int pageNum) const {
+    int shift = _header._groupShift;
+    for (int group = pageNum >> shift; group < occupancyGroups && pageNum <= _header._pageNumber; group++, pageNum = group << shift) {
+        if (_occupancy[group] != 0) return pageNum;
+    }
+    return _header._pageNumber + 1;
+}
+
+int RecordHandle::pageRecords(int pageNum) {
+    int index;
+    BufType b = _bufPageManager->getScanPage(_fileID, pageNum, index);
+    if (_header._format != SLOTTED_RECORD) return _header._recordCount - getFreeSlots(pageNum, b);
+    const SlottedPage::Slot *slots = SlottedPage::slots(b);
+    int count = 0;
+    for (int slotNum = 0, slotCount = SlottedPage::header(b)->_slotCount; slotNum < slotCount; slotNum++) {
+        if (slots[slotNum]._offset != 0 && !(slots[slotNum]._length & SlottedPage::MOVED)) count++;
+    }
+    return count;
 }
 
 RecordHandle::RecordHandle(BufPageManager *bufPageManager, int fileID) {
     _bufPageManager = bufPageManager;
     _fileID = fileID;
+    _pageSize = _bufPageManager->fileManager->getPageSize(fileID);
+    _scanIndex = -1;
+    _scanPage = nullptr;
+    _vacuum = nullptr;
     int index;
     BufType b = _bufPageManager->getPage(_fileID, 0, index);
     _bufPageManager->access(index);
     memcpy(&_header, b, sizeof(RecordHeader));
+    _scanLast = _header._pageNumber;
+    _occupancy.resize(occupancyGroups);
+    memcpy(_occupancy.data(), (const char *) b + occupancyOffset, occupancyGroups * sizeof(int));
+    _changedLow = occupancyGroups;
+    _changedHigh = 0;
+    if (_header._format == SLOTTED_RECORD) {
+        //第0页中每个字段是两个int：(偏移,长度)
+        std::vector<int> fields(2 * _header._fieldNum);
+        memcpy(fields.data(), (char *) b + sizeof(RecordHeader), fields.size() * sizeof(int));
+        for (int i = 0; i < _header._fieldNum; i++) _varFields.emplace_back(fields[2 * i], fields[2 * i + 1]);
+        //VARCHAR字段之间的部分是定长部分
+        int offset = 0;
+        _maxEncoded = 0;
+        for (const auto &field : _varFields) {
+            if (field.first > offset) _fixedFields.emplace_back(offset, field.first - offset);
+            offset = field.first + field.second;
+            _maxEncoded += (field.second <= 255 ? 1 : 2) + field.second;
+        }
+        if (_header._recordSize > offset) _fixedFields.emplace_back(offset, _header._recordSize - offset);
+        for (const auto &field : _fixedFields) _maxEncoded += field.second;
+        _maxEncoded = std::max(_maxEncoded, (int) SlottedPage::FORWARD_SIZE);
+        _encoded.resize(_maxEncoded);
+    }
+    if (_header._format == PAX_RECORD) {
+        //第0页中每列是两个int：(偏移,长度)
+        std::vector<int> fields(2 * _header._fieldNum);
+        memcpy(fields.data(), (char *) b + sizeof(RecordHeader), fields.size() * sizeof(int));
+        for (int i = 0; i < _header._fieldNum; i++) _columns.emplace_back(fields[2 * i], fields[2 * i + 1]);
+        //每列占用槽数乘以值长度的连续空间
+        int start = _header._bitmapSize + nextPageOffset;
+        for (const auto &column : _columns) {
+            _columnStarts.push_back(start);
+            start += _header._recordCount * column.second;
+        }
+    }
+    //旧的表文件没有记录条数和页面占用摘要，读出的都是0，扫描会跳过所有页面
+    if (_header._version < recordHeaderVersion) rebuildOccupancy();
 }
 
-void RecordHandle::getRecord(const RID &rid, BufType data) {
+void RecordHandle::readRow(BufType b, int slotNum, char *data) const {
+    if (_header._format == PAX_RECORD) {
+        for (int i = 0; i < (int) _columns.size(); i++) {
+            memcpy(data + _columns[i].first, (const char *) b + _columnStarts[i] + slotNum * _columns[i].second, _columns[i].second);
+        }
+    } else {
+        const char *start = (const char *) b + (_header._recordSize * slotNum + _header._bitmapSize + nextPageOffset);
+        memcpy(data, start, _header._recordSize);
+    }
+}
+
+void RecordHandle::writeRow(BufType b, int slotNum, const char *data) const {
+    if (_header._format == PAX_RECORD) {
+        for (int i = 0; i < (int) _columns.size(); i++) {
+            char *start = (char *) b + _columnStarts[i] + slotNum * _columns[i].second;
+            if (data == nullptr) memset(start, 0, _columns[i].second);
+            else memcpy(start, data + _columns[i].first, _columns[i].second);
+        }
+    } else {
+        char *start = (char *) b + (_header._recordSize * slotNum + _header._bitmapSize + nextPageOffset);
+        if (data == nullptr) memset(start, 0, _header._recordSize);
+        else memcpy(start, data, _header._recordSize);
+    }
+}
+
+int RecordHandle::encodeRecord(const char *data, char *out) const {
+    char *p = out;
+    for (const auto &field : _fixedFields) {
+        memcpy(p, data + field.first, field.second);
+        p += field.second;
+    }
+    for (const auto &field : _varFields) {
+        int length = (int) strnlen(data + field.first, field.second);
+        if (field.second <= 255) *p++ = (char) length;
+        else {
+            uint16_t length16 = (uint16_t) length;
+            memcpy(p, &length16, 2);
+            p += 2;
+        }
+        memcpy(p, data + field.first, length);
+        p += length;
+    }
+    return (int) (p - out);
+}
+
+void RecordHandle::decodeRecord(const char *in, char *data) const {
+    for (const auto &field : _fixedFields) {
+        memcpy(data + field.first, in, field.second);
+        in += field.second;
+    }
+    for (const auto &field : _varFields) {
+        int length;
+        if (field.second <= 255) length = (unsigned char) *in++;
+        else {
+            uint16_t length16;
+            memcpy(&length16, in, 2);
+            length = length16;
+            in += 2;
+        }
+        memcpy(data + field.first, in, length);
+        memset(data + field.first + length, 0, field.second - length);
+        in += length;
+    }
+}
+
+bool RecordHandle::getRecord(const RID &rid, BufType data) {
     int index;
     BufType b = _bufPageManager->getPage(_fileID, rid.getPageNum(), index);
+    if (b == nullptr) return false;
     _bufPageManager->access(index);
-    char *start = (char *) b + (_header._recordSize * rid.getSlotNum() + _header._bitmapSize + nextPageOffset);
-    memcpy(data, start, _header._recordSize);
+    if (_header._format == SLOTTED_RECORD) {
+        if (!SlottedPage::valid(b, rid.getSlotNum())) return false;
+        readSlotted(b, rid.getSlotNum(), (char *) data);
+        return true;
+    }
+    readRow(b, rid.getSlotNum(), (char *) data);
+    return true;
 }
 
-bool RecordHandle::insertRecord(BufType data, RID &rid) {
-    if (_bufPageManager == nullptr) return false;
-    int index;
-    BufType b;
-    //检查是否有空闲页
-    if (_header._firstEmptyPage != 0) {
-        b = _bufPageManager->getPage(_fileID, _header._firstEmptyPage, index);
-    } else {
-        //分配新的空闲页
-        _header._pageNumber++;
-        _header._firstEmptyPage = _header._pageNumber;
-        b = _bufPageManager->getPage(_fileID, _header._firstEmptyPage, index);
-        memset(b, 0, PAGE_SIZE);
-        refreshHeader();
+size_t RecordHandle::prefetchRecords(const std::vector<RID> &rids, size_t first) {
+    size_t limit = _bufPageManager->fetchLimit(_fileID);
+    std::unordered_set<int> seen;
+    size_t end = first;
+    for (; end < rids.size(); end++) {
+        if (seen.count(rids[end].getPageNum()) == 0) {
+            if (seen.size() == limit) break;
+            seen.insert(rids[end].getPageNum());
+        }
     }
-    int pageNum = _header._firstEmptyPage;
-    _bufPageManager->access(index);
-    int slotNum = getFirstZeroBit(b, _header._recordCount);
-    rid.setPageNum(pageNum);
-    rid.setSlotNum(slotNum);
-    _bufPageManager->markDirty(index);
-    b[slotNum >> 5] |= (1u << (slotNum & 31));//标记位图
-    char *start = (char *) b + (_header._recordSize * slotNum + _header._bitmapSize + nextPageOffset);
-    memcpy(start, data, _header._recordSize);
-    //如果插入后当前页面已满，需修改页头信息
-    if (getFirstZeroBit(b, _header._recordCount) == -1) {
-        memcpy(&_header._firstEmptyPage, (char *) b + _header._bitmapSize, nextPageOffset);
-        memset((char *) b + _header._bitmapSize, 0, nextPageOffset);
-        refreshHeader();
+    std::vector<int> pages(seen.begin(), seen.end());
+    std::sort(pages.begin(), pages.end());
+    _bufPageManager->fetchPages(_fileID, pages);
+    return end;
+}
+
+bool RecordHandle::insertRecords(const char *rows, int n, RID *rids) {
+    if (_bufPageManager == nullptr) return false;
+    if (_header._format == SLOTTED_RECORD) return insertSlotted(rows, n, rids);
+    int done = 0;
+    while (done < n) {
+        int index;
+        //检查是否有空闲页，没有时分配新的空闲页
+        bool newPage = _header._firstEmptyPage == 0;
+        int pageNum = newPage ? _header._pageNumber + 1 : _header._firstEmptyPage;
+        BufType b = _bufPageManager->pinPage(_fileID, pageNum, index);
+        //缓存中没有可以换出的页面，已经插入的记录保留，写回信息头后返回false
+        if (b == nullptr) {
+            refreshHeader();
+            return false;
+        }
+        if (newPage) {
+            _header._pageNumber = pageNum;
+            _header._firstEmptyPage = pageNum;
+            memset(b, 0, _pageSize);
+            if (_header._pageNumber >= (int) _freeSlots.size()) _freeSlots.resize(_header._pageNumber + 1, -1);
+            _freeSlots[_header._pageNumber] = _header._recordCount;
+        }
+        int freeSlots = getFreeSlots(pageNum, b);
+        int count = std::min(freeSlots, n - done);//本页面插入的记录条数
+        _freeSlots[pageNum] = freeSlots - count;
+        _bufPageManager->markDirty(index);
+        //依次填充页面中的空闲槽
+        int slotNum = -1;
+        for (int i = 0; i < count; i++, done++) {
+            slotNum = BitKernel::findNextZero(b, slotNum + 1, _header._recordCount);
+            rids[done].setPageNum(pageNum);
+            rids[done].setSlotNum(slotNum);
+            b[slotNum >> 5] |= (1u << (slotNum & 31));//标记位图
+            writeRow(b, slotNum, rows + (size_t) done * _header._recordSize);
+        }
+        occupy(pageNum, count);
+        //如果插入后当前页面已满，将它移出空闲页链表
+        if (count == freeSlots) {
+            memcpy(&_header._firstEmptyPage, (char *) b + _header._bitmapSize, nextPageOffset);
+            memset((char *) b + _header._bitmapSize, 0, nextPageOffset);
+        }
+        _bufPageManager->unpin(index);
     }
-    _bufPageManager->writeBack(index);
+    //整批插入只写一次信息头和页面占用摘要
+    refreshHeader();
     return true;
 }
 
 bool RecordHandle::deleteRecord(const RID &rid) {
     if (_bufPageManager == nullptr) return false;
+    if (_header._format == SLOTTED_RECORD) return deleteSlotted(rid);
     if (rid.getPageNum() <= 0 || rid.getPageNum() > _header._pageNumber) return false;
     if (rid.getSlotNum() < 0 || rid.getSlotNum() >= _header._recordCount) return false;
     int index;
     int pageNum = rid.getPageNum();
     int slotNum = rid.getSlotNum();
-    BufType b = _bufPageManager->getPage(_fileID, pageNum, index);
-    _bufPageManager->access(index);
+    BufType b = _bufPageManager->pinPage(_fileID, pageNum, index);
+    if (b == nullptr) return false;
     //位图为1才是有效的删除
     if (b[slotNum >> 5] & (1u << (slotNum & 31))) {
         _bufPageManager->markDirty(index);
-        char *start = (char *) b + (_header._recordSize * slotNum + _header._bitmapSize + nextPageOffset);
-        memset(start, 0, _header._recordSize);
+        writeRow(b, slotNum, nullptr);
         //如果原来页面已满，则需要修改页头
-        if (getFirstZeroBit(b, _header._recordCount) == -1) {
+        if (getFreeSlots(pageNum, b) == 0) {
             memcpy((char *) b + _header._bitmapSize, &_header._firstEmptyPage, nextPageOffset);
             memcpy(&_header._firstEmptyPage, &pageNum, nextPageOffset);
-            refreshHeader();
         }
         b[slotNum >> 5] &= ~(1u << (slotNum & 31));//修改位图
-        _bufPageManager->writeBack(index);
-    } else return false;
+        _freeSlots[pageNum]++;
+        _bufPageManager->unpin(index);
+        occupy(pageNum, -1);
+        refreshHeader();
+    } else {
+        _bufPageManager->unpin(index);
+        return false;
+    }
     return true;
 }
 
 bool RecordHandle::updateRecord(const RID &rid, BufType data) {
     if (_bufPageManager == nullptr) return false;
+    if (_header._format == SLOTTED_RECORD) return updateSlotted(rid, (const char *) data);
     if (rid.getPageNum() <= 0 || rid.getPageNum() > _header._pageNumber) return false;
     if (rid.getSlotNum() < 0 || rid.getSlotNum() >= _header._recordCount) return false;
     int index;
     BufType b = _bufPageManager->getPage(_fileID, rid.getPageNum(), index);
+    if (b == nullptr) return false;
     _bufPageManager->access(index);
     //检查位图是否为1
     if (!(b[rid.getSlotNum() >> 5] & (1u << (rid.getSlotNum() & 31)))) return false;
+    writeRow(b, rid.getSlotNum(), (const char *) data);
+    //修改完成后再标记脏页，后台写回线程不会漏写修改
     _bufPageManager->markDirty(index);
-    char *start = (char *) b + (_header._recordSize * rid.getSlotNum() + _header._bitmapSize + nextPageOffset);
-    memcpy(start, data, _header._recordSize);
-    _bufPageManager->writeBack(index);
     return true;
 }
 
 bool RecordHandle::openScan() {
     int pageNum = 1, slotNum = 0;
+    if (_header._format == SLOTTED_RECORD) {
+        bool found = seekSlotted(pageNum, slotNum);
+        _rid.setPageNum(pageNum);
+        _rid.setSlotNum(slotNum);
+        return found;
+    }
     while (true) {
+        pageNum = nextOccupied(pageNum);//跳过页面占用摘要为0的组
         if (pageNum > _header._pageNumber) return false;//说明没有记录
         int index;
-        BufType b = _bufPageManager->getPage(_fileID, pageNum, index);
-        _bufPageManager->access(index);
-        while (slotNum < _header._recordCount && !(b[slotNum >> 5] & (1u << (slotNum & 31)))) slotNum++;
+        BufType b = _bufPageManager->getScanPage(_fileID, pageNum, index);
+        if (b == nullptr) return false;
+        slotNum = BitKernel::findNextSet(b, slotNum, _header._recordCount);
         if (slotNum == _header._recordCount) {
             //当前页面没有找到记录，在下一页面继续扫描
             slotNum = 0;
@@ -140,24 +358,545 @@ bool RecordHandle::getNextRecord(RID &rid, BufType data) {
     rid.setPageNum(pageNum);
     rid.setSlotNum(slotNum);
     int index;
-    BufType b = _bufPageManager->getPage(_fileID, pageNum, index);
-    _bufPageManager->access(index);
-    char *start = (char *) b + (_header._recordSize * slotNum + _header._bitmapSize + nextPageOffset);
-    memcpy(data, start, _header._recordSize);
+    BufType b = _bufPageManager->getScanPage(_fileID, pageNum, index);
+    if (b == nullptr) return false;
+    if (_header._format == SLOTTED_RECORD) {
+        readSlotted(b, slotNum, (char *) data);
+        slotNum++;
+        seekSlotted(pageNum, slotNum);
+        _rid.setPageNum(pageNum);
+        _rid.setSlotNum(slotNum);
+        return true;
+    }
+    readRow(b, slotNum, (char *) data);
     slotNum++;
     while (true) {
-        while (slotNum < _header._recordCount && !(b[slotNum >> 5] & (1u << (slotNum & 31)))) slotNum++;
+        slotNum = BitKernel::findNextSet(b, slotNum, _header._recordCount);
         if (slotNum == _header._recordCount) {
             slotNum = 0;
-            pageNum++;
-            if (pageNum <= _header._pageNumber) {
-                b = _bufPageManager->getPage(_fileID, pageNum, index);
-                _bufPageManager->access(index);
-            } else break;//扫描完全部记录
+            pageNum = nextOccupied(pageNum + 1);
+            if (pageNum > _header._pageNumber) break;//扫描完全部记录
+            b = _bufPageManager->getScanPage(_fileID, pageNum, index);
+            if (b == nullptr) {
+                //下一页面无法装入缓存，缓存管理器已经报告错误，结束扫描
+                pageNum = _header._pageNumber + 1;
+                break;
+            }
         } else break;//找到下一条记录
     }
     //更新_rid
     _rid.setPageNum(pageNum);
     _rid.setSlotNum(slotNum);
     return true;
+}
+
+bool RecordHandle::openPageScan() {
+    closePageScan();
+    _rid.setPageNum(1);
+    _rid.setSlotNum(0);
+    _scanLast = _header._pageNumber;
+    return _header._pageNumber >= 1;
+}
+
+bool RecordHandle::getNextRecords(std::vector<RecordRef> &records, int maxCount) {
+    closePageScan();
+    records.clear();
+    if (_header._format == SLOTTED_RECORD) return getNextSlotted(records, maxCount);
+    //PAX页面中的记录需要拼出整行，存放在_scanRows中
+    bool pax = _header._format == PAX_RECORD;
+    if (pax) _scanRows.clear();
+    int pageNum = _rid.getPageNum(), slotNum = _rid.getSlotNum();
+    while (pageNum <= _scanLast && records.empty()) {
+        //从页面开头扫描时跳过页面占用摘要为0的组
+        if (slotNum == 0 && (pageNum = nextOccupied(pageNum)) > _scanLast) break;
+        BufType b = _bufPageManager->getScanPage(_fileID, pageNum, _scanIndex, true);
+        if (b == nullptr) break;
+        const char *start = (const char *) b + _header._bitmapSize + nextPageOffset;
+        slotNum = BitKernel::findNextSet(b, slotNum, _header._recordCount);
+        while (slotNum < _header._recordCount && (int) records.size() < maxCount) {
+            if (pax) {
+                _scanRows.resize(_scanRows.size() + _header._recordSize);
+                readRow(b, slotNum, _scanRows.data() + _scanRows.size() - _header._recordSize);
+                records.push_back({RID(pageNum, slotNum), nullptr});
+            } else records.push_back({RID(pageNum, slotNum), start + _header._recordSize * slotNum});
+            slotNum = BitKernel::findNextSet(b, slotNum + 1, _header._recordCount);
+        }
+        //当前页面扫描完毕，下次从下一页面开始
+        if (slotNum == _header._recordCount) {
+            slotNum = 0;
+            pageNum++;
+        }
+        //空页面不需要保持固定
+        if (records.empty()) closePageScan();
+    }
+    if (pax) {
+        for (int i = 0; i < (int) records.size(); i++) records[i]._data = _scanRows.data() + (size_t) i * _header._recordSize;
+    }
+    _rid.setPageNum(pageNum);
+    _rid.setSlotNum(slotNum);
+    return !records.empty();
+}
+
+void RecordHandle::closePageScan() {
+    if (_scanIndex != -1) {
+        _bufPageManager->unpin(_scanIndex);
+        _scanIndex = -1;
+    }
+    _scanPage = nullptr;
+}
+
+bool RecordHandle::getNextPage(int &pageNum) {
+    closePageScan();
+    pageNum = _rid.getPageNum();
+    while ((pageNum = nextOccupied(pageNum)) <= _scanLast) {
+        BufType b = _bufPageManager->getScanPage(_fileID, pageNum, _scanIndex, true);
+        if (b == nullptr) break;
+        if (BitKernel::findNextSet(b, 0, _header._recordCount) < _header._recordCount) {
+            _scanPage = b;
+            _rid.setPageNum(pageNum + 1);
+            return true;
+        }
+        //空页面不需要保持固定
+        closePageScan();
+        pageNum++;
+    }
+    _rid.setPageNum(pageNum);
+    return false;
+}
+
+bool RecordHandle::openBatchScan(const std::vector<int> &offsets, const std::vector<ColumnBound> &bounds) {
+    if (_header._format != PAX_RECORD) return false;
+    openPageScan();
+    return true;
+}
+
+bool RecordHandle::getNextBatch(ColumnBatch &batch) {
+    int pageNum;
+    if (!getNextPage(pageNum)) return false;
+    _batchValid.resize(_header._recordCount);
+    for (int i = 0; i < _header._recordCount; i++) _batchValid[i] = (_scanPage[i >> 5] >> (i & 31)) & 1;
+    batch = {RID(pageNum, 0), _header._recordCount, _batchValid.data()};
+    return true;
+}
+
+ColumnRef RecordHandle::getColumn(int offset) const {
+    for (int i = 0; i < (int) _columns.size(); i++) {
+        if (_columns[i].first == offset) return {(const char *) _scanPage + _columnStarts[i], _columns[i].second};
+    }
+    return {nullptr, 0};
+}
+
+void RecordHandle::readSlotted(BufType b, int slotNum, char *data) {
+    SlottedPage::Slot slot = SlottedPage::slots(b)[slotNum];
+    if (slot._length == 0) {
+        int pageNum, targetSlot;
+        SlottedPage::target(b, slotNum, pageNum, targetSlot);
+        //并行扫描时其它线程可能换出页面，解码期间固定转发到的页面
+        int index;
+        b = _bufPageManager->pinPage(_fileID, pageNum, index);
+        slot = SlottedPage::slots(b)[targetSlot];
+        decodeRecord((const char *) b + slot._offset, data);
+        _bufPageManager->unpin(index);
+        return;
+    }
+    decodeRecord((const char *) b + slot._offset, data);
+}
+
+bool RecordHandle::placeSlotted(const char *record, int length, uint16_t flags, RID &rid) {
+    bool headerChanged = false;
+    while (true) {
+        int index;
+        BufType b;
+        if (_header._firstEmptyPage != 0) {
+            b = _bufPageManager->pinPage(_fileID, _header._firstEmptyPage, index);
+        } else {
+            //分配新的空闲页
+            _header._pageNumber++;
+            _header._firstEmptyPage = _header._pageNumber;
+            b = _bufPageManager->pinPage(_fileID, _header._firstEmptyPage, index);
+            SlottedPage::init(b, _pageSize);
+            SlottedPage::header(b)->_inFreeList = 1;
+            headerChanged = true;
+        }
+        SlottedPage::Header *h = SlottedPage::header(b);
+        if (SlottedPage::fits(b, _pageSize, length)) {
+            rid.setPageNum(_header._firstEmptyPage);
+            rid.setSlotNum(SlottedPage::insert(b, _pageSize, record, length, flags));
+            _bufPageManager->markDirty(index);
+            _bufPageManager->unpin(index);
+            return headerChanged;
+        }
+        //页面放不下这条记录，移出空闲页面链表，删除记录后空间足够时再放回
+        _header._firstEmptyPage = h->_nextFreePage;
+        h->_nextFreePage = 0;
+        h->_inFreeList = 0;
+        _bufPageManager->markDirty(index);
+        _bufPageManager->unpin(index);
+        headerChanged = true;
+    }
+}
+
+bool RecordHandle::releaseSlotted(int pageNum, BufType b) {
+    SlottedPage::Header *h = SlottedPage::header(b);
+    if (h->_inFreeList || SlottedPage::freeBytes(b, _pageSize) < _maxEncoded + SlottedPage::SLOT_SIZE) return false;
+    h->_nextFreePage = _header._firstEmptyPage;
+    h->_inFreeList = 1;
+    _header._firstEmptyPage = pageNum;
+    return true;
+}
+
+bool RecordHandle::eraseSlotted(int pageNum, int slotNum) {
+    int index;
+    BufType b = _bufPageManager->pinPage(_fileID, pageNum, index);
+    SlottedPage::erase(b, slotNum);
+    bool headerChanged = releaseSlotted(pageNum, b);
+    _bufPageManager->markDirty(index);
+    _bufPageManager->unpin(index);
+    return headerChanged;
+}
+
+bool RecordHandle::seekSlotted(int &pageNum, int &slotNum) {
+    while (pageNum <= _header._pageNumber) {
+        if (slotNum == 0 && (pageNum = nextOccupied(pageNum)) > _header._pageNumber) break;
+        int index;
+        BufType b = _bufPageManager->getScanPage(_fileID, pageNum, index);
+        const SlottedPage::Slot *slots = SlottedPage::slots(b);
+        for (int slotCount = SlottedPage::header(b)->_slotCount; slotNum < slotCount; slotNum++) {
+            if (slots[slotNum]._offset != 0 && !(slots[slotNum]._length & SlottedPage::MOVED)) return true;
+        }
+        slotNum = 0;
+        pageNum++;
+    }
+    return false;
+}
+
+bool RecordHandle::insertSlotted(const char *rows, int n, RID *rids) {
+    for (int i = 0; i < n; i++) {
+        int length = encodeRecord(rows + (size_t) i * _header._recordSize, _encoded.data());
+        placeSlotted(_encoded.data(), length, 0, rids[i]);
+        occupy(rids[i].getPageNum(), 1);
+    }
+    //整批插入只写一次信息头和页面占用摘要
+    refreshHeader();
+    return true;
+}
+
+bool RecordHandle::deleteSlotted(const RID &rid) {
+    if (rid.getPageNum() <= 0 || rid.getPageNum() > _header._pageNumber) return false;
+    int index;
+    int pageNum = rid.getPageNum();
+    int slotNum = rid.getSlotNum();
+    BufType b = _bufPageManager->pinPage(_fileID, pageNum, index);
+    if (b == nullptr) return false;
+    //转发来的记录只能通过原来的RID删除
+    if (!SlottedPage::valid(b, slotNum) || (SlottedPage::slots(b)[slotNum]._length & SlottedPage::MOVED)) {
+        _bufPageManager->unpin(index);
+        return false;
+    }
+    if (SlottedPage::slots(b)[slotNum]._length == 0) {
+        int targetPage, targetSlot;
+        SlottedPage::target(b, slotNum, targetPage, targetSlot);
+        eraseSlotted(targetPage, targetSlot);
+    }
+    SlottedPage::erase(b, slotNum);
+    releaseSlotted(pageNum, b);
+    _bufPageManager->markDirty(index);
+    _bufPageManager->unpin(index);
+    //记录总数总是改变，信息头总要写回
+    occupy(pageNum, -1);
+    refreshHeader();
+    return true;
+}
+
+bool RecordHandle::updateSlotted(const RID &rid, const char *data) {
+    if (rid.getPageNum() <= 0 || rid.getPageNum() > _header._pageNumber) return false;
+    int index;
+    int pageNum = rid.getPageNum();
+    int slotNum = rid.getSlotNum();
+    BufType b = _bufPageManager->pinPage(_fileID, pageNum, index);
+    if (b == nullptr) return false;
+    if (!SlottedPage::valid(b, slotNum) || (SlottedPage::slots(b)[slotNum]._length & SlottedPage::MOVED)) {
+        _bufPageManager->unpin(index);
+        return false;
+    }
+    int length = encodeRecord(data, _encoded.data());
+    bool headerChanged = false;
+    bool placed = false;
+    if (SlottedPage::slots(b)[slotNum]._length == 0) {
+        //记录已经转发到其它页面，先尝试在那里原地更新
+        int targetPage, targetSlot, targetIndex;
+        SlottedPage::target(b, slotNum, targetPage, targetSlot);
+        BufType t = _bufPageManager->pinPage(_fileID, targetPage, targetIndex);
+        placed = SlottedPage::resize(t, _pageSize, targetSlot, _encoded.data(), length, SlottedPage::MOVED);
+        if (!placed) SlottedPage::erase(t, targetSlot);
+        headerChanged |= releaseSlotted(targetPage, t);
+        _bufPageManager->markDirty(targetIndex);
+        _bufPageManager->unpin(targetIndex);
+    }
+    //原页面放得下时写在原位置，否则移到其它页面，原位置换成转发槽
+    if (!placed && !SlottedPage::resize(b, _pageSize, slotNum, _encoded.data(), length, 0)) {
+        RID target;
+        headerChanged |= placeSlotted(_encoded.data(), length, SlottedPage::MOVED, target);
+        SlottedPage::forward(b, slotNum, target.getPageNum(), target.getSlotNum());
+    }
+    headerChanged |= releaseSlotted(pageNum, b);
+    //修改完成后再标记脏页，后台写回线程不会漏写修改
+    _bufPageManager->markDirty(index);
+    _bufPageManager->unpin(index);
+    if (headerChanged) refreshHeader();
+    return true;
+}
+
+bool RecordHandle::getNextSlotted(std::vector<RecordRef> &records, int maxCount) {
+    //变长记录需要解码，解码后的记录存放在_scanRows中，页面只在解码时固定
+    int pageNum = _rid.getPageNum(), slotNum = _rid.getSlotNum();
+    while (pageNum <= _scanLast && records.empty()) {
+        if (slotNum == 0 && (pageNum = nextOccupied(pageNum)) > _scanLast) break;
+        BufType b = _bufPageManager->getScanPage(_fileID, pageNum, _scanIndex, true);
+        if (b == nullptr) break;
+        const SlottedPage::Slot *slots = SlottedPage::slots(b);
+        int slotCount = SlottedPage::header(b)->_slotCount;
+        //一次为本页面剩余的槽准备好空间，之后不再逐条扩大
+        size_t need = (size_t) std::max(0, std::min(slotCount - slotNum, maxCount)) * _header._recordSize;
+        if (_scanRows.size() < need) _scanRows.resize(need);
+        for (; slotNum < slotCount && (int) records.size() < maxCount; slotNum++) {
+            if (slots[slotNum]._offset == 0 || (slots[slotNum]._length & SlottedPage::MOVED)) continue;
+            readSlotted(b, slotNum, _scanRows.data() + records.size() * _header._recordSize);
+            records.push_back({RID(pageNum, slotNum), nullptr});
+        }
+        //当前页面扫描完毕，下次从下一页面开始
+        if (slotNum == slotCount) {
+            slotNum = 0;
+            pageNum++;
+        }
+        closePageScan();
+    }
+    for (int i = 0; i < (int) records.size(); i++) records[i]._data = _scanRows.data() + (size_t) i * _header._recordSize;
+    _rid.setPageNum(pageNum);
+    _rid.setSlotNum(slotNum);
+    return !records.empty();
+}
+
+bool RecordHandle::pageEmpty(int pageNum) {
+    int index;
+    BufType b = _bufPageManager->getScanPage(_fileID, pageNum, index);
+    if (_header._format == SLOTTED_RECORD) return SlottedPage::header(b)->_slotCount == 0;
+    return getFreeSlots(pageNum, b) == _header._recordCount;
+}
+
+void RecordHandle::rebuildFreeList() {
+    //从后向前把有空位的页面依次放到链表头部，插入时先填满页号小的页面
+    _header._firstEmptyPage = 0;
+    for (int pageNum = _header._pageNumber; pageNum >= 1; pageNum--) {
+        int index;
+        BufType b = _bufPageManager->getPage(_fileID, pageNum, index);
+        _bufPageManager->access(index);
+        bool free;
+        if (_header._format == SLOTTED_RECORD) {
+            SlottedPage::Header *h = SlottedPage::header(b);
+            free = SlottedPage::freeBytes(b, _pageSize) >= _maxEncoded + SlottedPage::SLOT_SIZE;
+            int next = free ? _header._firstEmptyPage : 0;
+            if (h->_inFreeList != (int) free || h->_nextFreePage != next) {
+                h->_inFreeList = free;
+                h->_nextFreePage = next;
+                _bufPageManager->markDirty(index);
+            }
+        } else {
+            free = getFreeSlots(pageNum, b) > 0;
+            int next = free ? _header._firstEmptyPage : 0, oldNext;
+            memcpy(&oldNext, (char *) b + _header._bitmapSize, nextPageOffset);
+            if (oldNext != next) {
+                memcpy((char *) b + _header._bitmapSize, &next, nextPageOffset);
+                _bufPageManager->markDirty(index);
+            }
+        }
+        if (free) _header._firstEmptyPage = pageNum;
+    }
+}
+
+bool RecordHandle::openVacuum(VacuumState &state) {
+    if (_bufPageManager == nullptr) return false;
+    closePageScan();
+    _vacuum = &state;
+    _vacuumLow = std::max(1, state._cursor);
+    _vacuumHigh = _header._pageNumber;
+    return true;
+}
+
+RID &RecordHandle::forwardHome(int pageNum, int slotNum) {
+    if (!_vacuum->_homesValid) {
+        //移动转发来的记录时要修改原位置的转发槽，第一次遇到时找出所有转发槽，之后的分批整理继续使用
+        _vacuum->_forwardHomes.clear();
+        for (int home = 1; home <= _header._pageNumber; home++) {
+            int index;
+            BufType b = _bufPageManager->getScanPage(_fileID, home, index);
+            const SlottedPage::Slot *slots = SlottedPage::slots(b);
+            for (int slot = 0; slot < SlottedPage::header(b)->_slotCount; slot++) {
+                if (slots[slot]._offset == 0 || slots[slot]._length != 0) continue;
+                int targetPage, targetSlot;
+                SlottedPage::target(b, slot, targetPage, targetSlot);
+                _vacuum->_forwardHomes[{targetPage, targetSlot}] = RID(home, slot);
+            }
+        }
+        _vacuum->_homesValid = true;
+    }
+    return _vacuum->_forwardHomes[{pageNum, slotNum}];
+}
+
+bool RecordHandle::vacuumStep(std::vector<std::pair<RID, RID>> &moves, int maxCount) {
+    moves.clear();
+    if (_header._format == SLOTTED_RECORD) return vacuumSlotted(moves, maxCount);
+    auto freeSlots = [this](int pageNum) {
+        int index;
+        return getFreeSlots(pageNum, _bufPageManager->getScanPage(_fileID, pageNum, index));
+    };
+    std::vector<char> row(_header._recordSize);
+    while ((int) moves.size() < maxCount) {
+        while (_vacuumHigh > _vacuumLow && pageEmpty(_vacuumHigh)) _vacuumHigh--;
+        while (_vacuumLow < _vacuumHigh && freeSlots(_vacuumLow) == 0) _vacuumLow++;
+        if (_vacuumLow >= _vacuumHigh) break;
+        int lowIndex, highIndex;
+        BufType low = _bufPageManager->pinPage(_fileID, _vacuumLow, lowIndex);
+        BufType high = _bufPageManager->pinPage(_fileID, _vacuumHigh, highIndex);
+        int count = std::min({getFreeSlots(_vacuumLow, low), _header._recordCount - getFreeSlots(_vacuumHigh, high), maxCount - (int) moves.size()});
+        //依次把后一页面的记录放入前一页面的空槽
+        int from = -1, to = -1;
+        for (int i = 0; i < count; i++) {
+            from = BitKernel::findNextSet(high, from + 1, _header._recordCount);
+            to = BitKernel::findNextZero(low, to + 1, _header._recordCount);
+            readRow(high, from, row.data());
+            writeRow(low, to, row.data());
+            writeRow(high, from, nullptr);
+            low[to >> 5] |= (1u << (to & 31));
+            high[from >> 5] &= ~(1u << (from & 31));
+            moves.emplace_back(RID(_vacuumHigh, from), RID(_vacuumLow, to));
+        }
+        _freeSlots[_vacuumLow] -= count;
+        _freeSlots[_vacuumHigh] += count;
+        occupy(_vacuumLow, count);
+        occupy(_vacuumHigh, -count);
+        _bufPageManager->markDirty(lowIndex);
+        _bufPageManager->markDirty(highIndex);
+        _bufPageManager->unpin(lowIndex);
+        _bufPageManager->unpin(highIndex);
+    }
+    return !moves.empty();
+}
+
+bool RecordHandle::vacuumSlotted(std::vector<std::pair<RID, RID>> &moves, int maxCount) {
+    while ((int) moves.size() < maxCount) {
+        while (_vacuumHigh > _vacuumLow && pageEmpty(_vacuumHigh)) _vacuumHigh--;
+        if (_vacuumLow >= _vacuumHigh) break;
+        //槽目录末尾的槽总是非空的，从后向前取出记录，删除后槽目录随之缩短
+        int highIndex;
+        BufType high = _bufPageManager->pinPage(_fileID, _vacuumHigh, highIndex);
+        int slotNum = SlottedPage::header(high)->_slotCount - 1;
+        SlottedPage::Slot slot = SlottedPage::slots(high)[slotNum];
+        //转发槽的记录数据在转发到的位置
+        int targetPage = _vacuumHigh, targetSlot = slotNum;
+        if (slot._length == 0) SlottedPage::target(high, slotNum, targetPage, targetSlot);
+        int targetIndex;
+        BufType target = _bufPageManager->pinPage(_fileID, targetPage, targetIndex);
+        SlottedPage::Slot stored = SlottedPage::slots(target)[targetSlot];
+        int length = stored._length & ~SlottedPage::MOVED;
+        memcpy(_encoded.data(), (const char *) target + stored._offset, length);
+        //找到第一个放得下这条记录的页面
+        int lowIndex = -1;
+        BufType low = nullptr;
+        while (_vacuumLow < _vacuumHigh) {
+            low = _bufPageManager->pinPage(_fileID, _vacuumLow, lowIndex);
+            if (SlottedPage::fits(low, _pageSize, length)) break;
+            _bufPageManager->unpin(lowIndex);
+            _vacuumLow++;
+        }
+        if (_vacuumLow < _vacuumHigh) {
+            if (slot._length & SlottedPage::MOVED) {
+                //转发来的记录仍然通过原来的RID访问，只修改原位置的转发槽
+                int newSlot = SlottedPage::insert(low, _pageSize, _encoded.data(), length, SlottedPage::MOVED);
+                RID home = forwardHome(_vacuumHigh, slotNum);
+                int homeIndex;
+                BufType b = _bufPageManager->pinPage(_fileID, home.getPageNum(), homeIndex);
+                SlottedPage::forward(b, home.getSlotNum(), _vacuumLow, newSlot);
+                _bufPageManager->markDirty(homeIndex);
+                _bufPageManager->unpin(homeIndex);
+                _vacuum->_forwardHomes[{_vacuumLow, newSlot}] = home;
+                _vacuum->_forwardHomes.erase({_vacuumHigh, slotNum});
+            } else {
+                int newSlot = SlottedPage::insert(low, _pageSize, _encoded.data(), length, 0);
+                if (slot._length == 0) {
+                    SlottedPage::erase(target, targetSlot);
+                    _vacuum->_forwardHomes.erase({targetPage, targetSlot});
+                }
+                moves.emplace_back(RID(_vacuumHigh, slotNum), RID(_vacuumLow, newSlot));
+                occupy(_vacuumLow, 1);
+                occupy(_vacuumHigh, -1);
+            }
+            SlottedPage::erase(high, slotNum);
+            _bufPageManager->markDirty(lowIndex);
+            _bufPageManager->markDirty(targetIndex);
+            _bufPageManager->markDirty(highIndex);
+            _bufPageManager->unpin(lowIndex);
+        }
+        _bufPageManager->unpin(targetIndex);
+        _bufPageManager->unpin(highIndex);
+    }
+    return !moves.empty();
+}
+
+int RecordHandle::closeVacuum() {
+    int pageNumber = _header._pageNumber;
+    while (_header._pageNumber > 0 && pageEmpty(_header._pageNumber)) _header._pageNumber--;
+    rebuildFreeList();
+    refreshHeader();
+    if ((int) _freeSlots.size() > _header._pageNumber + 1) _freeSlots.resize(_header._pageNumber + 1);
+    _vacuum->_cursor = _vacuumLow;
+    _vacuum = nullptr;
+    _bufPageManager->truncateFile(_fileID, _header._pageNumber + 1);
+    return pageNumber - _header._pageNumber;
+}
+
+bool RecordHandle::getOccupancy(std::vector<int> &groups, int &groupPages) const {
+    groups = _occupancy;
+    groupPages = 1 << _header._groupShift;
+    return true;
+}
+
+int RecordHandle::skipRecords(int count) {
+    //只能从页面开头跳过
+    if (_rid.getSlotNum() != 0) return 0;
+    int pageNum = _rid.getPageNum(), skipped = 0;
+    int shift = _header._groupShift;
+    while (pageNum <= _header._pageNumber) {
+        int group = pageNum >> shift;
+        //摘要范围之外的页面都没有记录
+        if (group >= occupancyGroups) {
+            pageNum = _header._pageNumber + 1;
+            break;
+        }
+        //位于组的开头时整组跳过，第0组从第1页开始
+        if (pageNum == std::max(1, group << shift) && skipped + _occupancy[group] <= count) {
+            skipped += _occupancy[group];
+            pageNum = (group + 1) << shift;
+            continue;
+        }
+        int n = pageRecords(pageNum);
+        if (skipped + n > count) break;
+        skipped += n;
+        pageNum++;
+    }
+    _rid.setPageNum(pageNum);
+    return skipped;
+}
+
+bool RecordHandle::getScanUnits(int &units, int &morsel) const {
+    units = _header._pageNumber + 1;
+    morsel = std::max(1, morselBytes / _pageSize);
+    return true;
+}
+
+void RecordHandle::limitScan(int first, int last) {
+    closePageScan();
+    _rid.setPageNum(std::max(first, 1));
+    _rid.setSlotNum(0);
+    _scanLast = std::min(last - 1, _header._pageNumber);
 }
\ No newline at end of file
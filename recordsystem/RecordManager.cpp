@@ -1,4 +1,5 @@
 #include "RecordSystem.h"
+#include "SlottedPage.h"
 #include <cmath>
 #include <cstring>
 
@@ -7,10 +8,9 @@ RecordManager::RecordManager(BufPageManager *bufPageManager, FileManager *fileMa
     _fileManager = fileManager;
 }
 
-bool RecordManager::createFile(const char *fileName, int recordSize) {
-    if (recordSize > PAGE_SIZE / 2) return false;
-    if (!_fileManager->createFile(fileName)) return false;
-    int availableSize = PAGE_SIZE - nextPageOffset;//所有的可用空间8188B
+bool RecordManager::createFile(const char *fileName, int recordSize, int pageSize, RecordFormat format, const std::vector<std::pair<int, int>> &fields, const std::vector<AttrType> &types) {
+    if (recordSize > pageSize / 2) return false;
+    int availableSize = pageSize - nextPageOffset;//所有的可用空间，8KB页面为8188B
     int recordCount = availableSize * 8 / (1 + recordSize * 8);
     int bitmapSize = ceil(recordCount / 8.0);
     while (bitmapSize + recordCount * recordSize + recordSize <= availableSize) recordCount++;
@@ -19,22 +19,60 @@ bool RecordManager::createFile(const char *fileName, int recordSize) {
         ._recordCount = recordCount,
         ._bitmapSize = bitmapSize,
         ._firstEmptyPage = 0,
-        ._pageNumber = 0
+        ._pageNumber = 0,
+        ._format = FIXED_RECORD,
+        ._fieldNum = 0,
+        ._rowCount = 0,
+        ._groupShift = 0,
+        ._version = recordHeaderVersion
     };
+    //字段的(偏移,长度)需要放在第0页的页面大小之前
+    int fieldsSize = (int) (fields.size() * sizeof(std::pair<int, int>));
+    bool fieldsFit = !fields.empty() && sizeof(RecordHeader) + fieldsSize <= PAGE_SIZE_OFFSET;
+    //行存储表的页面占用摘要在第0页中紧挨页面大小之前，字段不能与它重叠
+    bool rowFieldsFit = fieldsFit && sizeof(RecordHeader) + fieldsSize <= occupancyOffset;
+    //变长记录编码后每个VARCHAR字段最多多出两个字节的长度
+    if (format == SLOTTED_RECORD && rowFieldsFit && recordSize + 2 * (int) fields.size() <= SlottedPage::MAX_RECORD_LENGTH) {
+        header._recordCount = 0;
+        header._bitmapSize = 0;
+        header._format = SLOTTED_RECORD;
+        header._fieldNum = (int) fields.size();
+    }
+    //PAX页面的槽数和位图与定长页面相同，记录按列分成多段存放
+    if (format == PAX_RECORD && rowFieldsFit) {
+        header._format = PAX_RECORD;
+        header._fieldNum = (int) fields.size();
+    }
+    //列存储在字段之后存放每列的类型和列存储的信息头，信息头在创建时全为0
+    std::vector<int> columnTypes;
+    if (format == COLUMN_RECORD && fieldsFit && types.size() + 1 == fields.size()) {
+        columnTypes.push_back(-1);
+        for (const auto &type : types) columnTypes.push_back(type);
+        if (sizeof(RecordHeader) + fieldsSize + columnTypes.size() * sizeof(int) + 2 * sizeof(int) <= PAGE_SIZE_OFFSET) {
+            header._recordCount = 0;
+            header._bitmapSize = 0;
+            header._format = COLUMN_RECORD;
+            header._fieldNum = (int) fields.size();
+        }
+    }
+    //PAX和列存储无法存放字段时不建立文件，由调用者报告，不退回定长页面
+    if ((format == PAX_RECORD || format == COLUMN_RECORD) && header._format != format) return false;
+    if (!_fileManager->createFile(fileName, pageSize)) return false;
     int index, fileID;
     if (!_fileManager->openFile(fileName, fileID)) return false;
+    //第0页在创建文件时已经清零，并记录了页面大小
     BufType b = _bufPageManager->getPage(fileID, 0, index);
-    memset(b, 0, PAGE_SIZE);
     memcpy(b, &header, sizeof(RecordHeader));
+    if (header._format != FIXED_RECORD) memcpy((char *) b + sizeof(RecordHeader), fields.data(), fieldsSize);
+    if (header._format == COLUMN_RECORD) memcpy((char *) b + sizeof(RecordHeader) + fieldsSize, columnTypes.data(), columnTypes.size() * sizeof(int));
     _bufPageManager->markDirty(index);
     _bufPageManager->writeBack(index);
-    return (!_fileManager->closeFile(fileID));
+    return closeFile(fileID);
 }
 
 bool RecordManager::destroyFile(const char *fileName) {
-    //将缓存全部写回，删除文件
-    _bufPageManager->close();
-    return (!remove(fileName));
+    //文件仍在打开文件的缓存中时，先关闭并丢弃其缓存页面，再删除文件
+    return _fileManager->removeFile(fileName);
 }
 
 bool RecordManager::openFile(const char *fileName, int &fileID) {
@@ -42,7 +80,15 @@ bool RecordManager::openFile(const char *fileName, int &fileID) {
 }
 
 bool RecordManager::closeFile(int fileID) {
-    //将缓存全部写回，关闭文件
-    _bufPageManager->close();
+    //文件放入打开文件的缓存，缓存页面在文件真正关闭时才写回并归还
     return (!_fileManager->closeFile(fileID));
+}
+
+std::unique_ptr<TableHandle> RecordManager::openTable(int fileID) {
+    int index;
+    RecordHeader header;
+    BufType b = _bufPageManager->getPage(fileID, 0, index);
+    memcpy(&header, b, sizeof(RecordHeader));
+    if (header._format == COLUMN_RECORD) return std::unique_ptr<TableHandle>(new ColumnHandle(_bufPageManager, fileID));
+    return std::unique_ptr<TableHandle>(new RecordHandle(_bufPageManager, fileID));
 }
\ No newline at end of file
@@ -2,6 +2,10 @@
 #define RECORD_MANAGE_H
 
 #include "../filesystem/FileSystem.h"
+#include <vector>
+#include <utility>
+#include <map>
+#include <memory>
 
 enum AttrType {
     INTEGER,
@@ -33,27 +37,283 @@ struct RecordHeader {
     int _bitmapSize;//一个页面的位图所占空间，单位：字节
     int _firstEmptyPage;//第一个空闲页面，等于0说明没有空闲页面，要分配新的页面
     int _pageNumber;//目前分配的页面总数
+    int _format;//页面格式，见RecordFormat
+    int _fieldNum;//变长页面中VARCHAR字段的个数或PAX、列存储表中列的个数，字段的(偏移,长度)紧跟在信息头之后
+    int _rowCount;//表中现有的记录条数，随插入和删除维护
+    int _groupShift;//页面占用摘要中每组页面数以2为底的指数，页面超出摘要范围时每组页面数加倍
+    int _version;//信息头版本，早于recordHeaderVersion的表文件没有维护记录条数和页面占用摘要
+};
+
+//信息头中记录条数和页面占用摘要有效的版本，更早的表文件中这些位置为0，打开时由页面重建
+const int recordHeaderVersion = 1;
+
+enum RecordFormat {
+    FIXED_RECORD,//定长页面：| bitmap | nextFreePage | records |
+    SLOTTED_RECORD,//变长页面，VARCHAR按实际长度存储，格式见SlottedPage.h
+    PAX_RECORD,//PAX页面：| bitmap | nextFreePage | column 0 | column 1 | ... |，每列连续存放页面中所有槽的值
+    COLUMN_RECORD//列存储：每列分段压缩存放在各自的页面中，由ColumnHandle管理，格式见ColumnHandle.cpp
+};
+
+struct ColumnRef {
+    const char *_data;//批量扫描中一列的起始位置，第i行的值在_data + i * _length
+    int _length;//一个值的长度，单位：字节
+};
+
+struct ColumnBound {
+    int _offset;//列在记录中的偏移
+    double _low, _high;//符合条件的值所在的范围，列存储表批量扫描时跳过最小值和最大值都在范围之外的段
+};
+
+struct ColumnBatch {
+    RID _first;//第一行的位置，第i行的位置为(_first的页号, _first的槽号 + i)
+    int _rowCount;//批中的行数
+    const char *_valid;//每行一个字节，为1表示该行有记录
 };
 
 const int nextPageOffset = sizeof(int);//每个页面用四个字节记录下一个空闲页面
+//行存储表的页面占用摘要：第0页中紧挨页面大小之前的occupancyGroups个int，第i个为页号在[i << _groupShift, (i + 1) << _groupShift)的页面中的记录条数
+//变长页面中转发来的记录不计数，只在原位置计数，摘要为0的组中没有扫描需要访问的记录
+const int occupancyGroups = 256;
+const int occupancyOffset = PAGE_SIZE_OFFSET - occupancyGroups * (int) sizeof(int);
+const int morselBytes = 256 * 1024;//并行扫描时行存储表每次分给一个工作线程的页面总大小
+
+struct RecordRef {
+    RID _rid;//记录位置
+    const char *_data;//记录数据，直接指向页面，只能读取
+};
+
+/*
+ * VacuumState
+ * 分批整理之间保留的状态，由调用者在两次整理之间保存
+ * _cursor之前的页面在上次整理停止时已经没有空位，下一次从这一页开始寻找空位
+ * _forwardHomes为变长页面中转发到的位置对应的原位置，整理第一次遇到转发来的记录时才逐页建立，之后随记录移动更新
+ * 删除或更新记录会改变转发关系，调用者这时把_homesValid置为false
+ */
+struct VacuumState {
+    int _cursor = 1;
+    bool _homesValid = false;
+    std::map<std::pair<int, int>, RID> _forwardHomes;
+};
 
-class RecordHandle {
+/*
+ * TableHandle
+ * 数据表的访问接口，行存储(定长、变长、PAX页面)由RecordHandle实现，列存储由ColumnHandle实现
+ * 用RecordManager::openTable根据表文件的格式打开
+ */
+class TableHandle {
+public:
+    virtual ~TableHandle() {};
+    virtual bool getRecord(const RID &rid, BufType data) = 0;//根据rid获得记录，将数据传入data中，记录不存在或页面无法装入缓存时返回false
+    //按rids逐条getRecord之前调用，把从first开始的一批记录所在的页面一起读入缓存，返回这一批之后的下标，不支持时返回rids.size()
+    virtual size_t prefetchRecords(const std::vector<RID> &rids, size_t first) { return rids.size(); }
+    bool insertRecord(BufType data, RID &rid) { return insertRecords((const char *) data, 1, &rid); }//将data插入表中，rid返回记录位置
+    //将rows中连续存放的n条记录依次插入，rids返回每条记录的位置
+    virtual bool insertRecords(const char *rows, int n, RID *rids) = 0;
+    virtual bool deleteRecord(const RID &rid) = 0;//根据rid删除记录
+    virtual bool updateRecord(const RID &rid, BufType data) = 0;//将位置为rid的记录数据更新为data
+    virtual bool openScan() = 0;//开始逐条扫描
+    virtual bool getNextRecord(RID &rid, BufType data) = 0;//data返回当前扫描的数据，rid返回数据位置，访问完所有记录返回false
+    virtual bool openPageScan() = 0;//开始成批扫描，表中没有记录时可以返回false
+    //records返回从当前位置开始的至多maxCount条记录，访问完所有记录返回false
+    //记录数据不复制时，指针在下一次调用getNextRecords或closePageScan之前有效
+    virtual bool getNextRecords(std::vector<RecordRef> &records, int maxCount = INT32_MAX) = 0;
+    virtual void closePageScan() = 0;//结束成批扫描
+    virtual RecordFormat getFormat() const = 0;
+    virtual int getRecordCount() const = 0;//表中现有的记录条数，不需要扫描
+    //groups返回页面占用摘要中每组的记录条数，groupPages返回每组的页面数，不支持时返回false
+    virtual bool getOccupancy(std::vector<int> &groups, int &groupPages) const { return false; }
+    //在openPageScan或openBatchScan之后调用，跳过开头的整组或整页记录，跳过的记录条数不超过count，返回跳过的记录条数
+    virtual int skipRecords(int count) { return 0; }
+    //并行扫描时把表分成units个扫描单位(行存储表为页，列存储表为行)，每次分给一个工作线程morsel个，不支持时返回false
+    virtual bool getScanUnits(int &units, int &morsel) const { return false; }
+    //在openPageScan或openBatchScan之后调用，只扫描扫描单位在[first,last)中的记录
+    virtual void limitScan(int first, int last) {}
+    //按列批量扫描，offsets为要读取的列在记录中的偏移，不支持按列读取时返回false
+    virtual bool openBatchScan(const std::vector<int> &offsets, const std::vector<ColumnBound> &bounds) { return false; }
+    virtual bool getNextBatch(ColumnBatch &batch) { return false; }//batch返回下一批行，访问完所有行返回false
+    //当前批中从记录偏移offset开始的列，只能读取openBatchScan时给出的列，没有这一列时_data为nullptr
+    virtual ColumnRef getBatchColumn(int offset) { return {nullptr, 0}; }
+    //开始整理表文件，从第state._cursor页开始寻找空位，整理期间使用并更新state，不支持整理时返回false
+    virtual bool openVacuum(VacuumState &state) { return false; }
+    //把末尾页面中的至多maxCount条记录移到前面页面的空位，moves返回每条记录的(原位置,新位置)，没有可以移动的记录时返回false
+    virtual bool vacuumStep(std::vector<std::pair<RID, RID>> &moves, int maxCount) { return false; }
+    //结束整理，重建空闲页面链表并截掉文件末尾的空页面，返回截掉的页面数，state._cursor记下下一次开始寻找空位的页号
+    virtual int closeVacuum() { return 0; }
+};
+
+class RecordHandle : public TableHandle {
 private:
     BufPageManager *_bufPageManager;//缓存页面管理
     int _fileID;//管理的文件标识符
+    int _pageSize;//文件的页面大小，单位：字节
     struct RecordHeader _header;//第一个页面记录信息头
     RID _rid;//当前扫描到的位置
-    int getFirstZeroBit(BufType b, int size) const;//获得第一个空闲槽位置
-    void refreshHeader() const;//标记信息头被修改
+    std::vector<int> _freeSlots;//每个页面的空闲槽数量，-1表示还没有统计，下标为页号
+    int _scanIndex;//逐页扫描时固定的缓存页面下标，-1表示没有固定页面
+    int _scanLast;//逐页扫描的最后一个页面
+    std::vector<std::pair<int, int>> _varFields;//变长页面中VARCHAR字段在记录中的(偏移,长度)
+    std::vector<std::pair<int, int>> _fixedFields;//变长页面中其余定长部分在记录中的(偏移,长度)
+    std::vector<std::pair<int, int>> _columns;//PAX页面中每列在记录中的(偏移,长度)
+    std::vector<int> _columnStarts;//PAX页面中每列在页面中的起始偏移
+    BufType _scanPage;//PAX逐页扫描时固定的页面
+    int _maxEncoded;//变长页面中一条记录编码后的最大长度，页面空闲空间不小于它加一个槽时放回空闲页面链表
+    std::vector<char> _encoded;//编码缓冲区
+    std::vector<char> _scanRows;//变长页面逐页扫描时解码的记录
+    std::vector<char> _batchValid;//PAX批量扫描时当前页面每个槽是否有记录
+    int _vacuumLow, _vacuumHigh;//整理时可能还有空位的最小页号和可能还有记录的最大页号
+    std::vector<int> _occupancy;//页面占用摘要，与第0页中的相同
+    int _changedLow, _changedHigh;//页面占用摘要中还没有写回第0页的组的范围[low,high)
+    VacuumState *_vacuum;//整理期间的状态
+    int getFreeSlots(int pageNum, BufType b);//获得页面的空闲槽数量，第一次访问页面时由位图统计
+    void refreshHeader();//将信息头和页面占用摘要中修改过的组写回第0页
+    void rebuildOccupancy();//逐页统计记录条数，重建记录总数和页面占用摘要并写回第0页
+    void occupy(int pageNum, int delta);//页面中的记录条数增加delta，同时修改记录总数，需要之后调用refreshHeader
+    int nextOccupied(int pageNum) const;//从pageNum开始第一个页面占用摘要不为0的页面，没有时返回总页数加一
+    int pageRecords(int pageNum);//页面中扫描能访问到的记录条数
+    void readRow(BufType b, int slotNum, char *data) const;//读取定长或PAX页面中槽slotNum的记录
+    void writeRow(BufType b, int slotNum, const char *data) const;//写入定长或PAX页面中槽slotNum的记录，data为nullptr时清零
+    int encodeRecord(const char *data, char *out) const;//将定长的记录编码为变长格式，返回编码后的长度
+    void decodeRecord(const char *in, char *data) const;//将变长格式解码为定长的记录
+    void readSlotted(BufType b, int slotNum, char *data);//读取变长页面中的记录，转发槽读取转发到的位置
+    bool placeSlotted(const char *record, int length, uint16_t flags, RID &rid);//在空闲页面链表中找到放得下的页面插入变长记录，返回信息头是否被修改
+    bool releaseSlotted(int pageNum, BufType b);//页面空闲空间足够时放回空闲页面链表，返回信息头是否被修改
+    bool eraseSlotted(int pageNum, int slotNum);//删除变长页面中的记录，用于删除转发到的位置，返回信息头是否被修改
+    bool seekSlotted(int &pageNum, int &slotNum);//从(pageNum,slotNum)开始找到变长页面中的下一条记录，没有时返回false
+    bool insertSlotted(const char *rows, int n, RID *rids);
+    bool deleteSlotted(const RID &rid);
+    bool updateSlotted(const RID &rid, const char *data);
+    bool getNextSlotted(std::vector<RecordRef> &records, int maxCount);
+    bool vacuumSlotted(std::vector<std::pair<RID, RID>> &moves, int maxCount);
+    RID &forwardHome(int pageNum, int slotNum);//转发到(pageNum,slotNum)的记录的原位置，转发关系无效时先逐页建立
+    bool pageEmpty(int pageNum);//页面中是否没有记录
+    void rebuildFreeList();//按页号从小到大重建空闲页面链表
+    //PAX逐页扫描，在openPageScan之后调用，固定下一个有记录的页面，pageNum返回页号，访问完所有页面返回false
+    bool getNextPage(int &pageNum);
+    ColumnRef getColumn(int offset) const;//当前固定页面中从记录偏移offset开始的列，没有这一列时_data为nullptr
 public:
     RecordHandle(BufPageManager *bufPageManager, int fileID);
-    ~RecordHandle() {};
-    void getRecord(const RID &rid, BufType data);//根据rid获得记录，将数据传入data中
-    bool insertRecord(BufType data, RID &rid);//将data插入第一个空闲槽，rid返回记录位置
-    bool deleteRecord(const RID &rid);//根据rid删除记录
-    bool updateRecord(const RID &rid, BufType data);//将位置为rid的记录数据更新为data
-    bool openScan();//开始扫描，将_rid设置为第一条记录的位置
-    bool getNextRecord(RID &rid, BufType data);//data返回当前扫描的数据，rid返回数据位置，访问完所有记录返回false
+    RecordHandle(const RecordHandle &) = delete;
+    RecordHandle &operator=(const RecordHandle &) = delete;
+    ~RecordHandle() { closePageScan(); };
+    bool getRecord(const RID &rid, BufType data) override;
+    //一批记录所在的不同页面不超过fetchLimit，页号去重排序后用一次fetchPages读入
+    size_t prefetchRecords(const std::vector<RID> &rids, size_t first) override;
+    //将rows中连续存放的n条记录依次插入空闲槽，逐页填满，rids返回每条记录的位置，信息头只写一次
+    bool insertRecords(const char *rows, int n, RID *rids) override;
+    bool deleteRecord(const RID &rid) override;
+    bool updateRecord(const RID &rid, BufType data) override;
+    bool openScan() override;//开始扫描，将_rid设置为第一条记录的位置
+    bool getNextRecord(RID &rid, BufType data) override;
+    bool openPageScan() override;//开始逐页扫描，将_rid设置为第一个页面的开始，表中没有页面返回false
+    //固定当前页面，records返回该页面中从当前位置开始的至多maxCount条记录，访问完所有记录返回false
+    //记录数据不复制，指针在下一次调用getNextRecords或closePageScan之前有效，在此期间修改同一页面会改变指针指向的数据
+    bool getNextRecords(std::vector<RecordRef> &records, int maxCount = INT32_MAX) override;
+    void closePageScan() override;//解除逐页扫描固定的页面
+    RecordFormat getFormat() const override { return (RecordFormat) _header._format; }
+    int getRecordCount() const override { return _header._rowCount; }
+    bool getOccupancy(std::vector<int> &groups, int &groupPages) const override;
+    //先按页面占用摘要跳过整组页面，再逐页统计记录条数跳过整页，跳过的页面不需要解码
+    int skipRecords(int count) override;
+    bool getScanUnits(int &units, int &morsel) const override;//每个扫描单位是一个页面
+    void limitScan(int first, int last) override;
+    //只有PAX页面支持按列读取，每批是一个页面中的所有槽
+    bool openBatchScan(const std::vector<int> &offsets, const std::vector<ColumnBound> &bounds) override;
+    bool getNextBatch(ColumnBatch &batch) override;
+    ColumnRef getBatchColumn(int offset) override { return getColumn(offset); }
+    //每次从最后一个有记录的页面取出记录，放入第一个有空位的页面，两者相遇时整理完成
+    //整理期间不维护空闲页面链表，不能插入或删除记录
+    bool openVacuum(VacuumState &state) override;
+    bool vacuumStep(std::vector<std::pair<RID, RID>> &moves, int maxCount) override;
+    int closeVacuum() override;
+};
+
+/*
+ * ColumnHandle
+ * 列存储表，适合只追加、每次只读取少数几列的统计查询
+ * 每列分成多段，每段一个页面，按ColumnSegment中的编码压缩，段目录记录每段的行范围和INT、FLOAT列的最小值、最大值
+ * 第r行的位置为(r / 有效位图每页的行数 + 1, r % 有效位图每页的行数)，删除只清除有效位图中的位，位置不变
+ * 更新先修改解码后的段，在关闭前统一重新编码写回
+ */
+class ColumnHandle : public TableHandle {
+private:
+    struct Segment {
+        int _column;//列号，-1表示有效位图页面
+        int _firstRow;//第一行的行号
+        int _rowCount;//行数
+        int _pageNum;//页号
+        int _encoding;//编码方式
+        double _min, _max;//INT、FLOAT列中值的范围
+    };
+
+    struct FileHeader {
+        int _rowCount;//追加过的总行数，包括已经删除的行
+        int _directoryPage;//段目录的第一个页面，0表示还没有段目录
+    };
+
+    BufPageManager *_bufPageManager;//缓存页面管理
+    int _fileID;//管理的文件标识符
+    int _pageSize;//文件的页面大小，单位：字节
+    struct RecordHeader _header;//第一个页面记录信息头
+    struct FileHeader _file;//列存储的信息头，在第一个页面中紧跟每列的类型
+    int _fileHeaderOffset;//列存储信息头在第一个页面中的偏移
+    int _rowsPerPage;//有效位图每个页面对应的行数
+    std::vector<std::pair<int, int>> _columns;//每列在记录中的(偏移,长度)，第0列为NULL位图
+    std::vector<int> _types;//每列的类型，第0列为-1
+    std::vector<std::vector<Segment>> _segments;//每列按行号排列的段
+    std::vector<int> _validPages;//有效位图页面，第i个页面对应第i * _rowsPerPage行开始的行
+    std::vector<int> _directoryPages;//段目录占用的页面
+    bool _directoryChanged;//段目录是否需要写回
+    std::vector<int> _cachedSegment;//每列最近解码的段，-1表示没有
+    std::vector<std::vector<char>> _cache;//每列最近解码的段中的值
+    std::map<std::pair<int, int>, std::vector<char>> _updated;//被更新的(列号,段号)解码后的值
+    std::vector<int> _scanColumns;//批量扫描读取的列
+    std::vector<std::pair<int, ColumnBound>> _scanBounds;//批量扫描用来跳过段的(列号,范围)
+    int _scanRow;//扫描的下一行
+    int _scanEnd;//批量扫描到这一行之前结束
+    int _batchRow;//当前批的第一行
+    std::vector<char> _batchValid;//当前批每行是否有记录
+    std::vector<char> _scanRows;//成批扫描时拼出的记录
+    bool varlen(int column) const { return _types[column] == STRING; }
+    int columnOf(int offset) const;//记录偏移offset开始的列的列号，没有时返回-1
+    int findSegment(int column, int row) const;//包含第row行的段的段号
+    const char *segmentValues(int column, int segment);//段解码后的值，被更新过的段返回更新后的值
+    bool isValid(int row);//第row行是否有记录
+    int nextValid(int row);//从第row行开始第一条有记录的行，没有时返回总行数
+    int allocPage();//分配一个页面，优先使用空闲页面链表中的页面
+    void freePage(int pageNum);//将页面放入空闲页面链表
+    //用values中的n个值替换column列中段号在[first,last)的段，第一个值的行号为firstRow
+    //tail为true时末尾放不满一页的值写成TAIL段，否则每段都选择最短的编码
+    void writeSegments(int column, int first, int last, int firstRow, const char *values, int n, bool tail);
+    void appendColumn(int column, const char *values, int n);//在column列末尾追加n个值
+    void flushUpdates();//将被更新的段重新编码写回
+    void writeDirectory();//写回信息头和段目录
+    RID ridOf(int row) const { return RID(row / _rowsPerPage + 1, row % _rowsPerPage); }
+    int rowOf(const RID &rid) const { return (rid.getPageNum() - 1) * _rowsPerPage + rid.getSlotNum(); }
+public:
+    ColumnHandle(BufPageManager *bufPageManager, int fileID);
+    ColumnHandle(const ColumnHandle &) = delete;
+    ColumnHandle &operator=(const ColumnHandle &) = delete;
+    ~ColumnHandle() override;
+    bool getRecord(const RID &rid, BufType data) override;
+    //每列的新值追加到该列末尾的段，段目录只写一次
+    bool insertRecords(const char *rows, int n, RID *rids) override;
+    bool deleteRecord(const RID &rid) override;
+    bool updateRecord(const RID &rid, BufType data) override;
+    bool openScan() override;
+    bool getNextRecord(RID &rid, BufType data) override;
+    bool openPageScan() override;
+    //每次返回一批中的记录，拼出的记录在下一次调用getNextRecords之前有效
+    bool getNextRecords(std::vector<RecordRef> &records, int maxCount = INT32_MAX) override;
+    void closePageScan() override {};
+    RecordFormat getFormat() const override { return COLUMN_RECORD; }
+    int getRecordCount() const override { return _header._rowCount; }
+    int skipRecords(int count) override;//按有效位图页面跳过，每个有效位图页面统计一次记录条数
+    bool getScanUnits(int &units, int &morsel) const override;//每个扫描单位是一行，每次分给工作线程一个有效位图页面的行
+    void limitScan(int first, int last) override;
+    //每批不跨过任何读取的列的段，bounds中的列的段的值都不在范围内时跳过这些行，只有用到的列被解码
+    bool openBatchScan(const std::vector<int> &offsets, const std::vector<ColumnBound> &bounds) override;
+    bool getNextBatch(ColumnBatch &batch) override;
+    ColumnRef getBatchColumn(int offset) override;
 };
 
 class RecordManager {
@@ -63,10 +323,15 @@ private:
 public:
     RecordManager(BufPageManager *bufPageManager, FileManager *fileManager);
     ~RecordManager() {};
-    bool createFile(const char *fileName, int recordSize);//根据文件名创建文件，recordSize为一条记录的大小，单位：字节
+    //根据文件名创建文件，recordSize为一条记录的大小，pageSize为页面大小，单位：字节
+    //format为SLOTTED_RECORD时fields为VARCHAR字段在记录中的(偏移,长度)，为PAX_RECORD时fields为每列在记录中的(偏移,长度)
+    //format为COLUMN_RECORD时fields与PAX_RECORD相同，第0列为NULL位图，types为其余每列的类型
+    //format为SLOTTED_RECORD时字段太多或记录太长则仍使用定长页面，为PAX_RECORD或COLUMN_RECORD时字段太多则不建立文件并返回false
+    bool createFile(const char *fileName, int recordSize, int pageSize = PAGE_SIZE, RecordFormat format = FIXED_RECORD, const std::vector<std::pair<int, int>> &fields = {}, const std::vector<AttrType> &types = {});
     bool destroyFile(const char *fileName);//根据文件名删除相应文件
     bool openFile(const char *fileName, int &fileID);//打开文件，fileID返回文件标识符
     bool closeFile(int fileID);//根据指定的标识符关闭相应的文件
+    std::unique_ptr<TableHandle> openTable(int fileID);//根据表文件的格式返回访问已打开的表文件的接口
 };
 
 #endif //RECORD_MANAGE_H
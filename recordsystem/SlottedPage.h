@@ -0,0 +1,218 @@
+#ifndef SLOTTED_PAGE
+#define SLOTTED_PAGE
+
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+
+/*
+ * SlottedPage
+ * 变长记录页面，用于含VARCHAR列的表
+ * 页面格式：| 页头 | 槽目录 -> ... 空闲空间 ... <- 记录数据 |
+ * 槽目录在页头之后向后增长，每个槽记录一条记录在页面中的偏移和长度，记录数据从页面末尾向前增长
+ * 删除记录只把槽置空，空出的空间在插入放不下时整理页面回收，整理只移动记录数据，槽号不变，RID始终有效
+ * 槽的三种特殊状态：
+ *   偏移为0：空槽，之后插入的记录可以复用
+ *   长度为0：转发槽，记录更新后变长、本页面放不下时移到其它页面，这里保存新位置的RID
+ *   长度最高位为1：从其它页面转发来的记录，只能通过原来的RID访问，扫描时跳过
+ * 每条记录至少占用FORWARD_SIZE字节，保证记录总能原地换成转发槽
+ */
+class SlottedPage {
+public:
+    struct Header {
+        int _nextFreePage;//空闲页面链表中的下一个页面，0表示链表结束
+        int _inFreeList;//页面是否在空闲页面链表中
+        int _slotCount;//槽目录的槽数
+        int _emptySlots;//槽目录中的空槽数
+        int _freeEnd;//记录数据区的起始偏移
+        int _usedBytes;//记录数据占用的字节数
+    };
+
+    struct Slot {
+        uint16_t _offset;
+        uint16_t _length;
+    };
+
+    static constexpr int HEADER_SIZE = sizeof(Header);
+    static constexpr int SLOT_SIZE = sizeof(Slot);
+    static constexpr int FORWARD_SIZE = 2 * sizeof(int);//转发槽保存的RID的大小
+    static constexpr uint16_t MOVED = 0x8000;
+    static constexpr int MAX_RECORD_LENGTH = MOVED - 1;
+
+    static Header *header(void *b) {
+        return (Header *) b;
+    }
+
+    static Slot *slots(void *b) {
+        return (Slot *) ((char *) b + HEADER_SIZE);
+    }
+
+    /*
+     * 返回:槽对应的记录数据在页面中占用的字节数
+     */
+    static int storedSize(const Slot &slot) {
+        return std::max((int) (slot._length & ~MOVED), FORWARD_SIZE);
+    }
+
+    /*
+     * @函数名init
+     * 功能:将b初始化为没有记录的页面
+     */
+    static void init(void *b, int pageSize) {
+        memset(b, 0, pageSize);
+        header(b)->_freeEnd = pageSize;
+    }
+
+    /*
+     * 返回:页面中的空闲字节数，包括还没有整理的空洞
+     */
+    static int freeBytes(void *b, int pageSize) {
+        Header *h = header(b);
+        return pageSize - HEADER_SIZE - h->_slotCount * SLOT_SIZE - h->_usedBytes;
+    }
+
+    /*
+     * 返回:长度为length的记录能否插入页面
+     */
+    static bool fits(void *b, int pageSize, int length) {
+        int need = std::max(length, FORWARD_SIZE) + (header(b)->_emptySlots == 0 ? SLOT_SIZE : 0);
+        return freeBytes(b, pageSize) >= need;
+    }
+
+    /*
+     * @函数名valid
+     * 返回:slotNum是否是页面中的非空槽
+     */
+    static bool valid(void *b, int slotNum) {
+        return slotNum >= 0 && slotNum < header(b)->_slotCount && slots(b)[slotNum]._offset != 0;
+    }
+
+    /*
+     * @函数名compact
+     * 功能:整理页面，将所有记录数据移到页面末尾，空洞合并到空闲空间
+     */
+    static void compact(void *b, int pageSize) {
+        Header *h = header(b);
+        Slot *s = slots(b);
+        char *copy = new char[pageSize];
+        memcpy(copy, b, pageSize);
+        int end = pageSize;
+        for (int i = 0; i < h->_slotCount; i++) {
+            if (s[i]._offset == 0) continue;
+            int size = storedSize(s[i]);
+            end -= size;
+            memcpy((char *) b + end, copy + s[i]._offset, size);
+            s[i]._offset = end;
+        }
+        h->_freeEnd = end;
+        delete[] copy;
+    }
+
+    /*
+     * @函数名place
+     * @参数slotNum:槽号，该槽必须已经在槽目录中且为空
+     * @参数flags:0或MOVED
+     * 功能:为槽分配记录数据空间并写入data，连续空闲空间不够时先整理页面，调用者保证空闲字节数足够
+     */
+    static void place(void *b, int pageSize, int slotNum, const char *data, int length, uint16_t flags) {
+        Header *h = header(b);
+        int size = std::max(length, FORWARD_SIZE);
+        if (h->_freeEnd - (HEADER_SIZE + h->_slotCount * SLOT_SIZE) < size) compact(b, pageSize);
+        h->_freeEnd -= size;
+        memcpy((char *) b + h->_freeEnd, data, length);
+        slots(b)[slotNum] = {(uint16_t) h->_freeEnd, (uint16_t) (length | flags)};
+        h->_usedBytes += size;
+    }
+
+    /*
+     * @函数名insert
+     * 功能:插入一条记录，优先复用槽号最小的空槽，调用者应先用fits检查
+     * 返回:记录的槽号
+     */
+    static int insert(void *b, int pageSize, const char *data, int length, uint16_t flags) {
+        Header *h = header(b);
+        Slot *s = slots(b);
+        int slotNum;
+        if (h->_emptySlots > 0) {
+            slotNum = 0;
+            while (s[slotNum]._offset != 0) slotNum++;
+            h->_emptySlots--;
+        } else {
+            //新增的槽可能和还没有整理的记录数据重叠，先整理
+            if (h->_freeEnd - (HEADER_SIZE + (h->_slotCount + 1) * SLOT_SIZE) < std::max(length, FORWARD_SIZE)) compact(b, pageSize);
+            slotNum = h->_slotCount++;
+            s[slotNum] = {0, 0};
+        }
+        place(b, pageSize, slotNum, data, length, flags);
+        return slotNum;
+    }
+
+    /*
+     * @函数名erase
+     * 功能:删除槽号为slotNum的记录，槽目录末尾的空槽被回收
+     */
+    static void erase(void *b, int slotNum) {
+        Header *h = header(b);
+        Slot *s = slots(b);
+        int size = storedSize(s[slotNum]);
+        h->_usedBytes -= size;
+        if (s[slotNum]._offset == h->_freeEnd) h->_freeEnd += size;
+        s[slotNum] = {0, 0};
+        if (slotNum == h->_slotCount - 1) {
+            h->_slotCount--;
+            while (h->_slotCount > 0 && s[h->_slotCount - 1]._offset == 0) {
+                h->_slotCount--;
+                h->_emptySlots--;
+            }
+        } else h->_emptySlots++;
+    }
+
+    /*
+     * @函数名resize
+     * 功能:将槽号为slotNum的记录替换为data，新记录不更长时原地写入
+     * 返回:页面放不下新记录时返回false，页面不变
+     */
+    static bool resize(void *b, int pageSize, int slotNum, const char *data, int length, uint16_t flags) {
+        Header *h = header(b);
+        Slot &slot = slots(b)[slotNum];
+        int oldSize = storedSize(slot);
+        int newSize = std::max(length, FORWARD_SIZE);
+        if (newSize <= oldSize) {
+            memcpy((char *) b + slot._offset, data, length);
+            slot._length = (uint16_t) (length | flags);
+            h->_usedBytes -= oldSize - newSize;
+            return true;
+        }
+        if (freeBytes(b, pageSize) + oldSize < newSize) return false;
+        //先释放原来的空间，整理时跳过该槽
+        h->_usedBytes -= oldSize;
+        slot._offset = 0;
+        place(b, pageSize, slotNum, data, length, flags);
+        return true;
+    }
+
+    /*
+     * @函数名forward
+     * 功能:将槽号为slotNum的记录原地换成指向(pageNum,slotNum)的转发槽
+     */
+    static void forward(void *b, int slotNum, int targetPage, int targetSlot) {
+        int rid[2] = {targetPage, targetSlot};
+        Slot &slot = slots(b)[slotNum];
+        header(b)->_usedBytes -= storedSize(slot) - FORWARD_SIZE;
+        memcpy((char *) b + slot._offset, rid, FORWARD_SIZE);
+        slot._length = 0;
+    }
+
+    /*
+     * @函数名target
+     * 功能:读取转发槽保存的RID
+     */
+    static void target(void *b, int slotNum, int &targetPage, int &targetSlot) {
+        int rid[2];
+        memcpy(rid, (char *) b + slots(b)[slotNum]._offset, FORWARD_SIZE);
+        targetPage = rid[0];
+        targetSlot = rid[1];
+    }
+};
+
+#endif